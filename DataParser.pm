@@ -137,6 +137,87 @@ sub parse_files {
     return $result;
 }
 
+# Reads the finite-sample response surface files $filebase01 through $filebase$numfiles and returns
+# them in a big string.  The files have the same layout as the quantile files parsed by
+# parse_files(), except that each p value is followed by one or more coefficients (on 1/T, 1/T^2,
+# etc.) instead of a single quantile.  Every line of every file must have the same number of
+# coefficients; that number is stored in $RS_TERMS.  Must be called after parse_files() because the
+# b and p values found here are required to match the ones found there.
+our $RS_TERMS = 0;
+sub parse_rs_files {
+    my ($filebase, $numfiles) = @_;
+
+    my $result = '';
+    for (1 .. $numfiles) {
+        my $filename = sprintf "$filebase%02d.txt", $_;
+        open my $fh, "<", $filename
+            or die "Unable to open $filename: $!\n";
+
+        $result .= "\t{{ // q=$_:\n";
+        my $bvalpos = 0;
+        my $line = <$fh>;
+        while (1) {
+            $line =~ s/[\r\n]+$//;
+            $line =~ /^b:\s+($num)$/ or die "Parse error [$filename:$.]: found '$line', expected 'b: (value)'\n";
+            my $b = $1;
+            if ($bvalpos >= @BVALUES or $b != $BVALUES[$bvalpos]) {
+                die "Parse error [$filename:$.]: found b=$b which doesn't match the quantile data b values\n";
+            }
+            ++$bvalpos;
+
+            # $coef[k][i] is the coefficient on T^-(k+1) for pvalues[i]
+            my @coef;
+            my $pvaluepos = 0;
+            while (defined($line = <$fh>)) {
+                $line =~ s/[\r\n]+$//;
+                last unless $line =~ /^($num)((?:\s+$num)+)\s*$/;
+                my $p = $1;
+                my @c = split ' ', $2;
+                if ($pvaluepos >= @PVALUES or $PVALUES[$pvaluepos] != $p) {
+                    die "[$filename:$.]: Error: found pvalue=$p different from the quantile data pvalues\n";
+                }
+                if (not $RS_TERMS) { $RS_TERMS = @c; }
+                elsif (@c != $RS_TERMS) {
+                    die "[$filename:$.]: Error: found ".@c." coefficients, expected $RS_TERMS\n";
+                }
+                push @{$coef[$_]}, $c[$_] for 0 .. $#c;
+                ++$pvaluepos;
+            }
+            if ($pvaluepos != @PVALUES) {
+                die "[$filename:$.]: Reached end of data for b=$b, but found $pvaluepos p values, wanted ".@PVALUES."\n";
+            }
+
+            $result .= "\t\t// b=$b:\n\t\t{{\n";
+            for my $k (0 .. $#coef) {
+                my $vals = bpvalues($coef[$k]);
+                $vals =~ s/^\t/\t\t\t/;
+                $vals =~ s/\n\t/\n\t\t\t/g;
+                $result .= "\t\t\t// T^-" . ($k+1) . ":\n\t\t\t{{\n$vals\n\t\t\t}},\n";
+            }
+            $result =~ s/,\n$/\n/;
+            $result .= "\t\t}},\n";
+
+            if (not defined $line or $line eq '') {
+                # Hit the end of the file or end of the data
+                last;
+            }
+        }
+
+        if ($bvalpos != @BVALUES) {
+            die "[$filename:$.]: Reached end of file, but found $bvalpos b values, wanted ".@BVALUES."\n";
+        }
+
+        # Chop off the last comma
+        $result =~ s/,\n$/\n/;
+        $result .= "\t}},\n";
+    }
+
+    # Chop off the last comma
+    $result =~ s/,\n$/\n/;
+
+    return $result;
+}
+
 # Formats pvalues into a C array initialization body.  Must be called after parse_files() because
 # that's where the p values are actually populated.
 sub pvalues {
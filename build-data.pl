@@ -1,7 +1,9 @@
 #!/usr/bin/perl
 
 # Reads the frcapp{01,...,12}.txt and frmapp{01,...,12} and builds a C header
-# including all the data.
+# including all the data.  If the optional finite-sample response surface files
+# frcrs{01,...,12}.txt and frmrs{01,...,12}.txt are also present, their
+# coefficients are included as well.
 
 use strict;
 use warnings;
@@ -14,11 +16,22 @@ my $top_q = 12;
 
 my $frcappdata = DataParser::parse_files("$datadir/frcapp", $top_q);
 my $frmappdata = DataParser::parse_files("$datadir/frmapp", $top_q);
+my ($frcrsdata, $frmrsdata) = ('', '');
+if (-e "$datadir/frcrs01.txt" or -e "$datadir/frmrs01.txt") {
+    $frcrsdata = DataParser::parse_rs_files("$datadir/frcrs", $top_q);
+    $frmrsdata = DataParser::parse_rs_files("$datadir/frmrs", $top_q);
+}
+my $rs_terms = $DataParser::RS_TERMS;
+my $rs_available = $rs_terms ? 1 : 0;
 my $bvaluesdata = DataParser::bvalues();
 my $pvaluesdata = DataParser::pvalues();
 my $pvalues = @DataParser::PVALUES;
 my $bvalues = @DataParser::BVALUES;
 
+# Without response surface data the coefficient arrays are empty, so just value-initialize them
+my $rs_const = $rs_terms ? "{{\n$frcrsdata}}" : "{}";
+my $rs_noconst = $rs_terms ? "{{\n$frmrsdata}}" : "{}";
+
 my $header_dir = "fracdist";
 my $header_file = "fracdist/data.hpp";
 my $data_file = "fracdist/data.cpp";
@@ -32,6 +45,12 @@ my $header = qq!#pragma once
  * This file is automatically generated when building the fracdist package.
  */
 
+/** Defined as 1 if fracdist was built with response surface data (so that finite-sample quantiles
+ * are available for `T > 0`), 0 otherwise.  The pvalue() and critical() overloads taking only a
+ * sample size are only declared when this is 1.
+ */
+#define FRACDIST_RESPONSE_SURFACE $rs_available
+
 namespace fracdist {
 
 constexpr size_t
@@ -41,7 +60,11 @@ constexpr size_t
     b_length = $bvalues,
     /** The number of probability values and associated quantiles in `fracdist::pvalues`,
      * `fracdist::q_const[i][j]`, and `fracdist::q_noconst[i][j]` (for any admissable `i` and `j`). */
-    p_length = $pvalues;
+    p_length = $pvalues,
+    /** The number of finite-sample response surface terms (the coefficients on \\f\$T^{-1}\\f\$,
+     * \\f\$T^{-2}\\f\$, etc.) in `fracdist::rs_const[i][j]` and `fracdist::rs_noconst[i][j]`.  This
+     * will be 0 if fracdist was built without response surface data. */
+    rs_length = $rs_terms;
 
 
 /** The bvalues: `bvalues[j]` is the b value corresponding to the quantiles contained in
@@ -68,6 +91,25 @@ variable is for models estimated *without* a constant.
 */
 extern const std::array<const std::array<const std::array<double, p_length>, b_length>, q_length> q_noconst;
 
+/** A `double[][][][]` (wrapped in nested `std::array`) of finite-sample response surface coefficients
+for models *with* a constant, where `rs_const[x][y][k][z]` is the coefficient on \\f\$T^{-(k+1)}\\f\$
+in the finite-sample approximation of the quantile `q_const[x][y][z]`.  That is, the quantile for a
+sample of size \\f\$T\\f\$ is approximated as:
+
+\\f[
+    Q_T = Q_\\infty + \\sum_{k=1}^{K} \\frac{c_k}{T^k}
+\\f]
+
+where \\f\$Q_\\infty\\f\$ is `q_const[x][y][z]`, \\f\$K\\f\$ is `fracdist::rs_length`, and \\f\$c_k\\f\$ is
+`rs_const[x][y][k-1][z]`.  Empty (`rs_length == 0`) unless fracdist was built with response surface data.
+*/
+extern const std::array<const std::array<const std::array<const std::array<double, p_length>, rs_length>, b_length>, q_length> rs_const;
+
+/** Like fracdist::rs_const, but for models estimated *without* a constant (i.e. the finite-sample
+coefficients associated with fracdist::q_noconst).
+*/
+extern const std::array<const std::array<const std::array<const std::array<double, p_length>, rs_length>, b_length>, q_length> rs_noconst;
+
 }!;
 
 my $runtime = qq!#include "$header_file"
@@ -87,6 +129,10 @@ const std::array<const std::array<const std::array<double, p_length>, b_length>,
 
 const std::array<const std::array<const std::array<double, p_length>, b_length>, q_length> q_noconst {{\n$frmappdata}};
 
+const std::array<const std::array<const std::array<const std::array<double, p_length>, rs_length>, b_length>, q_length> rs_const $rs_const;
+
+const std::array<const std::array<const std::array<const std::array<double, p_length>, rs_length>, b_length>, q_length> rs_noconst $rs_noconst;
+
 };
 
 !;
@@ -2,12 +2,15 @@
 #include <cerrno>
 #include <cstring>
 #include <fracdist/version.hpp>
+#include <fracdist/tables.hpp>
+#include <fracdist/stats.hpp>
 #include <unordered_set>
 #include <list>
 #include <string>
 #include <algorithm>
 #include <cctype>
 #include <utility>
+#include <limits>
 #include <iostream>
 
 #define PRINT_ERROR(fmt, ...) do { fprintf(stderr, "\n" fmt "\n\n", ##__VA_ARGS__); help(argv[0]); return 3; } while(0)
@@ -43,7 +46,7 @@ inline bool parse_uint(const std::string &arg, unsigned int &result) {
 #undef PARSE
 
 inline void uc(std::string &lc) {
-    std::transform(lc.begin(), lc.end(), lc.begin(), std::ptr_fun<int, int>(std::toupper));
+    std::transform(lc.begin(), lc.end(), lc.begin(), [](unsigned char c) { return (char) std::toupper(c); });
 }
 
 // Parses a boolean value.  Accepted values: 0, 1, (case-insensitive) t, true, f, false
@@ -61,35 +64,69 @@ inline bool parse_bool(std::string arg, bool &result) {
     return false;
 }
 
-// Parses the Q, B, and C values and removes them from the argument list
+// Parses the Q, B, and C values and removes them from the argument list.  A q value larger than
+// fracdist::q_length needs a table for the requested constant setting, so q is only checked
+// against the available tables once C has been parsed.
 #define PARSE_Q_B_C \
-        success = parse_uint(args.front().c_str(), q);\
-        if (not success or q < 1 or q > fracdist::q_length)\
-            RETURN_ERROR("Invalid q value ``%s''", args.front().c_str());\
+        const std::string q_arg = args.front();\
+        success = parse_uint(q_arg.c_str(), q) and q >= 1;\
+        if (not success)\
+            RETURN_ERROR("Invalid q value ``%s''", q_arg.c_str());\
         args.pop_front();\
 \
         success = parse_double(args.front().c_str(), b);\
-        if (not success or b < fracdist::bvalues.front() or b > fracdist::bvalues.back())\
+        if (not success or not (b >= fracdist::bvalues.front() and b <= fracdist::bvalues.back()))\
             RETURN_ERROR("Invalid b value ``%s''", args.front().c_str());\
         args.pop_front();\
 \
         success = parse_bool(args.front().c_str(), constant);\
         if (not success)\
             RETURN_ERROR("Invalid constant value ``%s''", args.front().c_str());\
-        args.pop_front();
+        args.pop_front();\
+\
+        try { success = fracdist::have_table(q, constant); }\
+        catch (std::exception &e) { RETURN_ERROR("Invalid q value ``%s'': %s", q_arg.c_str(), e.what()); }\
+        if (not success)\
+            RETURN_ERROR("Invalid q value ``%s'': no quantile table %s a constant", q_arg.c_str(), constant ? "with" : "without");
 
 
 inline int print_version(const char *program) {
     fprintf(stderr,
-"%s (fracdist) %s\n"
+"%s (fracdist) %s (%s kernels)\n"
 "Copyright (C) 2014 Jason Rhinelander\n"
 "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n"
 "This is free software: you are free to change and redistribute it.\n"
 "There is NO WARRANTY, to the extent permitted by law.\n\n",
-    program, fracdist::version_string);
+    program, fracdist::version_string, fracdist::cpu_dispatch());
     return 10;
 }
 
+/// Prints the instrumentation counters (for the --stats option) to stderr
+inline void print_stats() {
+    if (!fracdist::stats_enabled()) {
+        fprintf(stderr, "Statistics unavailable: fracdist was built without the fracdist_STATS option\n");
+        return;
+    }
+    auto s = fracdist::stats();
+    fprintf(stderr, "quantiles cache: %llu hits, %llu misses\n",
+            (unsigned long long) s.qcache_hits, (unsigned long long) s.qcache_misses);
+    fprintf(stderr, "chi-squared inverse cache: %llu hits, %llu misses\n",
+            (unsigned long long) s.chisq_cache_hits, (unsigned long long) s.chisq_cache_misses);
+    const std::pair<const char*, const fracdist::stage_stats*> stages[] = {
+        {"quantiles interpolation", &s.quantiles_interpolation},
+        {"p-value regression", &s.pvalue_regression},
+        {"critical value regression", &s.critical_regression},
+        {"chi-squared evaluation", &s.chisq},
+    };
+    for (auto &st : stages) {
+        fprintf(stderr, "%s: %llu calls, %llu %s", st.first,
+                (unsigned long long) st.second->calls, (unsigned long long) st.second->ticks, s.tick_unit);
+        if (st.second->calls > 0)
+            fprintf(stderr, " (%.1f per call)", (double) st.second->ticks / st.second->calls);
+        fprintf(stderr, "\n");
+    }
+}
+
 /// Returns true if the given `args` contains any of the values in `find`
 inline bool arg_match(const std::list<std::string> &args, const std::unordered_set<std::string> &find) {
     for (auto &arg : args) {
@@ -99,6 +136,22 @@ inline bool arg_match(const std::list<std::string> &args, const std::unordered_s
     return false;
 }
 
+/// Like arg_remove, but for an argument that takes a value: removes the first matched argument and
+/// the argument following it from `args`, storing the latter in `value`.  Returns false (and leaves
+/// `args` unchanged) if no argument matched or if the matched argument is the last one.
+inline bool arg_value(std::list<std::string> &args, const std::unordered_set<std::string> &remove, std::string &value) {
+    for (auto it = args.begin(); it != args.end(); it++) {
+        if (remove.count(*it)) {
+            auto next = std::next(it);
+            if (next == args.end()) return false;
+            value = *next;
+            args.erase(it, std::next(next));
+            return true;
+        }
+    }
+    return false;
+}
+
 /// Like arg_match, but removes the first matched argument from `args`.
 inline bool arg_remove(std::list<std::string> &args, const std::unordered_set<std::string> &remove) {
     for (auto it = args.begin(); it != args.end(); it++) {
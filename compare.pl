@@ -4,6 +4,10 @@
 # this C++ implementation with random admissable values, looking for differences
 # in output.
 #
+# This is slow (it runs the programs once per value) and needs the fortran
+# fracdist program; for quick accuracy checks of changes to this implementation
+# use the fracdist_regress program instead.
+#
 
 use IPC::Open2;
 use File::Basename;
@@ -13,10 +13,11 @@
 /** Prints a help message to stderr, returns 1 (to be returned by main()). */
 int help(const char *arg0) {
     fprintf(stderr, "\n"
-"Usage: %s Q B C P [P ...] [--linear|-l]\n\n"
+"Usage: %s Q B C P [P ...] [--linear|-l|--spline|-s] [--tables DIR] [--stats]\n\n"
 "Estimates a p-value for the test statistic(s) T.\n\n"
 
-"Q is the q value, which must be an integer between 1 and %zd, inclusive.\n\n"
+"Q is the q value, which must be an integer between 1 and %zd, inclusive, or a\n"
+"larger integer for which a table is available in the --tables directory.\n\n"
 
 "B is the b value, which must be a double between %.3f and %.3f.\n\n"
 
@@ -32,11 +33,21 @@ int help(const char *arg0) {
 
 "If the optional --linear (or -l) argument is given, linear interpolation of the\n"
 "two closest dataset B values is used and exact values are used for exact B\n"
-"value matches.  The default, when --linear is not given, uses a quadratic\n"
-"approximation of nearby B values (even when the value of B exactly matches the\n"
-"data set).\n\n",
+"value matches.  If --spline (or -s) is given instead, a natural cubic spline\n"
+"through the quantiles at every dataset B value is used, which is smooth in B\n"
+"and also gives exact values for exact B value matches.  The default, when\n"
+"neither is given, uses a quadratic approximation of nearby B values (even when\n"
+"the value of B exactly matches the data set).\n\n"
 
-    arg0, fracdist::q_length, fracdist::bvalues.front(), fracdist::bvalues.back());
+"If the optional --tables DIR argument is given, quantile tables for Q values\n"
+"larger than %zd are read from frcappNN.txt (with constant) or frmappNN.txt\n"
+"(without constant) files in DIR, where NN is Q (e.g. frcapp15.txt).\n\n"
+
+"If the optional --stats argument is given, a breakdown of the time spent in each\n"
+"stage of the calculation is written to stderr (this requires fracdist to have\n"
+"been built with the fracdist_STATS option).\n\n",
+
+    arg0, fracdist::q_length, fracdist::bvalues.front(), fracdist::bvalues.back(), fracdist::q_length);
     print_version("fdcrit");
     return 2;
 }
@@ -58,6 +69,16 @@ int main(int argc, char *argv[]) {
         return print_version("fdcrit");
 
     bool linear_interp = arg_remove(args, {"--linear", "-l"});
+    bool spline_interp = arg_remove(args, {"--spline", "-s"});
+    if (linear_interp && spline_interp)
+        RETURN_ERROR("--linear and --spline cannot be used together");
+    const fracdist::interpolation interp = linear_interp ? fracdist::interpolation::linear :
+        spline_interp ? fracdist::interpolation::spline : fracdist::interpolation::JGMMON14;
+    bool show_stats = arg_remove(args, {"--stats"});
+
+    std::string table_dir;
+    if (arg_value(args, {"--tables"}, table_dir))
+        fracdist::set_table_directory(table_dir);
 
     if (args.size() >= 4) {
         bool success;
@@ -71,7 +92,7 @@ int main(int argc, char *argv[]) {
             success = parse_double(arg.c_str(), d);
             if (not success)
                 RETURN_ERROR("Invalid test level ``%s''", arg.c_str());
-            if (d < 0 || d > 1)
+            if (!(d >= 0 && d <= 1))
                 RETURN_ERROR("Invalid test level ``%s'': value must be between 0 and 1", arg.c_str());
             levels.push_back(d);
         }
@@ -87,11 +108,12 @@ int main(int argc, char *argv[]) {
 
     for (auto &d : levels) {
         double r;
-        try {
-            r = fracdist::critical_advanced(d, q, b, constant,
-                    linear_interp ? fracdist::interpolation::linear : fracdist::interpolation::JGMMON14, 9);
-        } catch (std::exception &e) {
-            RETURN_ERROR("An error occured: %s", e.what());
+        auto s = fracdist::try_critical(r, d, q, b, constant, interp, 9, 0);
+        if (s != fracdist::status::ok) {
+            // Repeat the calculation with the throwing version for its more detailed message
+            try { fracdist::critical_advanced(d, q, b, constant, interp, 9); }
+            catch (std::exception &e) { RETURN_ERROR("An error occured: %s", e.what()); }
+            RETURN_ERROR("An error occured: %s", fracdist::status_message(s));
         }
 
         if (std::isinf(r))
@@ -99,4 +121,6 @@ int main(int argc, char *argv[]) {
         else
             printf("%.7g\n", r);
     }
+
+    if (show_stats) print_stats();
 }
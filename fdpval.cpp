@@ -5,18 +5,26 @@
  * with a non-zero status.
  *
  * This is a simple wrapper around the fracdist_pvalue call and does not support the alternative
- * functionality available through fracdist_pvalue_advanced().
+ * functionality available through fracdist_pvalue_advanced().  With --panel, it instead reads a
+ * panel of series (each with its own q, b, constant, and test statistic) and calculates their
+ * p-values and combinations with fracdist::pvalue_panel().
  */
 #include <fracdist/pvalue.hpp>
+#include <fracdist/panel.hpp>
 #include "cli-common.hpp"
+#include <fstream>
+#include <sstream>
+#include <vector>
 
 /** Prints a help message to stderr, returns 1 (to be returned by main()). */
 int help(const char *arg0) {
     fprintf(stderr, "\n"
-"Usage: %s Q B C T [T ...] [--linear|-l]\n\n"
+"Usage: %s Q B C T [T ...] [--linear|-l|--spline|-s] [--tables DIR] [--stats]\n"
+"       %s --panel FILE [--fdr ALPHA] [--threads N] [--linear|-l|--spline|-s] [--tables DIR]\n\n"
 "Estimates a p-value for the test statistic(s) T.\n\n"
 
-"Q is the q value, which must be an integer between 1 and %zd, inclusive.\n\n"
+"Q is the q value, which must be an integer between 1 and %zd, inclusive, or a\n"
+"larger integer for which a table is available in the --tables directory.\n\n"
 
 "B is the b value, which must be a double between %.3f and %.3f.\n\n"
 
@@ -32,15 +40,53 @@ int help(const char *arg0) {
 
 "If the optional --linear (or -l) argument is given, linear interpolation of the\n"
 "two closest dataset B values is used and exact values are used for exact B\n"
-"value matches.  The default, when --linear is not given, uses a quadratic\n"
-"approximation of nearby B values (even when the value of B exactly matches the\n"
-"data set).\n\n",
-
-    arg0, fracdist::q_length, fracdist::bvalues.front(), fracdist::bvalues.back());
+"value matches.  If --spline (or -s) is given instead, a natural cubic spline\n"
+"through the quantiles at every dataset B value is used, which is smooth in B\n"
+"and also gives exact values for exact B value matches.  The default, when\n"
+"neither is given, uses a quadratic approximation of nearby B values (even when\n"
+"the value of B exactly matches the data set).\n\n"
+
+"If the optional --tables DIR argument is given, quantile tables for Q values\n"
+"larger than %zd are read from frcappNN.txt (with constant) or frmappNN.txt\n"
+"(without constant) files in DIR, where NN is Q (e.g. frcapp15.txt).\n\n"
+
+"If the optional --stats argument is given, a breakdown of the time spent in each\n"
+"stage of the calculation is written to stderr (this requires fracdist to have\n"
+"been built with the fracdist_STATS option).\n\n"
+
+"With --panel, the series of a panel are read from FILE (or standard input, if\n"
+"FILE is -), one per line as Q B C T (separated by whitespace; blank lines and\n"
+"lines starting with # are ignored).  Each series' p-value and its\n"
+"Benjamini-Hochberg adjusted p-value are output one series per line, followed by\n"
+"the combined results: Fisher's statistic and p-value, Simes' p-value, and the\n"
+"number of series rejected at the false discovery rate ALPHA given by --fdr\n"
+"(default 0.05).  --threads N uses N threads (the default, 0, uses one per CPU).\n\n",
+
+    arg0, arg0, fracdist::q_length, fracdist::bvalues.front(), fracdist::bvalues.back(), fracdist::q_length);
     print_version("fdpval");
     return 2;
 }
 
+/** Reads a panel (as described in the help) from `in` into `series`.  Returns false, with an error
+ * message in `error`, if a line can't be parsed.
+ */
+bool read_panel(std::istream &in, std::vector<fracdist::panel_series> &series, std::string &error) {
+    std::string line;
+    for (size_t lineno = 1; std::getline(in, line); lineno++) {
+        std::istringstream fields(line);
+        std::string q, b, c, t, extra;
+        if (!(fields >> q) || q[0] == '#') continue;
+        fracdist::panel_series s;
+        if (!(fields >> b >> c >> t) || (fields >> extra) || !parse_uint(q, s.q) || !parse_double(b, s.b) ||
+                !parse_bool(c, s.constant) || !parse_double(t, s.test_stat)) {
+            error = "Invalid panel line " + std::to_string(lineno) + ": ``" + line + "''";
+            return false;
+        }
+        series.push_back(s);
+    }
+    return true;
+}
+
 int main(int argc, char *argv[]) {
     double b;
     std::list<double> tests;
@@ -58,6 +104,65 @@ int main(int argc, char *argv[]) {
         return print_version("fdpval");
 
     bool linear_interp = arg_remove(args, {"--linear", "-l"});
+    bool spline_interp = arg_remove(args, {"--spline", "-s"});
+    if (linear_interp && spline_interp)
+        RETURN_ERROR("--linear and --spline cannot be used together");
+    const fracdist::interpolation interp = linear_interp ? fracdist::interpolation::linear :
+        spline_interp ? fracdist::interpolation::spline : fracdist::interpolation::JGMMON14;
+    bool show_stats = arg_remove(args, {"--stats"});
+
+    std::string table_dir;
+    if (arg_value(args, {"--tables"}, table_dir))
+        fracdist::set_table_directory(table_dir);
+
+    std::string panel_file;
+    if (arg_value(args, {"--panel"}, panel_file)) {
+        std::string value;
+        double fdr = 0.05;
+        if (arg_value(args, {"--fdr"}, value) && !(parse_double(value, fdr) && fdr >= 0 && fdr <= 1))
+            RETURN_ERROR("Invalid --fdr value ``%s'': must be between 0 and 1", value.c_str());
+        unsigned int threads = 0;
+        if (arg_value(args, {"--threads"}, value) && !parse_uint(value, threads))
+            RETURN_ERROR("Invalid --threads value ``%s''", value.c_str());
+        if (!args.empty())
+            RETURN_ERROR("Invalid arguments: test statistics cannot be given with --panel");
+
+        std::vector<fracdist::panel_series> series;
+        std::string error;
+        bool read;
+        if (panel_file == "-") read = read_panel(std::cin, series, error);
+        else {
+            std::ifstream in(panel_file);
+            if (!in) RETURN_ERROR("Unable to open panel file ``%s'': %s", panel_file.c_str(), std::strerror(errno));
+            read = read_panel(in, series, error);
+        }
+        if (!read) RETURN_ERROR("%s", error.c_str());
+        if (series.empty()) RETURN_ERROR("Panel file ``%s'' contains no series", panel_file.c_str());
+
+        fracdist::panel_result result;
+        fracdist::pvalue_panel(series.data(), series.size(), result, interp, 9, 0, threads);
+        for (size_t i = 0; i < series.size(); i++) {
+            if (result.row_status[i] != fracdist::status::ok) {
+                // Repeat the calculation with the throwing version for its more detailed message
+                const fracdist::panel_series &s = series[i];
+                try { fracdist::pvalue_advanced(s.test_stat, s.q, s.b, s.constant, interp, 9); }
+                catch (std::exception &e) { RETURN_ERROR("An error occured for panel series %zu: %s", i + 1, e.what()); }
+                RETURN_ERROR("An error occured for panel series %zu: %s", i + 1, fracdist::status_message(result.row_status[i]));
+            }
+        }
+
+        size_t rejected = 0;
+        for (size_t i = 0; i < series.size(); i++) {
+            printf("%.7g\t%.7g\n", result.pvalues[i], result.bh_adjusted[i]);
+            if (result.bh_adjusted[i] <= fdr) rejected++;
+        }
+        printf("Fisher: %.7g (p-value %.7g)\n", result.fisher_stat, result.fisher_pvalue);
+        printf("Simes: %.7g\n", result.simes_pvalue);
+        printf("BH rejections at FDR %g: %zu of %zu\n", fdr, rejected, series.size());
+
+        if (show_stats) print_stats();
+        return 0;
+    }
 
     if (args.size() >= 4) {
         bool success;
@@ -71,7 +176,7 @@ int main(int argc, char *argv[]) {
             success = parse_double(arg.c_str(), d);
             if (not success)
                 RETURN_ERROR("Invalid test statistic ``%s''", arg.c_str());
-            if (d < 0)
+            if (!(d >= 0))
                 RETURN_ERROR("Invalid test statistic ``%s'': value must be >= 0", arg.c_str());
             tests.push_back(d);
         }
@@ -86,13 +191,16 @@ int main(int argc, char *argv[]) {
 
     for (auto &t : tests) {
         double r;
-        try {
-            r = fracdist::pvalue_advanced(t, q, b, constant,
-                    linear_interp ? fracdist::interpolation::linear : fracdist::interpolation::JGMMON14, 9);
-        } catch (std::exception &e) {
-            RETURN_ERROR("An error occured: %s", e.what());
+        auto s = fracdist::try_pvalue(r, t, q, b, constant, interp, 9, 0);
+        if (s != fracdist::status::ok) {
+            // Repeat the calculation with the throwing version for its more detailed message
+            try { fracdist::pvalue_advanced(t, q, b, constant, interp, 9); }
+            catch (std::exception &e) { RETURN_ERROR("An error occured: %s", e.what()); }
+            RETURN_ERROR("An error occured: %s", fracdist::status_message(s));
         }
 
         printf("%.7g\n", r);
     }
+
+    if (show_stats) print_stats();
 }
@@ -1,111 +1,438 @@
 #include <fracdist/common.hpp>
+#include <fracdist/tables.hpp>
+#include <fracdist/stats.hpp>
+#include <fracdist/quadratic.hpp>
 #include <boost/math/distributions/chi_squared.hpp>
-#include <Eigen/Core>
-#include <Eigen/SVD>
-
-using namespace Eigen;
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace fracdist {
 
 // Caches the quantiles calculated in the last quantiles call.  If get_quantiles is called with
 // the same q, b, constant, and interpolation values, we can simple return the cached
-// value.
-struct {
+// value.  The interpolated (but not yet T-adjusted) asymptotic quantiles and response surface
+// coefficients are kept as well, so that a call that only changes T just needs to re-evaluate the
+// response surface polynomial.  Each thread has its own cache, so that fracdist can be used from
+// multiple threads at once.
+static thread_local struct {
     bool cached; // False initially; will be set to true when populated
     bool constant; unsigned int q; double b; interpolation interp; // Parameters the cache was calculated for
+    unsigned int T; // The sample size of `cache` (0 for asymptotic)
     std::array<double, p_length> cache;
-} qcache = { .cached = false };
+    std::array<double, p_length> asymptotic; // The T=0 quantiles
+    bool rs_cached; // True if `rs` has been populated for the current q, b, constant, interp
+    std::array<std::array<double, p_length>, rs_length> rs; // Interpolated response surface coefficients
+} qcache = {};
 
-// Updates qcache
-static void qcache_store(const unsigned int &q, const double &b, const bool &constant, const interpolation &interp, const std::array<double, p_length> &quantiles) {
-    qcache.cached = true;
-    qcache.q = q;
-    qcache.b = b;
-    qcache.constant = constant;
-    qcache.interp = interp;
-    qcache.cache = quantiles;
-}
+// Caches the result of the last quantile_derivatives() call, like qcache.
+static thread_local struct {
+    bool cached;
+    bool constant; unsigned int q; double b; interpolation interp; unsigned int T;
+    std::array<double, p_length> derivs;
+} dcache = {};
 
 // See description in fracdist/common.hpp
-const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const interpolation &interp) {
-    // Will be allocated and store the result (unless an error occurs)
-    std::array<double, p_length> result;
-
-    if (qcache.cached &&
-            qcache.q == q && qcache.b == b && qcache.constant == constant && qcache.interp == interp) {
-        result = qcache.cache;
-        return result;
+bweights interpolation_weights(const double &b, const interpolation &interp) {
+    switch (interp) {
+        case interpolation::JGMMON14: return interpolation_weights<interpolation::JGMMON14>(b);
+        case interpolation::exact_or_JGMMON14: return interpolation_weights<interpolation::exact_or_JGMMON14>(b);
+        case interpolation::linear: return interpolation_weights<interpolation::linear>(b);
+        case interpolation::spline: return interpolation_weights<interpolation::spline>(b);
+        case interpolation::chebyshev: return interpolation_weights<interpolation::chebyshev>(b);
     }
+    throw std::runtime_error("Internal error (BUG): unhandled interpolation");
+}
 
-    if (q < 1 || q > q_length)
-        throw std::out_of_range(ostringstream() << "q value (" << q << ") invalid: q must between 1 and " << q_length);
-    const double bmin = bvalues.front(), bmax = bvalues.back();
-    if (b < bmin || b > bmax)
-        throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bmin << " and " << bmax);
+// The natural cubic spline through the points (bvalues[j], y[j]) has second derivatives m = S y at
+// the tabulated b values, where S is a fixed b_length x b_length matrix (the spline is linear in
+// y).  This returns S, calculated (once) by solving the spline's tridiagonal system
+//     h[i-1] m[i-1] + 2(h[i-1] + h[i]) m[i] + h[i] m[i+1] = 6((y[i+1]-y[i])/h[i] - (y[i]-y[i-1])/h[i-1])
+// with m[0] = m[b_length-1] = 0 (where h[i] = bvalues[i+1] - bvalues[i]) for each unit vector y.
+typedef std::array<std::array<double, b_length>, b_length> spline_matrix;
+static const spline_matrix& spline_operator() {
+    static const spline_matrix S = []() {
+        spline_matrix S;
+        std::array<double, b_length> h, diag, rhs;
+        for (size_t i = 0; i+1 < b_length; i++) h[i] = bvalues[i+1] - bvalues[i];
+        for (size_t j = 0; j < b_length; j++) {
+            for (size_t i = 1; i+1 < b_length; i++) {
+                rhs[i] = 6 * (((i+1 == j) - (i == j)) / h[i] - ((i == j) - (i-1 == j)) / h[i-1]);
+                diag[i] = 2 * (h[i-1] + h[i]);
+            }
+            // Forward elimination, then back substitution
+            for (size_t i = 2; i+1 < b_length; i++) {
+                const double f = h[i-1] / diag[i-1];
+                diag[i] -= f * h[i-1];
+                rhs[i] -= f * rhs[i-1];
+            }
+            S[b_length-1][j] = S[0][j] = 0;
+            for (size_t i = b_length-2; i > 0; i--)
+                S[i][j] = (rhs[i] - h[i] * S[i+1][j]) / diag[i];
+        }
+        return S;
+    }();
+    return S;
+}
 
-    // Set bmap to an alias into the q-specific b arrays
-    const std::array<const std::array<double, p_length>, b_length> &bmap = constant ? q_const[q-1] : q_noconst[q-1];
+// Finds the spline segment [bvalues[k], bvalues[k+1]] containing b, returning k and setting `c` to
+// the coefficients on y[k], y[k+1], m[k], and m[k+1] of the spline's value at b.
+static size_t spline_segment(const double &b, std::array<double, 4> &c) {
+    size_t k = std::upper_bound(bvalues.begin(), bvalues.end(), b) - bvalues.begin();
+    k = k == 0 ? 0 : std::min(k - 1, b_length - 2);
+    const double h = bvalues[k+1] - bvalues[k], t = (b - bvalues[k]) / h, u = 1 - t;
+    c[0] = u;
+    c[1] = t;
+    c[2] = (u*u*u - u) * h*h / 6;
+    c[3] = (t*t*t - t) * h*h / 6;
+    return k;
+}
 
-    // We need to calculate weights if using the JGMMON14 method
-    bool need_weights = (interp == interpolation::JGMMON14 || interp == interpolation::exact_or_JGMMON14);
-    // Linear and the exact_or_JGMMON14 methods let us return right away if we have an exact b value
-    bool exact_good = (interp == interpolation::exact_or_JGMMON14 || interp == interpolation::linear);
+// Second derivatives (at each tabulated b value) of the natural cubic splines through each p column
+// of a quantile table, calculated the first time the table is used with interpolation::spline.
+// Entries are only ever added, so references to them remain valid after the lock is released.
+static std::map<std::pair<unsigned int, bool>, std::unique_ptr<quantile_table>> spline_tables;
+static std::mutex spline_lock;
+static const quantile_table& spline_table(const unsigned int &q, const bool &constant, const std::array<double, p_length> *rows) {
+    std::lock_guard<std::mutex> lock(spline_lock);
+    std::unique_ptr<quantile_table> &m = spline_tables[std::make_pair(q, constant)];
+    if (!m) {
+        const spline_matrix &S = spline_operator();
+        m.reset(new quantile_table);
+        for (size_t i = 0; i < b_length; i++) {
+            bweights bw;
+            bw.first = 0;
+            bw.last = b_length - 1;
+            bw.w = S[i];
+            apply_weights(bw, rows, (*m)[i]);
+        }
+    }
+    return *m;
+}
 
-    // Will store the first b index greater than desired b (for linear interpolation)
-    size_t first_gt = -1;
+// Evaluates the splines through `rows` (with second derivatives `second`) on segment k, using the
+// coefficients from spline_segment().
+FRACDIST_KERNEL static void spline_rows(const std::array<double, 4> &c, const size_t &k,
+        const std::array<double, p_length> *rows, const quantile_table &second, std::array<double, p_length> &result) {
+    const std::array<double, p_length> &y0 = rows[k], &y1 = rows[k+1], &m0 = second[k], &m1 = second[k+1];
+    for (size_t i = 0; i < p_length; i++)
+        result[i] = c[0] * y0[i] + c[1] * y1[i] + c[2] * m0[i] + c[3] * m1[i];
+}
 
-    // Will store the weights used for JGMMON14 method
-    std::array<double, b_length> bweights;
-    // The first and last b indices having non-zero weights for JGMMON14 method
-    size_t bfirst = -1, blast = -1;
+// interpolation::chebyshev represents the JGMMON14-interpolated quantiles of a table, on each
+// interval [breaks[k], breaks[k+1]] between the b values at which JGMMON14 has kinks (see
+// chebyshev_breaks()), by Chebyshev expansions sum_j a_j T_j(x) in the rescaled
+// x = (2b - breaks[k] - breaks[k+1]) / (breaks[k+1] - breaks[k]) in [-1, 1].  (A single expansion
+// over the whole b range needs dozens of terms, while within an interval JGMMON14 is smooth and a
+// handful of terms suffice.)  The coefficients come from
+// interpolating at `cheb_nodes` Chebyshev nodes in the interval, which (since JGMMON14 is linear in
+// the table) makes each a_j a fixed weighting of the table rows; each interval's expansions are then
+// truncated at the lowest order that keeps every built-in table within chebyshev_tolerance of
+// JGMMON14 at `cheb_checks` evenly spaced b values in the interval.
+static const size_t cheb_nodes = 8, cheb_checks = 33;
 
-    for (size_t i = 0; i < b_length; i++) {
-        // First check for an exact match (for appropriate interpolation modes)
-        if (exact_good && bvalues[i] == b) {
-            // Exact match: simply return a copy of the quantiles
-            result = bmap[i];
-            qcache_store(q, b, constant, interp, result);
-            return result;
-        }
-        if (interp == interpolation::linear) {
-            if (bvalues[i] > b) {
-                first_gt = i;
-                break;
+// The b values at which the JGMMON14 interpolation has kinks: the tabulated b values, where the set
+// of regression points changes, and the points 0.2 from a tabulated b value, where a regression
+// weight reaches zero.
+static const std::vector<double>& chebyshev_breaks() {
+    static const std::vector<double> breaks = []() {
+        std::vector<double> br(bvalues.begin(), bvalues.end());
+        for (const double &b : bvalues) {
+            for (const double &kink : {b - 0.2, b + 0.2}) {
+                if (kink > bvalues.front() && kink < bvalues.back())
+                    br.push_back(kink);
             }
         }
-        else if (need_weights) {
-            double w = 1.0 - 5.0*fabs(bvalues[i] - b);
-            if (w > 1e-12) {
-                // Found a positive weight; store it.
-                bweights[i] = w;
-                if (bfirst == (size_t) -1) bfirst = i;
-                blast = i;
+        std::sort(br.begin(), br.end());
+        br.erase(std::unique(br.begin(), br.end(), [](const double &a, const double &b) { return b - a < 1e-9; }), br.end());
+        return br;
+    }();
+    return breaks;
+}
+
+// Finds the interval [breaks[k], breaks[k+1]] containing b, returning k and setting x to the
+// rescaled b value.  Throws for a b value (including NaN) outside the breaks, rather than clamping
+// it to the first or last interval.
+static size_t chebyshev_interval(const double &b, double &x) {
+    const std::vector<double> &br = chebyshev_breaks();
+    if (!(b >= br.front() && b <= br.back()))
+        throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << br.front() << " and " << br.back());
+    size_t k = std::upper_bound(br.begin(), br.end(), b) - br.begin();
+    k = k == 0 ? 0 : std::min(k - 1, br.size() - 2);
+    x = (2*b - br[k] - br[k+1]) / (br[k+1] - br[k]);
+    return k;
+}
+
+// The row weights giving each coefficient a_j of each interval (with a_0 halved, so that the
+// expansion is simply sum_j a_j T_j), calculated once.
+typedef std::vector<std::array<bweights, cheb_nodes>> chebyshev_basis;
+static const chebyshev_basis& chebyshev_basis_weights() {
+    static const std::unique_ptr<chebyshev_basis> basis = []() {
+        const std::vector<double> &br = chebyshev_breaks();
+        std::unique_ptr<chebyshev_basis> cb(new chebyshev_basis(br.size() - 1));
+        for (size_t k = 0; k < cb->size(); k++) {
+            for (auto &c : (*cb)[k]) {
+                c.first = b_length;
+                c.last = 0;
+                c.w.fill(0.0);
             }
-            else if (blast != (size_t) -1) {
-                // This weight is non-positive, but the previous weight was positive, so we're done.
-                break;
+            for (size_t n = 0; n < cheb_nodes; n++) {
+                const double theta = boost::math::constants::pi<double>() * (n + 0.5) / cheb_nodes;
+                const bweights node = interpolation_weights<interpolation::JGMMON14>(
+                        br[k] + (std::cos(theta) + 1) / 2 * (br[k+1] - br[k]));
+                for (size_t j = 0; j < cheb_nodes; j++) {
+                    bweights &c = (*cb)[k][j];
+                    const double f = (j == 0 ? 1.0 : 2.0) / cheb_nodes * std::cos(j * theta);
+                    for (size_t r = node.first; r <= node.last; r++)
+                        c.w[r] += f * node.w[r];
+                    c.first = std::min(c.first, node.first);
+                    c.last = std::max(c.last, node.last);
+                }
             }
         }
+        return cb;
+    }();
+    return *basis;
+}
+
+// The truncated Chebyshev coefficients of one quantile table: interval k uses coefficients
+// coef[start[k]] through coef[start[k+1]-1].
+struct chebyshev_fit {
+    std::vector<size_t> start;
+    std::vector<std::array<double, p_length>> coef;
+};
+
+// Calculates the expansion coefficients of every interval of a table (coef[k][j] is interval k's
+// a_j), and, if `needed` is not null, the number of terms each interval needs to keep the table
+// within chebyshev_tolerance of JGMMON14.  Throws if even the full expansion doesn't.
+static std::vector<std::array<std::array<double, p_length>, cheb_nodes>> chebyshev_coefficients(
+        const unsigned int &q, const bool &constant, const std::array<double, p_length> *rows, std::vector<size_t> *needed) {
+    const std::vector<double> &br = chebyshev_breaks();
+    const chebyshev_basis &cb = chebyshev_basis_weights();
+    std::vector<std::array<std::array<double, p_length>, cheb_nodes>> coef(cb.size());
+    if (needed) needed->assign(cb.size(), 0);
+    std::vector<std::array<double, p_length>> target(cheb_checks), partial(cheb_checks);
+    std::array<std::array<double, cheb_nodes>, cheb_checks> T;
+    for (size_t k = 0; k < cb.size(); k++) {
+        for (size_t j = 0; j < cheb_nodes; j++)
+            apply_weights(cb[k][j], rows, coef[k][j]);
+        if (!needed) continue;
+
+        for (size_t m = 0; m < cheb_checks; m++) {
+            const double b = m + 1 == cheb_checks ? br[k+1] : br[k] + m * (br[k+1] - br[k]) / (cheb_checks - 1);
+            apply_weights(interpolation_weights<interpolation::JGMMON14>(b), rows, target[m]);
+            partial[m].fill(0.0);
+            const double x = (2*b - br[k] - br[k+1]) / (br[k+1] - br[k]);
+            T[m][0] = 1;
+            T[m][1] = x;
+            for (size_t j = 2; j < cheb_nodes; j++)
+                T[m][j] = 2*x*T[m][j-1] - T[m][j-2];
+        }
+
+        // Add terms until every quantile at every check point is within the tolerance
+        size_t order = 0;
+        bool ok = false;
+        while (!ok && order < cheb_nodes) {
+            ok = true;
+            for (size_t m = 0; m < cheb_checks; m++) {
+                for (size_t i = 0; i < p_length; i++) {
+                    partial[m][i] += coef[k][order][i] * T[m][order];
+                    if (std::fabs(partial[m][i] - target[m][i]) > chebyshev_tolerance * std::max(1.0, std::fabs(target[m][i])))
+                        ok = false;
+                }
+            }
+            order++;
+        }
+        if (!ok)
+            throw std::runtime_error(ostringstream() << "chebyshev interpolation unavailable for q=" << q << (constant ? " (with constant)" : " (without constant)") <<
+                    ": " << cheb_nodes << " terms aren't within chebyshev_tolerance of JGMMON14 for b between " << br[k] << " and " << br[k+1]);
+        (*needed)[k] = order;
     }
+    return coef;
+}
 
-    if (interp == interpolation::linear) {
-        if (first_gt == 0 || first_gt == (size_t) -1) // Neither of these should be possible, but be defensive
-            throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bmin << " and " << bmax);
+// The fits are calculated the first time each table is used with interpolation::chebyshev, and
+// (like spline_tables) are only ever added.
+static std::map<std::pair<unsigned int, bool>, std::unique_ptr<chebyshev_fit>> chebyshev_fits;
+static std::mutex chebyshev_lock;
 
-        // The weight to put on first_gt-1 (1 minus this is the weight for first_gt):
-        const double w0 = (bvalues[first_gt] - b) / (bvalues[first_gt] - bvalues[first_gt-1]);
-        const double w1 = 1 - w0;
+// Keeps the first orders[k] coefficients of each interval k
+static std::unique_ptr<chebyshev_fit> truncate_chebyshev(const std::vector<std::array<std::array<double, p_length>, cheb_nodes>> &coef,
+        const std::vector<size_t> &orders) {
+    std::unique_ptr<chebyshev_fit> f(new chebyshev_fit);
+    for (size_t k = 0; k < coef.size(); k++) {
+        f->start.push_back(f->coef.size());
+        f->coef.insert(f->coef.end(), coef[k].begin(), coef[k].begin() + orders[k]);
+    }
+    f->start.push_back(f->coef.size());
+    return f;
+}
 
-        for (size_t i = 0; i < p_length; i++) {
-            result[i] = w0 * bmap[first_gt-1][i] + w1 * bmap[first_gt][i];
+// The number of expansion terms used in each interval: the most that any of the built-in tables
+// needs there.  The orders are shared by every table so that the interpolation stays a fixed
+// weighting of the table rows (see interpolation_weights()).  The built-in tables' fits are
+// calculated along with them.
+static const std::vector<size_t>& chebyshev_orders() {
+    static const std::vector<size_t> orders = []() {
+        std::vector<size_t> result(chebyshev_basis_weights().size(), 1), needed;
+        for (unsigned int q = 1; q <= q_length; q++) {
+            for (bool constant : {false, true}) {
+                chebyshev_coefficients(q, constant, table(q, constant), &needed);
+                for (size_t k = 0; k < result.size(); k++)
+                    result[k] = std::max(result[k], needed[k]);
+            }
         }
-        qcache_store(q, b, constant, interp, result);
+        std::lock_guard<std::mutex> lock(chebyshev_lock);
+        for (unsigned int q = 1; q <= q_length; q++)
+            for (bool constant : {false, true})
+                chebyshev_fits[std::make_pair(q, constant)] = truncate_chebyshev(chebyshev_coefficients(q, constant, table(q, constant), nullptr), result);
         return result;
+    }();
+    return orders;
+}
+
+// Returns the chebyshev fit of a table.  A table for q > q_length must be within the tolerance
+// using the built-in tables' orders, otherwise this throws.
+static const chebyshev_fit& chebyshev_table(const unsigned int &q, const bool &constant, const std::array<double, p_length> *rows) {
+    const std::vector<size_t> &orders = chebyshev_orders();
+    std::lock_guard<std::mutex> lock(chebyshev_lock);
+    std::unique_ptr<chebyshev_fit> &fit = chebyshev_fits[std::make_pair(q, constant)];
+    if (fit) return *fit;
+
+    std::vector<size_t> needed;
+    const auto coef = chebyshev_coefficients(q, constant, rows, &needed);
+    const std::vector<double> &br = chebyshev_breaks();
+    for (size_t k = 0; k < orders.size(); k++) {
+        if (needed[k] > orders[k])
+            throw std::runtime_error(ostringstream() << "chebyshev interpolation unavailable for q=" << q << (constant ? " (with constant)" : " (without constant)") <<
+                    ": " << needed[k] << " terms are needed for b between " << br[k] << " and " << br[k+1] << ", but only " << orders[k] << " are used");
+    }
+    fit = truncate_chebyshev(coef, orders);
+    return *fit;
+}
+
+// The row weights equivalent to the first `order` terms of interval k's expansion at x
+static bweights chebyshev_weights(const size_t &k, const double &x, const size_t &order) {
+    const std::array<bweights, cheb_nodes> &cb = chebyshev_basis_weights()[k];
+    bweights bw;
+    bw.first = cb[0].first;
+    bw.last = cb[0].last;
+    for (size_t r = bw.first; r <= bw.last; r++) bw.w[r] = 0.0;
+    double Tprev = x, Tj = 1; // T_{j-1} (taking T_{-1} = T_1) and T_j
+    for (size_t j = 0; j < order; j++) {
+        for (size_t r = bw.first; r <= bw.last; r++)
+            bw.w[r] += Tj * cb[j].w[r];
+        const double Tnext = 2*x*Tj - Tprev;
+        Tprev = Tj;
+        Tj = Tnext;
     }
-    else if (need_weights) {
-        // We can't compute the regression if we don't have at least three values:
-        if (blast - bfirst < 2)
-            throw std::runtime_error(ostringstream() << "b value (" << b << ") unsupported: not enough data points for quadratic approximation");
+    return bw;
+}
+
+// Evaluates the expansions of the `n` coefficient rows `coef` at x, for all quantiles at once, with
+// Clenshaw's recurrence
+FRACDIST_KERNEL static void clenshaw_rows(const double &x, const std::array<double, p_length> *coef, const size_t &n,
+        std::array<double, p_length> &result) {
+    std::array<double, p_length> b1, b2;
+    b1.fill(0.0);
+    b2.fill(0.0);
+    const double twox = 2*x;
+    for (size_t j = n; j-- > 1; ) {
+        const std::array<double, p_length> &c = coef[j];
+        for (size_t i = 0; i < p_length; i++) {
+            const double t = twox * b1[i] - b2[i] + c[i];
+            b2[i] = b1[i];
+            b1[i] = t;
+        }
+    }
+    for (size_t i = 0; i < p_length; i++)
+        result[i] = x * b1[i] - b2[i] + coef[0][i];
+}
+
+// Calculates the JGMMON14 regression weights 1 - 5|bvalues[i] - b| of the b values with positive
+// weights, which are `bvalues[first]` through `bvalues[last]`.  Throws if there are fewer than 3.
+static void jgmmon14_regression_weights(const double &b, std::array<double, b_length> &weights, size_t &first, size_t &last) {
+    first = last = -1;
+    for (size_t i = 0; i < b_length; i++) {
+        double w = 1.0 - 5.0*fabs(bvalues[i] - b);
+        if (w > 1e-12) {
+            // Found a positive weight; store it.
+            weights[i] = w;
+            if (first == (size_t) -1) first = i;
+            last = i;
+        }
+        else if (last != (size_t) -1) {
+            // This weight is non-positive, but the previous weight was positive, so we're done.
+            break;
+        }
+    }
+
+    // We can't compute the regression if we don't have at least three values:
+    if (last == (size_t) -1 || last - first < 2)
+        throw std::runtime_error(ostringstream() << "b value (" << b << ") unsupported: not enough data points for quadratic approximation");
+}
+
+// See description in fracdist/common.hpp
+template <interpolation interp>
+bweights interpolation_weights(const double &b) {
+    const double bmin = bvalues.front(), bmax = bvalues.back();
+    if (!(b >= bmin && b <= bmax))
+        throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bmin << " and " << bmax);
+
+    bweights bw;
+
+    // Linear, spline, and the exact_or_JGMMON14 methods let us use the exact data row if we have an exact b value
+    if (interp == interpolation::exact_or_JGMMON14 || interp == interpolation::linear || interp == interpolation::spline) {
+        for (size_t i = 0; i < b_length; i++) {
+            if (bvalues[i] == b) {
+                bw.first = bw.last = i;
+                bw.w[i] = 1.0;
+                return bw;
+            }
+        }
+    }
+
+    if (interp == interpolation::linear) {
+        // Find the first b index greater than desired b
+        size_t first_gt = std::upper_bound(bvalues.begin(), bvalues.end(), b) - bvalues.begin();
+        if (first_gt == 0 || first_gt == b_length) // Neither of these should be possible, but be defensive
+            throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bvalues.front() << " and " << bvalues.back());
+
+        bw.first = first_gt - 1;
+        bw.last = first_gt;
+        // The weight to put on first_gt-1 (1 minus this is the weight for first_gt):
+        bw.w[first_gt-1] = (bvalues[first_gt] - b) / (bvalues[first_gt] - bvalues[first_gt-1]);
+        bw.w[first_gt] = 1 - bw.w[first_gt-1];
+        return bw;
+    }
+    else if (interp == interpolation::spline) {
+        // The spline's value is c0 y[k] + c1 y[k+1] + c2 m[k] + c3 m[k+1], and m = S y
+        std::array<double, 4> c;
+        const size_t k = spline_segment(b, c);
+        const spline_matrix &S = spline_operator();
+        bw.first = 0;
+        bw.last = b_length - 1;
+        for (size_t j = 0; j < b_length; j++)
+            bw.w[j] = c[2] * S[k][j] + c[3] * S[k+1][j];
+        bw.w[k] += c[0];
+        bw.w[k+1] += c[1];
+        return bw;
+    }
+    else if (interp == interpolation::chebyshev) {
+        // The truncation orders are the same for every table, so these give exactly the quantiles'
+        // expansions
+        double x;
+        const size_t k = chebyshev_interval(b, x);
+        return chebyshev_weights(k, x, chebyshev_orders()[k]);
+    }
+    else if (interp == interpolation::JGMMON14 || interp == interpolation::exact_or_JGMMON14) {
+        // The regression weights (not to be confused with the row weights we are calculating)
+        std::array<double, b_length> bweights;
+        size_t bfirst, blast;
+        jgmmon14_regression_weights(b, bweights, bfirst, blast);
 
         // This follows MacKinnon and Nielsen (2014) which calculated quantiles using a fitted quadratic
         // of nearby points.
@@ -119,42 +446,300 @@ const std::array<double, p_length> quantiles(const unsigned int &q, const double
         // where F is the quantile value, w is the weight associated with b, and b are the b values.
         // The interpolated F' is then the fitted value from the regression evaluted at the desired
         // b.
+        //
+        // The regressors are the same for each of the 221 quantile values, and the fitted value is
+        // linear in the regressand: F' = wantx (X'X)^{-1} X' W F, so we calculate the row weights
+        // wantx (X'X)^{-1} X' W just once.
 
-        // The regressors don't change, so calculate the X and SVD decomposition just once:
+        quadratic_fit<b_length> fit(&bvalues[bfirst], &bweights[bfirst], blast-bfirst+1);
+        fit.fitted_weights(b, &bw.w[bfirst]);
 
-        MatrixX3d X(blast-bfirst+1, 3);
-        for (size_t i = bfirst; i <= blast; i++) {
-            X(i-bfirst, 0) = bweights[i];
-            X(i-bfirst, 1) = bweights[i] * bvalues[i];
-            X(i-bfirst, 2) = bweights[i] * bvalues[i] * bvalues[i];
+        bw.first = bfirst;
+        bw.last = blast;
+        for (size_t i = bfirst; i <= blast; i++)
+            bw.w[i] *= bweights[i];
+        return bw;
+    }
+
+    throw std::runtime_error("Internal error (BUG): unhandled interpolation");
+}
+
+// The derivatives with respect to b of the b weights of interpolation mode `interp`, which give
+// the derivatives of the interpolated quantiles when applied to a table.  `cheb_order` is the
+// number of expansion terms used (for interpolation::chebyshev only).  At a kink (a tabulated b
+// value, for most modes), one of the one-sided derivatives or their average is used.
+static bweights interpolation_weight_derivatives(const double &b, const interpolation &interp, const size_t &cheb_order) {
+    const double bmin = bvalues.front(), bmax = bvalues.back();
+    if (!(b >= bmin && b <= bmax))
+        throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bmin << " and " << bmax);
+
+    bweights dw;
+    if (interp == interpolation::linear || interp == interpolation::spline) {
+        std::array<double, 4> c;
+        const size_t k = spline_segment(b, c);
+        const double h = bvalues[k+1] - bvalues[k];
+        dw.first = k;
+        dw.last = k+1;
+        dw.w[k] = -1 / h;
+        dw.w[k+1] = 1 / h;
+        if (interp == interpolation::spline) {
+            // Differentiate spline_segment()'s coefficients (with t = 1 - u = (b - bvalues[k]) / h)
+            const double t = c[1], u = c[0];
+            const double dc2 = -(3*u*u - 1) * h / 6, dc3 = (3*t*t - 1) * h / 6;
+            const spline_matrix &S = spline_operator();
+            dw.first = 0;
+            dw.last = b_length - 1;
+            for (size_t j = 0; j < b_length; j++)
+                dw.w[j] = dc2 * S[k][j] + dc3 * S[k+1][j];
+            dw.w[k] -= 1 / h;
+            dw.w[k+1] += 1 / h;
         }
+        return dw;
+    }
+    else if (interp == interpolation::chebyshev) {
+        // d/db sum_j a_j T_j(x) = dx/db sum_j a_j j U_{j-1}(x)
+        double x;
+        const size_t k = chebyshev_interval(b, x);
+        const std::vector<double> &br = chebyshev_breaks();
+        const std::array<bweights, cheb_nodes> &cb = chebyshev_basis_weights()[k];
+        const double dxdb = 2 / (br[k+1] - br[k]);
+        dw.first = cb[0].first;
+        dw.last = cb[0].last;
+        for (size_t r = dw.first; r <= dw.last; r++) dw.w[r] = 0.0;
+        double Uprev = 0, Uj = 1; // U_{j-2} and U_{j-1}
+        for (size_t j = 1; j < cheb_order; j++) {
+            for (size_t r = dw.first; r <= dw.last; r++)
+                dw.w[r] += dxdb * j * Uj * cb[j].w[r];
+            const double Unext = 2*x*Uj - Uprev;
+            Uprev = Uj;
+            Uj = Unext;
+        }
+        return dw;
+    }
 
-        JacobiSVD<MatrixXd> svd(X, ComputeThinU | ComputeThinV);
+    // JGMMON14 (and exact_or_JGMMON14, whose quantiles are those of JGMMON14 except at the tabulated
+    // b values themselves).  The interpolated quantile is x(b)'a, where a is the coefficient vector of
+    // the regression with rows w_i (1, b_i, b_i^2) and regressands w_i F_i; the row weights w_i also
+    // depend on b, so the derivative is x'(b)a + x(b)'G^{-1} sum_i 2 w_i w_i' x_i r_i, where r_i is
+    // the residual F_i - x_i'a.  The second term is sum_i 2 w_i' omega_i r_i, with omega the weights
+    // on w_i F_i of the fitted value at b.
+    std::array<double, b_length> weights;
+    size_t first, last;
+    jgmmon14_regression_weights(b, weights, first, last);
+    const size_t n = last - first + 1;
+    quadratic_fit<b_length> fit(&bvalues[first], &weights[first], n);
+    std::array<double, b_length> omega, slope, hat;
+    fit.fitted_weights(b, omega.data());
+    fit.slope_weights(b, slope.data());
+    dw.first = first;
+    dw.last = last;
+    for (size_t k = 0; k < n; k++)
+        dw.w[first + k] = slope[k] * weights[first + k];
+    for (size_t i = 0; i < n; i++) {
+        // dw_i/db, taking 0 at the kink where b equals b_i
+        const double bi = bvalues[first + i];
+        const double dwi = bi > b ? 5.0 : bi < b ? -5.0 : 0.0;
+        if (dwi == 0) continue;
+        const double f = 2 * dwi * omega[i];
+        // r_i = F_i - sum_k hat_k w_k F_k, where hat are the weights of the fitted value at b_i
+        fit.fitted_weights(bi, hat.data());
+        dw.w[first + i] += f;
+        for (size_t k = 0; k < n; k++)
+            dw.w[first + k] -= f * hat[k] * weights[first + k];
+    }
+    return dw;
+}
 
-        RowVector3d wantx;
-        wantx(0) = 1.0;
-        wantx(1) = b;
-        wantx(2) = b*b;
+// See description in fracdist/common.hpp
+FRACDIST_KERNEL void apply_weights(const bweights &bw, const std::array<double, p_length> *rows, std::array<double, p_length> &result) {
+    result.fill(0.0);
+    for (size_t j = bw.first; j <= bw.last; j++) {
+        const double w = bw.w[j];
+        for (size_t i = 0; i < p_length; i++)
+            result[i] += w * rows[j][i];
+    }
+}
 
-        VectorXd y(blast-bfirst+1);
+// See description in fracdist/common.hpp
+const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const interpolation &interp) {
+    return quantiles(q, b, constant, interp, 0);
+}
 
-        // The regressand changes for each quantile value, which means we rerun the regression for
-        // each of the 221 quantile values using the same X matrix, but different weighted y values.
-        for (size_t i = 0; i < p_length; i++) {
-            for (size_t j = bfirst; j <= blast; j++) {
-                y(j-bfirst) = bweights[j] * bmap[j][i];
+// See description in fracdist/common.hpp
+const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const interpolation &interp, const unsigned int &T) {
+    switch (interp) {
+        case interpolation::JGMMON14: return quantiles<interpolation::JGMMON14>(q, b, constant, T);
+        case interpolation::exact_or_JGMMON14: return quantiles<interpolation::exact_or_JGMMON14>(q, b, constant, T);
+        case interpolation::linear: return quantiles<interpolation::linear>(q, b, constant, T);
+        case interpolation::spline: return quantiles<interpolation::spline>(q, b, constant, T);
+        case interpolation::chebyshev: return quantiles<interpolation::chebyshev>(q, b, constant, T);
+    }
+    throw std::runtime_error("Internal error (BUG): unhandled interpolation");
+}
+
+// See description in fracdist/common.hpp
+template <interpolation interp>
+const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const unsigned int &T) {
+    bool same_params = qcache.cached &&
+        qcache.q == q && qcache.b == b && qcache.constant == constant && qcache.interp == interp;
+
+    if (same_params && qcache.T == T) {
+        FRACDIST_STATS_COUNT(qcache_hits);
+        return qcache.cache;
+    }
+    FRACDIST_STATS_COUNT(qcache_misses);
+
+    if (q < 1)
+        throw std::out_of_range(ostringstream() << "q value (" << q << ") invalid: q must be at least 1 (and no larger than " << q_length <<
+                " unless a table is supplied via fracdist::set_table_directory() or fracdist::add_table())");
+    const double bmin = bvalues.front(), bmax = bvalues.back();
+    if (!(b >= bmin && b <= bmax))
+        throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bmin << " and " << bmax);
+    if (T > 0 && rs_length == 0)
+        throw std::runtime_error(ostringstream() << "finite-sample quantiles (T=" << T << ") unavailable: fracdist was built without response surface data");
+    if (T > 0 && q > q_length)
+        throw std::runtime_error(ostringstream() << "finite-sample quantiles (T=" << T << ") unavailable: no response surface data for q > " << q_length);
+
+    bweights bw;
+    bool have_bw = false;
+    if (!same_params) {
+        FRACDIST_STATS_TIME(quantiles_interpolation);
+        // Set bmap to the q-specific b arrays (this also checks that we have data for q)
+        const std::array<double, p_length> *bmap = table(q, constant);
+
+        if (interp == interpolation::spline) {
+            // Evaluate the precalculated splines directly rather than applying the (dense) weights.
+            // (At a tabulated b value this gives exactly the tabulated quantiles.)
+            std::array<double, 4> c;
+            const size_t k = spline_segment(b, c);
+            spline_rows(c, k, bmap, spline_table(q, constant, bmap), qcache.asymptotic);
+        }
+        else if (interp == interpolation::chebyshev) {
+            const chebyshev_fit &fit = chebyshev_table(q, constant, bmap);
+            double x;
+            const size_t k = chebyshev_interval(b, x);
+            clenshaw_rows(x, &fit.coef[fit.start[k]], fit.start[k+1] - fit.start[k], qcache.asymptotic);
+        }
+        else {
+            bw = interpolation_weights<interp>(b);
+            have_bw = true;
+            apply_weights(bw, bmap, qcache.asymptotic);
+        }
+
+        qcache.cached = true;
+        qcache.q = q;
+        qcache.b = b;
+        qcache.constant = constant;
+        qcache.interp = interp;
+        qcache.rs_cached = false;
+    }
+
+    if (T == 0) {
+        qcache.T = 0;
+        qcache.cache = qcache.asymptotic;
+        return qcache.cache;
+    }
+
+    if (!qcache.rs_cached) {
+        FRACDIST_STATS_TIME(quantiles_interpolation);
+        // The response surface coefficients get interpolated across b exactly as the quantiles do
+        if (!have_bw) {
+            if (interp == interpolation::chebyshev) {
+                // Use the same truncated expansion as the asymptotic quantiles
+                const chebyshev_fit &fit = chebyshev_table(q, constant, table(q, constant));
+                double x;
+                const size_t k = chebyshev_interval(b, x);
+                bw = chebyshev_weights(k, x, fit.start[k+1] - fit.start[k]);
+            }
+            else bw = interpolation_weights<interp>(b);
+        }
+        const auto &rsmap = constant ? rs_const[q-1] : rs_noconst[q-1];
+        for (size_t k = 0; k < rs_length; k++) {
+            std::array<double, p_length> &coef = qcache.rs[k];
+            coef.fill(0.0);
+            for (size_t j = bw.first; j <= bw.last; j++) {
+                const double w = bw.w[j];
+                for (size_t i = 0; i < p_length; i++)
+                    coef[i] += w * rsmap[j][k][i];
             }
+        }
+        qcache.rs_cached = true;
+    }
 
-            result[i] = wantx * svd.solve(y);
+    // Q_T = Q + c_1/T + c_2/T^2 + ... + c_K/T^K, evaluated via Horner's method
+    const double Tinv = 1.0 / T;
+    std::array<double, p_length> &result = qcache.cache;
+    if (rs_length > 0) {
+        result = qcache.rs[rs_length-1];
+        for (size_t k = rs_length-1; k > 0; k--) {
+            for (size_t i = 0; i < p_length; i++)
+                result[i] = result[i] * Tinv + qcache.rs[k-1][i];
         }
+        for (size_t i = 0; i < p_length; i++)
+            result[i] = result[i] * Tinv + qcache.asymptotic[i];
+    }
+    qcache.T = T;
+    return result;
+}
 
-        qcache_store(q, b, constant, interp, result);
-        return result;
+// See description in fracdist/common.hpp
+const std::array<double, p_length> quantile_derivatives(const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp, const unsigned int &T) {
+    if (dcache.cached && dcache.q == q && dcache.b == b && dcache.constant == constant && dcache.interp == interp && dcache.T == T)
+        return dcache.derivs;
+
+    // This checks the parameters (and fits the spline or chebyshev expansions, if needed)
+    quantiles(q, b, constant, interp, T);
+
+    const std::array<double, p_length> *bmap = table(q, constant);
+    size_t cheb_order = 0;
+    if (interp == interpolation::chebyshev) {
+        const chebyshev_fit &fit = chebyshev_table(q, constant, bmap);
+        double x;
+        const size_t k = chebyshev_interval(b, x);
+        cheb_order = fit.start[k+1] - fit.start[k];
     }
+    const bweights dw = interpolation_weight_derivatives(b, interp, cheb_order);
+    std::array<double, p_length> &result = dcache.derivs;
+    dcache.cached = false;
+    apply_weights(dw, bmap, result);
 
-    throw std::runtime_error("Internal error (BUG): unhandled interpolation");
+    // The response surface coefficients are interpolated with the same weights, so the derivative of
+    // Q + c_1/T + ... + c_K/T^K just uses the derivatives of the c_k
+    const double Tinv = 1.0 / T;
+    const auto &rsmap = constant ? rs_const[q-1] : rs_noconst[q-1];
+    std::array<double, p_length> scaled;
+    double Tk = 1;
+    for (size_t k = 0; T > 0 && k < rs_length; k++) {
+        Tk *= Tinv;
+        scaled.fill(0.0);
+        for (size_t j = dw.first; j <= dw.last; j++) {
+            const double w = dw.w[j];
+            for (size_t i = 0; i < p_length; i++)
+                scaled[i] += w * rsmap[j][k][i];
+        }
+        for (size_t i = 0; i < p_length; i++)
+            result[i] += Tk * scaled[i];
+    }
+    dcache.cached = true;
+    dcache.q = q;
+    dcache.b = b;
+    dcache.constant = constant;
+    dcache.interp = interp;
+    dcache.T = T;
+    return result;
 }
 
+#define FRACDIST_INSTANTIATE_INTERP(I) \
+    template const std::array<double, p_length> quantiles<I>(const unsigned int&, const double&, const bool&, const unsigned int&); \
+    template bweights interpolation_weights<I>(const double&);
+FRACDIST_INSTANTIATE_INTERP(interpolation::JGMMON14)
+FRACDIST_INSTANTIATE_INTERP(interpolation::exact_or_JGMMON14)
+FRACDIST_INSTANTIATE_INTERP(interpolation::linear)
+FRACDIST_INSTANTIATE_INTERP(interpolation::spline)
+FRACDIST_INSTANTIATE_INTERP(interpolation::chebyshev)
+#undef FRACDIST_INSTANTIATE_INTERP
+
 // See description in common.hpp
 std::pair<size_t, size_t> find_bracket(const size_t &center, const size_t &max, const size_t &size) {
     std::pair<size_t, size_t> bracket(0, 0);
@@ -166,26 +751,83 @@ std::pair<size_t, size_t> find_bracket(const size_t &center, const size_t &max,
     return bracket;
 }
 
-unsigned int chisq_inv_cache_q = 0;
-std::array<double, p_length> chisq_inv_cache;
-boost::math::chi_squared_distribution<double> chisq_dist(1);
-/** Returns the inverse chi squared cdf at `pvalues[pval_index]` with q^2 degrees of freedom.  The
- * value is cached (so long as q doesn't change) so that subsequent calls for the same value are
- * very fast.
- */
+// chisq_inv_cache[q-1][i] caches the inverse chi-squared cdf at pvalues[i] with q^2 degrees of
+// freedom, or is -1 if not yet calculated.  Each q has its own cache so that alternating between q
+// values (as when testing a sequence of cointegration ranks) doesn't throw away cached values.  Like
+// qcache, this is per-thread.
+static thread_local std::vector<std::array<double, p_length>> chisq_inv_cache;
+// See description in fracdist/common.hpp
 double chisq_inv_p_i(const size_t &pval_index, const unsigned int &q) {
-    if (!q || q != chisq_inv_cache_q) {
-        // Reset the cache to -1 (which we ignore)
-        chisq_inv_cache.fill(-1);
-        chisq_inv_cache_q = q;
-        chisq_dist = boost::math::chi_squared_distribution<double>(q*q);
+    if (q == 0)
+        throw std::out_of_range("q value (0) invalid: q must be at least 1");
+    if (q > chisq_inv_cache.size()) {
+        std::array<double, p_length> unset;
+        unset.fill(-1);
+        chisq_inv_cache.resize(q, unset);
+    }
+    double &cached = chisq_inv_cache[q-1][pval_index];
+    if (cached < 0) {
+        FRACDIST_STATS_COUNT(chisq_cache_misses);
+        FRACDIST_STATS_TIME(chisq);
+        cached = quantile(boost::math::chi_squared_distribution<double>(q*q), pvalues[pval_index]);
     }
-    else if (chisq_inv_cache[pval_index] >= 0 ) {
-        return chisq_inv_cache[pval_index];
+    else {
+        FRACDIST_STATS_COUNT(chisq_cache_hits);
     }
 
-    return chisq_inv_cache[pval_index] = quantile(chisq_dist, pvalues[pval_index]);
+    return cached;
 }
 
+// See description in fracdist/common.hpp
+FRACDIST_KERNEL double chisq_cdf_upper(const unsigned int &q, const double &x) {
+    FRACDIST_STATS_TIME(chisq);
+    // NB: complement gets the *upper-tail* chisq cdf
+    return cdf(complement(boost::math::chi_squared_distribution<double>(q*q), x));
+}
+
+// See description in fracdist/common.hpp
+double chisq_pdf(const unsigned int &q, const double &x) {
+    FRACDIST_STATS_TIME(chisq);
+    return pdf(boost::math::chi_squared_distribution<double>(q*q), x);
+}
+
+// See description in fracdist/common.hpp
+FRACDIST_KERNEL double chisq_inv(const unsigned int &q, const double &p) {
+    FRACDIST_STATS_TIME(chisq);
+    return quantile(boost::math::chi_squared_distribution<double>(q*q), p);
+}
+
+// See description in fracdist/common.hpp
+const char* status_message(const status &s) noexcept {
+    switch (s) {
+        case status::ok: return "success";
+        case status::invalid_q: return "invalid q value: q must be at least 1, and larger than q_length only if a table is available";
+        case status::invalid_b: return "invalid b value: b is outside the range of the quantile data";
+        case status::invalid_test_stat: return "invalid test statistic: cannot be negative";
+        case status::invalid_test_level: return "invalid test level: must be between 0 and 1";
+        case status::invalid_approx_points: return "approx_points too small: not enough data points for quadratic approximation";
+        case status::no_response_surface: return "finite-sample quantiles unavailable: no response surface data";
+        case status::table_error: return "unable to load the quantile table for q";
+        case status::internal_error: return "internal error";
+        case status::no_solution: return "no solution: the p-value does not reach the level in the supported range";
+    }
+    return "unknown status";
 }
 
+// See description in fracdist/common.hpp
+status check_parameters(const unsigned int &q, const double &b, const bool &constant, const unsigned int &T) noexcept {
+    if (q < 1) return status::invalid_q;
+    if (q > q_length) {
+        try {
+            if (!have_table(q, constant)) return status::invalid_q;
+        }
+        catch (...) {
+            return status::table_error;
+        }
+    }
+    if (!(b >= bvalues.front() && b <= bvalues.back())) return status::invalid_b;
+    if (T > 0 && (rs_length == 0 || q > q_length)) return status::no_response_surface;
+    return status::ok;
+}
+
+}
@@ -3,18 +3,34 @@
 #include <fracdist/data.hpp>
 #include <cmath>
 #include <sstream>
+#include <stdexcept>
 
 /** @file fracdist/common.hpp
  * @brief Header file for various common fracdist functionality.
  */
 
+/// @cond INTERNAL
+/* FRACDIST_KERNEL marks a numerical kernel to be compiled for several x86-64 instruction set levels
+ * (the baseline, AVX2/FMA, and AVX-512), with the best version for the running CPU chosen once, when
+ * the library is loaded.  This needs GCC 11 or newer and ifunc support (x86-64 Linux); elsewhere, or
+ * when FRACDIST_NO_CPU_DISPATCH is defined, it expands to nothing.  cpu_dispatch() (in
+ * fracdist/version.hpp) reports the chosen level.  The files using it are compiled with
+ * -ffp-contract=off (see CMakeLists.txt), so that every level gives bitwise identical results.
+ */
+#if !defined(FRACDIST_NO_CPU_DISPATCH) && defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11 && \
+    defined(__x86_64__) && defined(__linux__)
+#define FRACDIST_CPU_DISPATCH 1
+#define FRACDIST_KERNEL __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define FRACDIST_KERNEL
+#endif
+/// @endcond
+
 /** Namespace for all fracdist library code. */
 namespace fracdist {
 
 /** An enum giving the different quantile interpolation types supported by pvalue_advanced() and
  * critical_advanced().
- *
- * \todo add a spline interpolation mode
  */
 enum class interpolation {
     /** Quadratic fitting of nearby points as described in MacKinnon and Nielsen (2014).  This
@@ -38,18 +54,86 @@ enum class interpolation {
      * quantiles for an exact match of `b` value.  Unlike interpolation::exact_or_JGMMON14, this method has no
      * discontinuities for changes in `b` (but does have kinks at each known `b` value).
      */
-    linear
+    linear,
+    /** Natural cubic spline interpolation through the quantiles at every known `b` value (separately
+     * for each q, constant, and p value).  Like interpolation::linear, this returns exactly the data's
+     * quantiles for an exact match of `b` value, but the interpolated quantiles are also smooth (with
+     * continuous first and second derivatives) in `b`.  The spline coefficients for a quantile table
+     * are calculated the first time the table is used, after which interpolating at a new `b` value
+     * costs only a cubic polynomial evaluation per quantile.
+     */
+    spline,
+    /** A fast approximation of interpolation::JGMMON14: between each pair of adjacent `b` values at
+     * which the JGMMON14 interpolation has a kink (the known `b` values, and the points 0.2 away
+     * from them), each quantile is represented by a short Chebyshev expansion in `b` (fitted to the
+     * JGMMON14 interpolation at 8 Chebyshev nodes), truncated in each interval at the lowest order
+     * that keeps every built-in table within fracdist::chebyshev_tolerance of
+     * interpolation::JGMMON14.  (The orders are the same for every table, so interpolation_weights()
+     * gives exactly these quantiles.)  The expansions of the built-in tables are all fitted the
+     * first time this mode is used (which takes roughly 0.1 seconds); after that, interpolating at a
+     * new `b` value is a Clenshaw recurrence over 4 to 6 coefficients per quantile, which is
+     * considerably cheaper than the JGMMON14 regressions.  A table for a larger q (see fracdist/tables.hpp) that needs more terms
+     * than the built-in tables can't be used with this mode: quantiles() throws a
+     * std::runtime_error for it.
+     */
+    chebyshev
+};
+
+/** The maximum difference (checked at 33 evenly spaced points between each pair of adjacent
+ * kinks) between the quantiles of interpolation::chebyshev and interpolation::JGMMON14, as a
+ * fraction of the quantile for quantiles larger than 1, and as an absolute difference otherwise.
+ */
+constexpr double chebyshev_tolerance = 1e-5;
+
+/** Status codes returned by the non-throwing fracdist functions (such as try_pvalue() and
+ * pvalue_batch()).  Each non-`ok` value corresponds to an exception that the throwing version of the
+ * function would have thrown; status_message() gives a description.
+ */
+enum class status {
+    /// Success
+    ok = 0,
+    /// The q value is less than 1 or has no quantile table
+    invalid_q,
+    /// The b value is outside the supported range
+    invalid_b,
+    /// The test statistic is negative (or NaN)
+    invalid_test_stat,
+    /// The test level is outside [0, 1] (or NaN)
+    invalid_test_level,
+    /// approx_points is too small for the quadratic approximation at this test statistic or level
+    invalid_approx_points,
+    /// A finite-sample (T > 0) value was requested without response surface data for the q value
+    no_response_surface,
+    /// An external quantile table for the q value could not be loaded
+    table_error,
+    /// Any other failure (such as memory allocation failure)
+    internal_error,
+    /// A root finding function (such as solve_b_batch()) found no solution
+    no_solution
 };
 
+/** Returns a (static, unformatted) description of a status code. */
+const char* status_message(const status &s) noexcept;
+
+/** Checks q, b, constant, and T values without throwing, returning the status that quantiles()
+ * would fail with (or status::ok if they are valid).
+ */
+status check_parameters(const unsigned int &q, const double &b, const bool &constant, const unsigned int &T) noexcept;
+
 /** Takes \f$q\f$, \f$b\f$, constant, and interpolation mode values and calculates the quantiles for
  * the given set of values.  If any of the values is invalid, throws an exception.
  *
  * The result of the previous call is cached so that calling quantiles() a second time with the same
- * q, b, constant, and interp values will not re-perform the necessary calculations.
+ * q, b, constant, and interp values will not re-perform the necessary calculations.  The cache is
+ * kept separately for each thread, so quantiles() (and the functions that use it) may be called
+ * from multiple threads simultaneously.
  *
  * This function is mainly used for internal use by the other functions in this file, but may be
  * useful for other purposes.
  *
+ * `q` values larger than `fracdist::q_length` are accepted if a table for them has been made
+ * available; see fracdist/tables.hpp.
+ *
  * \throws std::out_of_range for an invalid b, q value
  * \throws std::runtime_error if approx_points is there are no enough data points to estimate a
  * quadratic approximation.  This shouldn't happen, normally, as the data and weights ensure that
@@ -57,6 +141,90 @@ enum class interpolation {
  */
 const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const interpolation &interp);
 
+/** Like quantiles(), but also takes a sample size \f$T\f$ and returns finite-sample quantiles
+ * from the response surface data (see fracdist::rs_const).  The response surface coefficients are
+ * interpolated across b exactly as the asymptotic quantiles are, and are cached along with them, so
+ * that a subsequent call differing only in `T` costs just `rs_length` multiply-adds per quantile.
+ *
+ * A `T` of 0 is treated as \f$T = \infty\f$, i.e. gives the same asymptotic quantiles as
+ * quantiles() without a `T` argument.
+ *
+ * \throws std::out_of_range for an invalid b, q value
+ * \throws std::runtime_error if `T > 0` and fracdist was built without response surface data (that
+ * is, when `fracdist::rs_length == 0`).
+ */
+const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const interpolation &interp, const unsigned int &T);
+
+/** Like quantiles(), but with the interpolation mode fixed at compile time.  The runtime versions
+ * of quantiles() dispatch to this; it is instantiated in the library for every interpolation mode.
+ */
+template <interpolation Interp>
+const std::array<double, p_length> quantiles(const unsigned int &q, const double &b, const bool &constant, const unsigned int &T = 0);
+
+/** Calculates the derivatives with respect to `b` of the quantiles returned by quantiles() for the
+ * same arguments.  These are exact (closed-form) derivatives of the interpolation: for
+ * interpolation::JGMMON14 they include the dependence of the regression weights on `b`.  For
+ * interpolation::exact_or_JGMMON14 (whose quantiles jump at the known `b` values) they are the
+ * derivatives of the interpolation::JGMMON14 quantiles.  At a kink in the interpolated quantiles
+ * (such as the known `b` values for interpolation::linear), either of the one-sided derivatives,
+ * or their average, is returned.
+ *
+ * Like quantiles(), the result of the previous call (in each thread) is cached.
+ *
+ * \throws std::out_of_range for an invalid b, q value
+ * \throws std::runtime_error if `T > 0` and fracdist was built without response surface data.
+ */
+const std::array<double, p_length> quantile_derivatives(const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp, const unsigned int &T = 0);
+
+/** The weights on the tabulated b values (fracdist::bvalues) that produce the interpolated quantiles
+ * for a particular b value and interpolation mode.  Every supported interpolation mode is linear in
+ * the tabulated quantiles, so the interpolated quantiles are simply the weighted sum of the
+ * quantile rows for b values `bvalues[first]` through `bvalues[last]` (for interpolation::spline
+ * and interpolation::chebyshev, this is generally all of the rows).  Since the weights depend only on b (and not on q, the
+ * constant, or the p value), they can be calculated once and applied to any number of quantile
+ * tables (see apply_weights()).
+ */
+struct bweights {
+    /// The index of the first b value with a (potentially) non-zero weight
+    size_t first;
+    /// The index of the last b value with a (potentially) non-zero weight
+    size_t last;
+    /// The weights; only elements `first` through `last` are meaningful.
+    std::array<double, b_length> w;
+};
+
+/** Calculates the b weights for the given b value and interpolation mode.
+ *
+ * \throws std::out_of_range for an invalid b value
+ * \throws std::runtime_error if there are not enough data points to estimate the quadratic
+ * approximation (this shouldn't happen).
+ */
+bweights interpolation_weights(const double &b, const interpolation &interp);
+
+/** Like interpolation_weights(), but with the interpolation mode fixed at compile time.  Instantiated
+ * in the library for every interpolation mode.
+ */
+template <interpolation Interp>
+bweights interpolation_weights(const double &b);
+
+/// @cond INTERNAL
+#define FRACDIST_EXTERN_INTERP(I) \
+    extern template const std::array<double, p_length> quantiles<I>(const unsigned int&, const double&, const bool&, const unsigned int&); \
+    extern template bweights interpolation_weights<I>(const double&);
+FRACDIST_EXTERN_INTERP(interpolation::JGMMON14)
+FRACDIST_EXTERN_INTERP(interpolation::exact_or_JGMMON14)
+FRACDIST_EXTERN_INTERP(interpolation::linear)
+FRACDIST_EXTERN_INTERP(interpolation::spline)
+FRACDIST_EXTERN_INTERP(interpolation::chebyshev)
+#undef FRACDIST_EXTERN_INTERP
+/// @endcond
+
+/** Applies the given b weights to a set of `b_length` quantile rows (such as the rows returned by
+ * fracdist::table()), storing the interpolated quantiles in `result`.
+ */
+void apply_weights(const bweights &bw, const std::array<double, p_length> *rows, std::array<double, p_length> &result);
+
 /** Takes a value and array and returns the index of the array value closest to the given value.
  * In the event of a tie, the lower index is returned.
  */
@@ -86,11 +254,22 @@ size_t find_closest(const double &value, const Container &array) {
 std::pair<size_t, size_t> find_bracket(const size_t &center, const size_t &max, const size_t &size);
 
 /** Returns the inverse chi squared cdf at `pvalues[pval_index]` with \f$q^2\f$ degrees of freedom.
- * The value is cached (so long as the same `q` is used) so that subsequent calls for the same value
- * are very fast.
+ * The value is cached (separately for each `q`) so that subsequent calls for the same value are very
+ * fast.
  */
 double chisq_inv_p_i(const size_t &pval_index, const unsigned int &q);
 
+/** Returns the upper tail of the chi squared cdf (i.e. 1 minus the cdf) at `x` with \f$q^2\f$ degrees
+ * of freedom.
+ */
+double chisq_cdf_upper(const unsigned int &q, const double &x);
+
+/** Returns the chi squared density at `x` with \f$q^2\f$ degrees of freedom. */
+double chisq_pdf(const unsigned int &q, const double &x);
+
+/** Returns the inverse chi squared cdf at `p` with \f$q^2\f$ degrees of freedom. */
+double chisq_inv(const unsigned int &q, const double &p);
+
 /** Wrapper object around std::ostringstream that overrides the `<<` operator and is castable to a
  * std::string.  Thie is primarily intended for quickly building strings via a construction such as:
  *
@@ -102,11 +281,27 @@ class ostringstream : public std::ostringstream {
     public:
         /// Constructs a new empty std::ostringstream wrapper
         ostringstream() : std::ostringstream() {}
-        /// Forwards anything shifted onto this object to std::ostringstream
-        template <typename T> ostringstream& operator<<(const T &v) { std::ostringstream::operator<<(v); return *this; }
         /// Can be cast implicitly to a std::string whenever required.
         operator std::string() const { return str(); }
 };
 
+/// Forwards anything shifted onto a fracdist::ostringstream to std::ostringstream
+template <typename T> ostringstream& operator<<(ostringstream &s, const T &v) {
+    static_cast<std::ostringstream&>(s) << v; return s;
+}
+/// Rvalue version of the above, used for temporaries such as `ostringstream() << "a" << b`.
+template <typename T> ostringstream& operator<<(ostringstream &&s, const T &v) {
+    static_cast<std::ostringstream&>(s) << v; return s;
+}
+
+/// @cond INTERNAL
+namespace detail {
+/* Throws the exception for an approx_points value that is too small. */
+[[noreturn]] inline void throw_approx_points(const unsigned int &approx_points) {
+    throw std::runtime_error(ostringstream() << "approx_points (" << approx_points << ") too small: not enough data points for quadratic approximation");
+}
+}
+/// @endcond
+
 
 }
@@ -1,79 +1,91 @@
 #include <fracdist/critical.hpp>
-#include <boost/math/distributions/chi_squared.hpp>
-#include <sstream>
-#include <Eigen/Core>
-#include <Eigen/SVD>
-
-using namespace Eigen;
+#include <fracdist/stats.hpp>
 
 namespace fracdist {
 
+static inline status approximate_critical(const double &pval, const std::array<double, p_length> &quant,
+        const unsigned int &q, const unsigned int &approx_points, double &crit);
+
 double critical(const double &test_level, const unsigned int &q, const double &b, const bool &constant) {
     return critical_advanced(test_level, q, b, constant, interpolation::JGMMON14, 9);
 }
 
+#if FRACDIST_RESPONSE_SURFACE
+double critical(const double &test_level, const unsigned int &q, const double &b, const bool &constant, const unsigned int &T) {
+    return critical_advanced(test_level, q, b, constant, interpolation::JGMMON14, 9, T);
+}
+#endif
+
 double critical_advanced(double test_level, const unsigned int &q, const double &b, const bool &constant,
         const interpolation &interp_mode, const unsigned int &approx_points) {
+    return critical_advanced(test_level, q, b, constant, interp_mode, approx_points, 0);
+}
 
-    // Take 1 minus the level to make it comparable to our stored p-values
-    test_level = 1 - test_level;
+double critical_advanced(double test_level, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) {
 
-    if (test_level < 0 || test_level > 1)
-        throw std::out_of_range(ostringstream() << "test level (" << test_level << ") invalid: must be between 0 and 1");
-    // The critical values for test levels of 0 or 1 are trivial: 0 or infinity.
-    if (test_level == 0) return 0.0;
-    if (test_level == 1) return INFINITY;
+    double crit;
+    if (detail::critical_trivial(test_level, crit)) return crit;
 
     // First get the set of quantiles to use (this also checks and q and b are valid):
-    auto quant = quantiles(q, b, constant, interp_mode);
-
-    // If we're asked for a smaller or larger p value than our data limits, return the limit value
-    if (test_level <= pvalues.front()) return quant.front();
-    if (test_level >= pvalues.back()) return quant.back();
-
-    // First find the location with a pvalue closest to the requested one
-    size_t min_at = find_closest(test_level, pvalues);
+    auto quant = quantiles(q, b, constant, interp_mode, T);
 
-    // Now figure out a set of `approx_points' consecutive points centered on the closest value
-    auto ap = find_bracket(min_at, p_length-1, approx_points);
-
-    if (ap.second - ap.first < 2)
-        throw std::runtime_error(ostringstream() << "approx_points (" << approx_points << ") too small: not enough data points for quadratic approximation");
+    FRACDIST_STATS_TIME(critical_regression);
+    if (approximate_critical(1 - test_level, quant, q, approx_points, crit) != status::ok)
+        detail::throw_approx_points(approx_points);
+    return crit;
+}
 
-    // Now we're going to estimate the regression:
-    // 
-    //     quantile_i = \beta_1 + \beta_2 chisqinv_i + \beta_3 chisqinv_i^2
-    //
-    // using the points surrounding the requested pvalue, where chisqinv_i is the inverse cdf at
-    // p=pvalue[i] of a chi-squared distribution with q^2 df
-    //
-    // The fitted value using the inverse chi squared at our desired pvalue then gives us a our
-    // estimated critical value.
+// Calls the critical value approximation; the default number of points gets the fixed-size
+// regression.
+static inline status approximate_critical(const double &pval, const std::array<double, p_length> &quant,
+        const unsigned int &q, const unsigned int &approx_points, double &crit) {
+    return approx_points == 9
+        ? detail::critical_from_quantiles<9>(pval, quant, q, approx_points, crit)
+        : detail::critical_from_quantiles<p_length>(pval, quant, q, approx_points, crit);
+}
 
-    MatrixX3d X(ap.second - ap.first + 1, 3);
-    VectorXd y(ap.second - ap.first + 1);
-    for (size_t i = ap.first; i <= ap.second; i++) {
-        double chisqinv = chisq_inv_p_i(i, q);
-        X(i-ap.first, 0) = 1.0;
-        X(i-ap.first, 1) = chisqinv;
-        X(i-ap.first, 2) = chisqinv*chisqinv;
+status try_critical(double &crit, const double &test_level, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) noexcept {
+    return critical_batch(&test_level, &crit, 1, q, b, constant, interp_mode, approx_points, T);
+}
 
-        y(i-ap.first) = quant[i];
+status critical_batch(const double *test_levels, double *crits, const size_t &n, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T, status *row_status) noexcept {
+    status params = check_parameters(q, b, constant, T);
+    std::array<double, p_length> quant;
+    if (params == status::ok) {
+        // Shouldn't throw: every exception quantiles() can throw is prevented by check_parameters
+        try { quant = quantiles(q, b, constant, interp_mode, T); }
+        catch (...) { params = status::internal_error; }
     }
+    return detail::critical_rows(params == status::ok ? &quant : nullptr, params, q, approx_points, test_levels, crits, n, row_status);
+}
 
-    double chisqinv_actual = quantile(boost::math::chi_squared_distribution<double>(q*q), test_level);
-    RowVector3d data;
-    data(0) = 1.0;
-    data(1) = chisqinv_actual;
-    data(2) = chisqinv_actual*chisqinv_actual;
-
-    // Get the fitted value from the regression using the inverse of our actual test level
-    JacobiSVD<MatrixXd> svd(X, ComputeThinU | ComputeThinV);
-    double fitted = data * svd.solve(y);
-
-    // Negative critical values are impossible; if we somehow got a negative prediction, truncate it
-    if (fitted < 0) fitted = 0;
-    return fitted;
+FRACDIST_KERNEL status detail::critical_rows(const std::array<double, p_length> *quant, const status &params, const unsigned int &q,
+        const unsigned int &approx_points, const double *test_levels, double *crits, const size_t &n, status *row_status) noexcept {
+    status first = status::ok;
+    for (size_t i = 0; i < n; i++) {
+        const double pval = 1 - test_levels[i];
+        double &crit = crits[i];
+        status s = status::ok;
+        // The same checks, in the same order, as critical_advanced()
+        if (!(pval >= 0 && pval <= 1)) s = status::invalid_test_level;
+        else if (pval == 0) crit = 0.0;
+        else if (pval == 1) crit = INFINITY;
+        else if (params != status::ok) s = params;
+        else {
+            FRACDIST_STATS_TIME(critical_regression);
+            try { s = approximate_critical(pval, *quant, q, approx_points, crit); }
+            catch (...) { s = status::internal_error; }
+        }
+        if (s != status::ok) {
+            crit = NAN;
+            if (first == status::ok) first = s;
+        }
+        if (row_status) row_status[i] = s;
+    }
+    return first;
 }
 
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include <fracdist/common.hpp>
+#include <fracdist/quadratic.hpp>
+#include <stdexcept>
 
 /** @file fracdist/critical.hpp
  * @brief Header file for fracdist's interface to finding a critical test statistic from a test
@@ -15,6 +17,19 @@ namespace fracdist {
  */
 double critical(const double &test_level, const unsigned int &q, const double &b, const bool &constant);
 
+#if FRACDIST_RESPONSE_SURFACE
+/** Like critical(), but calculates a finite-sample critical value for a sample of size `T` using the
+ * response surface data.  Exactly equivalent to calling:
+ *
+ *     critical_advanced(test_level, q, b, constant, interpolation::JGMMON14, 9, T)
+ *
+ * \throws std::out_of_range for an invalid `b` or `q` value, or for a test level outside \f$[0, 1]\f$.
+ * \throws std::runtime_error if `T > 0` and there is no response surface data for `q` (that is, for
+ * a `q` larger than `fracdist::q_length`, loaded from an external table)
+ */
+double critical(const double &test_level, const unsigned int &q, const double &b, const bool &constant, const unsigned int &T);
+#endif
+
 /** Like critical(), but also takes an interpolation mode and number of P-value approximation
  * points.  `approx_points` must be at least 3 (and depending on the test_stat and parameters, might
  * need to be at least 5).
@@ -34,4 +49,133 @@ double critical(const double &test_level, const unsigned int &q, const double &b
 double critical_advanced(double test_level, const unsigned int &q, const double &b, const bool &constant,
         const interpolation &interp_mode, const unsigned int &approx_points);
 
+/** Like critical_advanced(), but uses finite-sample quantiles for a sample of size `T` (see
+ * quantiles()).  A `T` of 0 gives the asymptotic critical value.
+ *
+ * \throws std::out_of_range for an invalid b or q value, or for a test level outside [0, 1].
+ * \throws std::runtime_error if approx_points is too small, or if `T > 0` and fracdist was built
+ * without response surface data.
+ */
+double critical_advanced(double test_level, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T);
+
+/** Non-throwing version of critical_advanced().  On success, stores the critical value in `crit` and
+ * returns status::ok.  Where critical_advanced() would throw, this instead sets `crit` to NaN and
+ * returns a status code describing the problem; no error message is constructed (see
+ * status_message()).  A NaN test level gives status::invalid_test_level.
+ */
+status try_critical(double &crit, const double &test_level, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) noexcept;
+
+/** Calculates critical values for `n` test levels sharing the same q, b, constant, interpolation, and
+ * sample size values, storing them in `crits[0]` through `crits[n-1]`, without throwing.  The
+ * parameters are checked (and the quantiles interpolated) just once.
+ *
+ * A test level that can't be evaluated (or all of them, if the parameters are invalid) gets a NaN
+ * critical value; if `row_status` is non-null, the status of each level is stored in
+ * `row_status[0]` through `row_status[n-1]`.  Returns status::ok if every critical value was
+ * calculated, otherwise the status of the first failure.
+ */
+status critical_batch(const double *test_levels, double *crits, const size_t &n, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T, status *row_status = nullptr) noexcept;
+
+/// @cond INTERNAL
+namespace detail {
+
+/* Checks the test level; throws if it is outside [0, 1], and returns true (and sets `crit`) for the
+ * trivial levels 0 and 1.  Returns false if the critical value needs to be calculated.
+ */
+inline bool critical_trivial(const double &test_level, double &crit) {
+    // Take 1 minus the level to make it comparable to our stored p-values
+    const double pval = 1 - test_level;
+    if (pval < 0 || pval > 1)
+        throw std::out_of_range(ostringstream() << "test level (" << pval << ") invalid: must be between 0 and 1");
+    // The critical values for test levels of 0 or 1 are trivial: 0 or infinity.
+    if (pval == 0) { crit = 0.0; return true; }
+    if (pval == 1) { crit = INFINITY; return true; }
+    return false;
+}
+
+/* The row loop of critical_batch(): calculates critical values for `n` test levels from the
+ * interpolated quantiles `quant`.  `params` is the result of checking the distribution parameters;
+ * if it isn't status::ok (in which case `quant` may be null) it becomes the status of every level
+ * that isn't invalid or trivial.
+ */
+status critical_rows(const std::array<double, p_length> *quant, const status &params, const unsigned int &q,
+        const unsigned int &approx_points, const double *test_levels, double *crits, const size_t &n, status *row_status) noexcept;
+
+/* Calculates the critical value at (upper tail) p-value `pval` (strictly between 0 and 1) from an
+ * already-interpolated set of quantiles using min(approx_points, MaxPoints) points, storing it in
+ * `crit`.  When the full MaxPoints points are available the regression size is a compile-time
+ * constant.  Returns status::invalid_approx_points (without setting `crit`) if there are fewer than 3
+ * points available.
+ */
+template <size_t MaxPoints>
+status critical_from_quantiles(const double &pval, const std::array<double, p_length> &quant,
+        const unsigned int &q, const unsigned int &approx_points, double &crit) {
+    // If we're asked for a smaller or larger p value than our data limits, return the limit value
+    if (pval <= pvalues.front()) { crit = quant.front(); return status::ok; }
+    if (pval >= pvalues.back()) { crit = quant.back(); return status::ok; }
+
+    // First find the location with a pvalue closest to the requested one
+    size_t min_at = find_closest(pval, pvalues);
+
+    // Now figure out a set of `approx_points' consecutive points centered on the closest value
+    auto ap = find_bracket(min_at, p_length-1, std::min<size_t>(approx_points, MaxPoints));
+
+    if (ap.second - ap.first < 2)
+        return status::invalid_approx_points;
+
+    // Now we're going to estimate the regression:
+    //
+    //     quantile_i = \beta_1 + \beta_2 chisqinv_i + \beta_3 chisqinv_i^2
+    //
+    // using the points surrounding the requested pvalue, where chisqinv_i is the inverse cdf at
+    // p=pvalue[i] of a chi-squared distribution with q^2 df
+    //
+    // The fitted value using the inverse chi squared at our desired pvalue then gives us a our
+    // estimated critical value.
+    const size_t n = ap.second - ap.first + 1;
+    std::array<double, MaxPoints> chisqinv;
+    for (size_t i = 0; i < n; i++)
+        chisqinv[i] = chisq_inv_p_i(ap.first + i, q);
+
+    const double chisqinv_actual = chisq_inv(q, pval);
+
+    // Get the fitted value from the regression using the inverse of our actual test level
+    double fitted = n == MaxPoints
+        ? quadratic_fit<MaxPoints>(chisqinv.data(), nullptr).fitted(chisqinv_actual, &quant[ap.first])
+        : quadratic_fit<MaxPoints>(chisqinv.data(), nullptr, n).fitted(chisqinv_actual, &quant[ap.first]);
+
+    // Negative critical values are impossible; if we somehow got a negative prediction, truncate it
+    crit = fitted < 0 ? 0.0 : fitted;
+    return status::ok;
+}
+
+}
+/// @endcond
+
+/** Like critical_advanced(), but with the interpolation mode and number of approximation points
+ * fixed at compile time, for example:
+ *
+ *     double c = fracdist::critical<fracdist::interpolation::JGMMON14, 9>(test_level, q, b, constant);
+ *
+ * is equivalent to `critical(test_level, q, b, constant)`, but the critical value approximation is
+ * inlined into the caller and specialized for the given number of points.  `T` optionally gives
+ * the sample size, as in the `T` version of critical_advanced().
+ *
+ * \throws std::out_of_range for an invalid b or q value, or for a test level outside [0, 1].
+ * \throws std::runtime_error if ApproxPoints is too small for the test level (see
+ * critical_advanced()), or if `T > 0` and fracdist was built without response surface data.
+ */
+template <interpolation Interp, unsigned int ApproxPoints>
+double critical(const double &test_level, const unsigned int &q, const double &b, const bool &constant, const unsigned int &T = 0) {
+    static_assert(ApproxPoints >= 3, "ApproxPoints must be at least 3");
+    double crit;
+    if (detail::critical_trivial(test_level, crit)) return crit;
+    if (detail::critical_from_quantiles<ApproxPoints>(1 - test_level, quantiles<Interp>(q, b, constant, T), q, ApproxPoints, crit) != status::ok)
+        detail::throw_approx_points(ApproxPoints);
+    return crit;
+}
+
 }
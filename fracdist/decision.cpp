@@ -0,0 +1,65 @@
+#include <fracdist/decision.hpp>
+#include <algorithm>
+#include <array>
+#include <functional>
+
+namespace fracdist {
+
+// See description in fracdist/decision.hpp
+decision_rule::decision_rule(const distribution &dist, const std::vector<double> &levels)
+    : dist_(dist), levels_(levels)
+{
+    if (levels_.empty() || levels_.size() >= decision_invalid)
+        throw std::invalid_argument(ostringstream() << "invalid number of test levels (" << levels_.size() << "): must be between 1 and "
+                << (decision_invalid - 1));
+    std::sort(levels_.begin(), levels_.end(), std::greater<double>());
+
+    criticals_.reserve(levels_.size());
+    for (const double &level : levels_) {
+        const double crit = dist_.critical(level);
+        criticals_.push_back(criticals_.empty() ? crit : std::max(crit, criticals_.back()));
+    }
+}
+
+// See description in fracdist/decision.hpp
+uint8_t decision_rule::code(const double &test_stat) const {
+    uint8_t c;
+    codes(&test_stat, &c, 1);
+    return c;
+}
+
+// Counts the critical values below each statistic.  The codes are built in a local block: since a
+// uint8_t may alias anything, the compiler would otherwise have to assume that every store could
+// change the statistics or critical values, and couldn't vectorize the loops.
+FRACDIST_KERNEL static void count_rejections(const double *test_stats, uint8_t *codes, const size_t &n,
+        const double *crits, const size_t &levels) {
+    std::array<uint8_t, 256> block;
+    for (size_t start = 0; start < n; start += block.size()) {
+        const size_t m = std::min(block.size(), n - start);
+        const double *t = test_stats + start;
+        std::fill(block.begin(), block.begin() + m, 0);
+        for (size_t k = 0; k < levels; k++) {
+            const double c = crits[k];
+            for (size_t i = 0; i < m; i++)
+                block[i] += t[i] > c;
+        }
+        for (size_t i = 0; i < m; i++)
+            if (!(t[i] >= 0)) block[i] = decision_invalid;
+        std::copy(block.begin(), block.begin() + m, codes + start);
+    }
+}
+
+// See description in fracdist/decision.hpp
+status decision_rule::codes(const double *test_stats, uint8_t *codes, const size_t &n, status *row_status) const noexcept {
+    count_rejections(test_stats, codes, n, criticals_.data(), criticals_.size());
+
+    status first = status::ok;
+    for (size_t i = 0; i < n; i++) {
+        const status s = codes[i] == decision_invalid ? status::invalid_test_stat : status::ok;
+        if (s != status::ok && first == status::ok) first = s;
+        if (row_status) row_status[i] = s;
+    }
+    return first;
+}
+
+}
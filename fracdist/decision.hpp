@@ -0,0 +1,66 @@
+#pragma once
+#include <fracdist/distribution.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** @file fracdist/decision.hpp
+ * @brief Fast accept/reject decisions at a fixed set of test levels.
+ */
+
+namespace fracdist {
+
+/** The code decision_rule gives to a negative or NaN test statistic. */
+constexpr uint8_t decision_invalid = 255;
+
+/** Classifies test statistics by the test levels at which they reject, using critical values
+ * calculated once (by critical_advanced()) when the rule is constructed.  Classifying a statistic
+ * then takes one comparison per level, with no p-value calculation, which is all that is needed
+ * when only the decisions at a few conventional levels (such as 10%, 5%, and 1%) matter.
+ *
+ * The levels are stored in decreasing order, so that their critical values increase.  A statistic
+ * rejects at a level when it exceeds the level's critical value; its code is the number of levels
+ * at which it rejects, so code `k` means that it rejects at `levels()[0]` through `levels()[k-1]`
+ * (the `k` largest levels) and at none of the others.  For example, with levels 0.1, 0.05, and
+ * 0.01, code 2 means that the statistic rejects at 10% and 5% but not at 1%.
+ *
+ * critical_advanced() can give slightly out of order critical values for levels very close
+ * together (where its regression window shifts), so each critical value is raised, if needed, to
+ * the one before it; the codes are then always nested as described.
+ */
+class decision_rule {
+    public:
+        /** Calculates the critical values of `dist` at each of `levels` (in any order; there may be
+         * at most 254 of them).
+         *
+         * \throws std::invalid_argument if `levels` is empty or has more than 254 values
+         * \throws std::out_of_range for a test level outside [0, 1]
+         * \throws std::runtime_error if the distribution's approx_points is too small for a level
+         */
+        decision_rule(const distribution &dist, const std::vector<double> &levels = {0.1, 0.05, 0.01});
+
+        /** Returns the code of a single test statistic: the number of levels at which it rejects,
+         * or decision_invalid if it is negative or NaN.
+         */
+        uint8_t code(const double &test_stat) const;
+
+        /** Stores the codes of `n` test statistics in `codes` without throwing.  If `row_status` is
+         * not null, the status of each statistic is stored in it (status::invalid_test_stat for a
+         * negative or NaN statistic, otherwise status::ok).  Returns status::ok if every statistic
+         * was valid, otherwise status::invalid_test_stat.
+         */
+        status codes(const double *test_stats, uint8_t *codes, const size_t &n, status *row_status = nullptr) const noexcept;
+
+        /// The test levels, in decreasing order
+        const std::vector<double>& levels() const { return levels_; }
+        /// The critical values of the levels, in increasing order
+        const std::vector<double>& criticals() const { return criticals_; }
+        /// The distribution the critical values were calculated for
+        const distribution& dist() const { return dist_; }
+
+    private:
+        distribution dist_;
+        std::vector<double> levels_, criticals_;
+};
+
+}
@@ -0,0 +1,81 @@
+#include <fracdist/distribution.hpp>
+#include <fracdist/pvalue.hpp>
+#include <fracdist/critical.hpp>
+#include <fracdist/monotone.hpp>
+
+namespace fracdist {
+
+distribution::distribution(const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp, const unsigned int &approx_points, const unsigned int &T, const pvalue_method &method)
+    : q_(q), b_(b), constant_(constant), interp_(interp), approx_points_(approx_points), T_(T),
+    quantiles_(fracdist::quantiles(q, b, constant, interp, T)), method_(method)
+{
+    if (method == pvalue_method::monotone_map) {
+        std::array<double, p_length> chisq;
+        for (size_t i = 0; i < p_length; i++)
+            chisq[i] = chisq_inv_p_i(i, q);
+        map_.reset(new monotone_cubic<p_length>(quantiles_.data(), chisq.data()));
+    }
+}
+
+double distribution::pvalue(const double &test_stat) const {
+    double pval;
+    switch (pvalues(&test_stat, &pval, 1)) {
+        case status::ok:
+            return pval;
+        case status::invalid_test_stat:
+            throw std::out_of_range(ostringstream() << "test stat (" << test_stat << ") invalid: cannot be negative");
+        case status::invalid_approx_points:
+            detail::throw_approx_points(approx_points_);
+        default:
+            throw std::runtime_error("Internal error: p-value calculation failed");
+    }
+}
+
+double distribution::critical(const double &test_level) const {
+    double crit;
+    switch (criticals(&test_level, &crit, 1)) {
+        case status::ok:
+            return crit;
+        case status::invalid_test_level:
+            throw std::out_of_range(ostringstream() << "test level (" << test_level << ") invalid: must be between 0 and 1");
+        case status::invalid_approx_points:
+            detail::throw_approx_points(approx_points_);
+        default:
+            throw std::runtime_error("Internal error: critical value calculation failed");
+    }
+}
+
+status distribution::pvalues(const double *test_stats, double *pvals, const size_t &n, status *row_status) const noexcept {
+    if (!map_)
+        return detail::pvalue_rows(&quantiles_, status::ok, q_, approx_points_, test_stats, pvals, n, row_status);
+
+    status first = status::ok;
+    for (size_t i = 0; i < n; i++) {
+        const double &t = test_stats[i];
+        double &pval = pvals[i];
+        status s = status::ok;
+        if (!(t >= 0)) s = status::invalid_test_stat;
+        else if (t < quantiles_.front() || t > quantiles_.back()) {
+            // Beyond the ends of the quantiles, extrapolate exactly as the regression does
+            s = detail::pvalue_rows(&quantiles_, status::ok, q_, approx_points_, &t, &pval, 1, nullptr);
+        }
+        else {
+            const double chisq = (*map_)(t);
+            try { pval = chisq <= 0 ? 1.0 : chisq_cdf_upper(q_, chisq); }
+            catch (...) { s = status::internal_error; }
+        }
+        if (s != status::ok) {
+            pval = NAN;
+            if (first == status::ok) first = s;
+        }
+        if (row_status) row_status[i] = s;
+    }
+    return first;
+}
+
+status distribution::criticals(const double *test_levels, double *crits, const size_t &n, status *row_status) const noexcept {
+    return detail::critical_rows(&quantiles_, status::ok, q_, approx_points_, test_levels, crits, n, row_status);
+}
+
+}
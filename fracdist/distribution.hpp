@@ -0,0 +1,108 @@
+#pragma once
+#include <fracdist/common.hpp>
+#include <cstddef>
+#include <memory>
+
+/** @file fracdist/distribution.hpp
+ * @brief A fixed set of distribution parameters with precomputed quantiles.
+ */
+
+namespace fracdist {
+
+template <size_t N> class monotone_cubic;
+
+/** The methods a distribution can use to calculate p-values. */
+enum class pvalue_method {
+    /** The local quadratic regression of pvalue_advanced(), giving exactly the same p-values. */
+    regression,
+    /** A monotone piecewise cubic map (see monotone_cubic) from test statistics to chi-squared
+     * values, through the points (quantile, inverse chi-squared cdf) for every tabulated p value,
+     * built once when the distribution is constructed.  Each p-value then costs just a binary
+     * search, a cubic evaluation, and a chi-squared tail probability, instead of a regression.
+     * Statistics beyond the smallest or largest quantile still use the regression (with
+     * `approx_points` points) to extrapolate.  The p-values differ slightly from those of the
+     * regression; the `fracdist_regress` program reports the differences over its corpus.
+     */
+    monotone_map
+};
+
+/** A single fractional distribution (that is, a fixed \f$q\f$, \f$b\f$, constant, interpolation
+ * mode, number of approximation points, and sample size) with its interpolated quantiles calculated
+ * once at construction.
+ *
+ * Unlike the free pvalue() and critical() functions, which share a (per-thread) cache of the most
+ * recent quantiles, a distribution object holds its own quantiles, so many distributions can be kept
+ * and used alternately without repeating the interpolation.  The const methods may be called from
+ * multiple threads at once.
+ */
+class distribution {
+    public:
+        /** Constructs the distribution, calculating its quantiles.  The parameters other than
+         * `method` have the same meaning as in pvalue_advanced(); `method` selects how p-values are
+         * calculated.
+         *
+         * \throws std::out_of_range for an invalid b or q value
+         * \throws std::runtime_error if `T > 0` and fracdist was built without response surface data,
+         * or if `method` is pvalue_method::monotone_map and the quantiles are not strictly
+         * increasing.
+         */
+        distribution(const unsigned int &q, const double &b, const bool &constant,
+                const interpolation &interp = interpolation::JGMMON14, const unsigned int &approx_points = 9,
+                const unsigned int &T = 0, const pvalue_method &method = pvalue_method::regression);
+
+        /** Returns the p-value of a test statistic.  With the default pvalue_method::regression this
+         * is equivalent to calling pvalue_advanced() with this distribution's parameters.
+         *
+         * \throws std::out_of_range for a negative test statistic
+         * \throws std::runtime_error if approx_points is too small for the statistic
+         */
+        double pvalue(const double &test_stat) const;
+
+        /** Returns the critical value for a test level; equivalent to calling critical_advanced()
+         * with this distribution's parameters.
+         *
+         * \throws std::out_of_range for a test level outside [0, 1]
+         * \throws std::runtime_error if approx_points is too small for the level
+         */
+        double critical(const double &test_level) const;
+
+        /** Calculates the p-values of `n` test statistics without throwing, as pvalue_batch() does.
+         */
+        status pvalues(const double *test_stats, double *pvals, const size_t &n, status *row_status = nullptr) const noexcept;
+
+        /** Calculates the critical values of `n` test levels without throwing, as critical_batch()
+         * does.
+         */
+        status criticals(const double *test_levels, double *crits, const size_t &n, status *row_status = nullptr) const noexcept;
+
+        /// The interpolated quantiles (at fracdist::pvalues)
+        const std::array<double, p_length>& quantiles() const { return quantiles_; }
+
+        /// The q value
+        unsigned int q() const { return q_; }
+        /// The b value
+        double b() const { return b_; }
+        /// Whether the model has a constant
+        bool constant() const { return constant_; }
+        /// The interpolation mode
+        interpolation interp() const { return interp_; }
+        /// The number of points used to approximate p-values and critical values
+        unsigned int approx_points() const { return approx_points_; }
+        /// The sample size (0 for asymptotic)
+        unsigned int T() const { return T_; }
+        /// The p-value calculation method
+        pvalue_method method() const { return method_; }
+
+    private:
+        unsigned int q_;
+        double b_;
+        bool constant_;
+        interpolation interp_;
+        unsigned int approx_points_, T_;
+        std::array<double, p_length> quantiles_;
+        pvalue_method method_;
+        // The statistic to chi-squared map, for pvalue_method::monotone_map (shared by copies)
+        std::shared_ptr<const monotone_cubic<p_length>> map_;
+};
+
+}
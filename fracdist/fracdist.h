@@ -0,0 +1,163 @@
+#ifndef FRACDIST_H
+#define FRACDIST_H
+
+/** @file fracdist/fracdist.h
+ * @brief C interface to fracdist, for use from C and through foreign function interfaces.
+ *
+ * Every function operates on caller-provided contiguous arrays, so a single call can calculate any
+ * number of p-values or critical values.  No function throws or aborts: errors are reported through
+ * the `fracdist_status` codes (as `int` return values), with NaN stored for any value that couldn't
+ * be calculated.
+ *
+ * The functions have the same meanings as the C++ functions they wrap: fracdist_pvalues() and
+ * fracdist_criticals() correspond to fracdist::pvalue_batch() and fracdist::critical_batch(), and the
+ * `fracdist_distribution`, `fracdist_sampler`, and `fracdist_decision_rule` functions to the
+ * fracdist::distribution, fracdist::sampler, and fracdist::decision_rule classes.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Status codes returned by the fracdist C functions.  The values (other than
+ * FRACDIST_INVALID_ARGUMENT) are the same as those of the C++ fracdist::status enum, and will not
+ * change in future versions.
+ */
+enum fracdist_status {
+    FRACDIST_OK = 0,                      /**< Success */
+    FRACDIST_INVALID_Q = 1,               /**< Invalid q value, or no quantile table for q */
+    FRACDIST_INVALID_B = 2,               /**< b outside the supported range */
+    FRACDIST_INVALID_TEST_STAT = 3,       /**< Negative (or NaN) test statistic */
+    FRACDIST_INVALID_TEST_LEVEL = 4,      /**< Test level outside [0, 1] (or NaN) */
+    FRACDIST_INVALID_APPROX_POINTS = 5,   /**< approx_points too small */
+    FRACDIST_NO_RESPONSE_SURFACE = 6,     /**< T > 0 without response surface data */
+    FRACDIST_TABLE_ERROR = 7,             /**< External quantile table could not be loaded */
+    FRACDIST_INTERNAL_ERROR = 8,          /**< Any other failure */
+    FRACDIST_NO_SOLUTION = 9,             /**< A root finding function found no solution */
+    FRACDIST_INVALID_ARGUMENT = 100       /**< A null pointer or invalid interpolation value */
+};
+
+/** Interpolation modes; see fracdist::interpolation. */
+enum fracdist_interpolation {
+    FRACDIST_JGMMON14 = 0,
+    FRACDIST_EXACT_OR_JGMMON14 = 1,
+    FRACDIST_LINEAR = 2,
+    FRACDIST_SPLINE = 3,
+    FRACDIST_CHEBYSHEV = 4
+};
+
+/** Returns a static description of a fracdist_status value. */
+const char* fracdist_status_message(int status);
+
+/** Returns the fracdist version string, such as "1.2.3". */
+const char* fracdist_version(void);
+
+/** Calculates p-values for `n` test statistics sharing the same parameters (see
+ * fracdist::pvalue_advanced()).  `interp` is a fracdist_interpolation value, and `T` is the sample
+ * size (0 for asymptotic p-values).  If `row_status` is not NULL, the status of each statistic is
+ * stored in it.  Returns FRACDIST_OK if every p-value was calculated, otherwise the status of the
+ * first failure.
+ */
+int fracdist_pvalues(const double *test_stats, double *pvalues, size_t n,
+        unsigned int q, double b, int constant, int interp, unsigned int approx_points, unsigned int T,
+        int *row_status);
+
+/** Calculates critical values for `n` test levels sharing the same parameters (see
+ * fracdist::critical_advanced()); otherwise as fracdist_pvalues().
+ */
+int fracdist_criticals(const double *test_levels, double *criticals, size_t n,
+        unsigned int q, double b, int constant, int interp, unsigned int approx_points, unsigned int T,
+        int *row_status);
+
+/** Calculates the p-values of every combination of `nb` b values and `ns` test statistics, storing
+ * the p-value of `test_stats[j]` at `b_grid[i]` in `pvalues[i*ns + j]` (see fracdist::pvalue_surface()).
+ * `threads` is the number of threads to use (0 for one per hardware thread).  If `cell_status` is
+ * not NULL, the status of each p-value is stored in it, in the same layout; otherwise as
+ * fracdist_pvalues().
+ */
+int fracdist_pvalue_surface(const double *b_grid, size_t nb, const double *test_stats, size_t ns, double *pvalues,
+        unsigned int q, int constant, int interp, unsigned int approx_points, unsigned int T, unsigned int threads,
+        int *cell_status);
+
+/** Calculates the p-values of a panel of `n` series, series `i` having q value `q[i]`, b value `b[i]`,
+ * constant `constant[i]` (non-zero for a constant), and test statistic `test_stats[i]`, storing them
+ * in `pvalues` (see fracdist::pvalue_panel()).  If `bh_adjusted` is not NULL, the Benjamini-Hochberg
+ * adjusted p-values are stored in it; if `combined` is not NULL, it receives (in order) the number
+ * of valid series, Fisher's statistic, Fisher's p-value, and Simes' p-value.  `threads` is as for
+ * fracdist_pvalue_surface(); statuses are as for fracdist_pvalues().
+ */
+int fracdist_pvalue_panel(const unsigned int *q, const double *b, const int *constant, const double *test_stats, size_t n,
+        double *pvalues, double *bh_adjusted, double combined[4], int interp, unsigned int approx_points, unsigned int T,
+        unsigned int threads, int *row_status);
+
+/** Opaque handle to a distribution with precomputed quantiles (see fracdist::distribution). */
+typedef struct fracdist_distribution fracdist_distribution;
+
+/** Creates a distribution handle, which must be freed with fracdist_distribution_free().  Returns
+ * NULL on failure, in which case the reason is stored in `status` (if not NULL).
+ */
+fracdist_distribution* fracdist_distribution_new(unsigned int q, double b, int constant, int interp,
+        unsigned int approx_points, unsigned int T, int *status);
+
+/** Frees a distribution handle.  Does nothing if `d` is NULL. */
+void fracdist_distribution_free(fracdist_distribution *d);
+
+/** Calculates p-values for `n` test statistics using a distribution handle; otherwise as
+ * fracdist_pvalues().
+ */
+int fracdist_distribution_pvalues(const fracdist_distribution *d, const double *test_stats, double *pvalues, size_t n,
+        int *row_status);
+
+/** Calculates critical values for `n` test levels using a distribution handle; otherwise as
+ * fracdist_criticals().
+ */
+int fracdist_distribution_criticals(const fracdist_distribution *d, const double *test_levels, double *criticals, size_t n,
+        int *row_status);
+
+/** Opaque handle to a random variate generator (see fracdist::sampler). */
+typedef struct fracdist_sampler fracdist_sampler;
+
+/** Creates a sampler drawing from the distribution `d`, with its generator seeded with `seed`; it
+ * must be freed with fracdist_sampler_free() (but does not need `d` to remain valid).  Returns NULL
+ * on failure, in which case the reason is stored in `status` (if not NULL).
+ */
+fracdist_sampler* fracdist_sampler_new(const fracdist_distribution *d, unsigned long long seed, int *status);
+
+/** Frees a sampler handle.  Does nothing if `s` is NULL. */
+void fracdist_sampler_free(fracdist_sampler *s);
+
+/** Stores `n` random variates in `out[0]` through `out[n-1]`.  Returns FRACDIST_OK, or
+ * FRACDIST_INVALID_ARGUMENT if `s` (or, for `n > 0`, `out`) is NULL.
+ */
+int fracdist_sampler_fill(fracdist_sampler *s, double *out, size_t n);
+
+/** Opaque handle to a set of critical values for fast rejection decisions (see
+ * fracdist::decision_rule).
+ */
+typedef struct fracdist_decision_rule fracdist_decision_rule;
+
+/** Creates a decision rule for the distribution `d` at the `n_levels` test levels `levels[0]` through
+ * `levels[n_levels-1]` (in any order; at most 254 of them); it must be freed with
+ * fracdist_decision_rule_free() (but does not need `d` to remain valid).  Returns NULL on failure,
+ * in which case the reason is stored in `status` (if not NULL).
+ */
+fracdist_decision_rule* fracdist_decision_rule_new(const fracdist_distribution *d, const double *levels, size_t n_levels,
+        int *status);
+
+/** Frees a decision rule handle.  Does nothing if `r` is NULL. */
+void fracdist_decision_rule_free(fracdist_decision_rule *r);
+
+/** Stores the codes of `n` test statistics in `codes`: the number of levels at which each statistic
+ * rejects (code `k` meaning that it rejects at the `k` largest levels), or 255 for a negative or
+ * NaN statistic.  Statuses are as for fracdist_pvalues().
+ */
+int fracdist_decision_rule_codes(const fracdist_decision_rule *r, const double *test_stats, unsigned char *codes, size_t n,
+        int *row_status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,239 @@
+#include <fracdist/fracdist.h>
+#include <fracdist/distribution.hpp>
+#include <fracdist/sampler.hpp>
+#include <fracdist/decision.hpp>
+#include <fracdist/panel.hpp>
+#include <fracdist/pvalue.hpp>
+#include <fracdist/critical.hpp>
+#include <fracdist/version.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace fracdist;
+
+static_assert((int) status::ok == FRACDIST_OK && (int) status::invalid_q == FRACDIST_INVALID_Q &&
+        (int) status::invalid_b == FRACDIST_INVALID_B && (int) status::invalid_test_stat == FRACDIST_INVALID_TEST_STAT &&
+        (int) status::invalid_test_level == FRACDIST_INVALID_TEST_LEVEL &&
+        (int) status::invalid_approx_points == FRACDIST_INVALID_APPROX_POINTS &&
+        (int) status::no_response_surface == FRACDIST_NO_RESPONSE_SURFACE &&
+        (int) status::table_error == FRACDIST_TABLE_ERROR && (int) status::internal_error == FRACDIST_INTERNAL_ERROR &&
+        (int) status::no_solution == FRACDIST_NO_SOLUTION,
+        "fracdist_status values must match fracdist::status");
+
+struct fracdist_distribution {
+    distribution dist;
+};
+
+struct fracdist_sampler {
+    sampler gen;
+};
+
+struct fracdist_decision_rule {
+    decision_rule rule;
+};
+
+// Converts a C interpolation value; returns false if invalid
+static bool c_interp(const int &interp, interpolation &result) {
+    switch (interp) {
+        case FRACDIST_JGMMON14: result = interpolation::JGMMON14; return true;
+        case FRACDIST_EXACT_OR_JGMMON14: result = interpolation::exact_or_JGMMON14; return true;
+        case FRACDIST_LINEAR: result = interpolation::linear; return true;
+        case FRACDIST_SPLINE: result = interpolation::spline; return true;
+        case FRACDIST_CHEBYSHEV: result = interpolation::chebyshev; return true;
+    }
+    return false;
+}
+
+// Calls `f(first, count, status*)` over [0, n) in blocks, converting the per-row statuses into the
+// C `row_status` array (if not null).  Returns the first non-ok status.
+template <typename F>
+static int blocked(const size_t &n, int *row_status, const F &f) {
+    if (!row_status) return (int) f(0, n, nullptr);
+
+    status first = status::ok;
+    status block[256];
+    for (size_t i = 0; i < n; i += 256) {
+        const size_t count = std::min<size_t>(256, n - i);
+        status s = f(i, count, block);
+        if (first == status::ok) first = s;
+        for (size_t j = 0; j < count; j++) row_status[i+j] = (int) block[j];
+    }
+    return (int) first;
+}
+
+extern "C" {
+
+const char* fracdist_status_message(int s) {
+    if (s == FRACDIST_INVALID_ARGUMENT) return "invalid argument: null pointer or invalid interpolation";
+    return status_message((status) s);
+}
+
+const char* fracdist_version(void) {
+    return version_string;
+}
+
+int fracdist_pvalues(const double *test_stats, double *pvalues, size_t n,
+        unsigned int q, double b, int constant, int interp, unsigned int approx_points, unsigned int T,
+        int *row_status) {
+    interpolation in;
+    if ((n > 0 && (!test_stats || !pvalues)) || !c_interp(interp, in)) return FRACDIST_INVALID_ARGUMENT;
+    return blocked(n, row_status, [&](size_t first, size_t count, status *rs) {
+        return pvalue_batch(test_stats + first, pvalues + first, count, q, b, constant != 0, in, approx_points, T, rs);
+    });
+}
+
+int fracdist_criticals(const double *test_levels, double *criticals, size_t n,
+        unsigned int q, double b, int constant, int interp, unsigned int approx_points, unsigned int T,
+        int *row_status) {
+    interpolation in;
+    if ((n > 0 && (!test_levels || !criticals)) || !c_interp(interp, in)) return FRACDIST_INVALID_ARGUMENT;
+    return blocked(n, row_status, [&](size_t first, size_t count, status *rs) {
+        return critical_batch(test_levels + first, criticals + first, count, q, b, constant != 0, in, approx_points, T, rs);
+    });
+}
+
+int fracdist_pvalue_surface(const double *b_grid, size_t nb, const double *test_stats, size_t ns, double *pvalues,
+        unsigned int q, int constant, int interp, unsigned int approx_points, unsigned int T, unsigned int threads,
+        int *cell_status) {
+    interpolation in;
+    if ((nb > 0 && ns > 0 && (!b_grid || !test_stats || !pvalues)) || !c_interp(interp, in)) return FRACDIST_INVALID_ARGUMENT;
+    if (!cell_status)
+        return (int) pvalue_surface(b_grid, nb, test_stats, ns, pvalues, q, constant != 0, in, approx_points, T, threads);
+
+    std::vector<status> cells;
+    try { cells.resize(nb * ns); }
+    catch (...) { return FRACDIST_INTERNAL_ERROR; }
+    const status first = pvalue_surface(b_grid, nb, test_stats, ns, pvalues, q, constant != 0, in, approx_points, T, threads, cells.data());
+    for (size_t i = 0; i < cells.size(); i++) cell_status[i] = (int) cells[i];
+    return (int) first;
+}
+
+int fracdist_pvalue_panel(const unsigned int *q, const double *b, const int *constant, const double *test_stats, size_t n,
+        double *pvalues, double *bh_adjusted, double combined[4], int interp, unsigned int approx_points, unsigned int T,
+        unsigned int threads, int *row_status) {
+    interpolation in;
+    if ((n > 0 && (!q || !b || !constant || !test_stats || !pvalues)) || !c_interp(interp, in)) return FRACDIST_INVALID_ARGUMENT;
+
+    std::vector<panel_series> series;
+    try { series.resize(n); }
+    catch (...) { return FRACDIST_INTERNAL_ERROR; }
+    for (size_t i = 0; i < n; i++) series[i] = panel_series{q[i], b[i], constant[i] != 0, test_stats[i]};
+
+    panel_result result;
+    const status first = pvalue_panel(series.data(), n, result, in, approx_points, T, threads);
+    if (result.pvalues.size() != n || result.bh_adjusted.size() != n) {
+        // Not even the results could be allocated
+        std::fill(pvalues, pvalues + n, NAN);
+        if (bh_adjusted) std::fill(bh_adjusted, bh_adjusted + n, NAN);
+        if (row_status) std::fill(row_status, row_status + n, FRACDIST_INTERNAL_ERROR);
+        if (combined) std::fill(combined, combined + 4, NAN);
+        return FRACDIST_INTERNAL_ERROR;
+    }
+    std::copy(result.pvalues.begin(), result.pvalues.end(), pvalues);
+    if (bh_adjusted) std::copy(result.bh_adjusted.begin(), result.bh_adjusted.end(), bh_adjusted);
+    if (row_status)
+        for (size_t i = 0; i < n; i++) row_status[i] = (int) result.row_status[i];
+    if (combined) {
+        combined[0] = (double) result.valid;
+        combined[1] = result.fisher_stat;
+        combined[2] = result.fisher_pvalue;
+        combined[3] = result.simes_pvalue;
+    }
+    return (int) first;
+}
+
+fracdist_distribution* fracdist_distribution_new(unsigned int q, double b, int constant, int interp,
+        unsigned int approx_points, unsigned int T, int *status_out) {
+    interpolation in;
+    int s = c_interp(interp, in) ? (int) check_parameters(q, b, constant != 0, T) : FRACDIST_INVALID_ARGUMENT;
+    fracdist_distribution *d = nullptr;
+    if (s == FRACDIST_OK) {
+        try {
+            d = new fracdist_distribution{distribution(q, b, constant != 0, in, approx_points, T)};
+        }
+        catch (...) {
+            s = FRACDIST_INTERNAL_ERROR;
+        }
+    }
+    if (status_out) *status_out = s;
+    return d;
+}
+
+void fracdist_distribution_free(fracdist_distribution *d) {
+    delete d;
+}
+
+int fracdist_distribution_pvalues(const fracdist_distribution *d, const double *test_stats, double *pvalues, size_t n,
+        int *row_status) {
+    if (!d || (n > 0 && (!test_stats || !pvalues))) return FRACDIST_INVALID_ARGUMENT;
+    return blocked(n, row_status, [&](size_t first, size_t count, status *rs) {
+        return d->dist.pvalues(test_stats + first, pvalues + first, count, rs);
+    });
+}
+
+int fracdist_distribution_criticals(const fracdist_distribution *d, const double *test_levels, double *criticals, size_t n,
+        int *row_status) {
+    if (!d || (n > 0 && (!test_levels || !criticals))) return FRACDIST_INVALID_ARGUMENT;
+    return blocked(n, row_status, [&](size_t first, size_t count, status *rs) {
+        return d->dist.criticals(test_levels + first, criticals + first, count, rs);
+    });
+}
+
+fracdist_sampler* fracdist_sampler_new(const fracdist_distribution *d, unsigned long long seed, int *status_out) {
+    int s = d ? FRACDIST_OK : FRACDIST_INVALID_ARGUMENT;
+    fracdist_sampler *result = nullptr;
+    if (s == FRACDIST_OK) {
+        try {
+            result = new fracdist_sampler{sampler(d->dist, seed)};
+        }
+        catch (...) {
+            s = FRACDIST_INTERNAL_ERROR;
+        }
+    }
+    if (status_out) *status_out = s;
+    return result;
+}
+
+void fracdist_sampler_free(fracdist_sampler *s) {
+    delete s;
+}
+
+int fracdist_sampler_fill(fracdist_sampler *s, double *out, size_t n) {
+    if (!s || (n > 0 && !out)) return FRACDIST_INVALID_ARGUMENT;
+    s->gen.fill(out, n);
+    return FRACDIST_OK;
+}
+
+fracdist_decision_rule* fracdist_decision_rule_new(const fracdist_distribution *d, const double *levels, size_t n_levels,
+        int *status_out) {
+    int s = d && levels && n_levels > 0 && n_levels < decision_invalid ? FRACDIST_OK : FRACDIST_INVALID_ARGUMENT;
+    fracdist_decision_rule *result = nullptr;
+    if (s == FRACDIST_OK) {
+        try {
+            // Check the levels without throwing first, for the status of any failure
+            std::vector<double> crits(n_levels);
+            s = (int) d->dist.criticals(levels, crits.data(), n_levels);
+            if (s == FRACDIST_OK)
+                result = new fracdist_decision_rule{decision_rule(d->dist, std::vector<double>(levels, levels + n_levels))};
+        }
+        catch (...) {
+            s = FRACDIST_INTERNAL_ERROR;
+        }
+    }
+    if (status_out) *status_out = s;
+    return result;
+}
+
+void fracdist_decision_rule_free(fracdist_decision_rule *r) {
+    delete r;
+}
+
+int fracdist_decision_rule_codes(const fracdist_decision_rule *r, const double *test_stats, unsigned char *codes, size_t n,
+        int *row_status) {
+    if (!r || (n > 0 && (!test_stats || !codes))) return FRACDIST_INVALID_ARGUMENT;
+    return blocked(n, row_status, [&](size_t first, size_t count, status *rs) {
+        return r->rule.codes(test_stats + first, codes + first, count, rs);
+    });
+}
+
+}
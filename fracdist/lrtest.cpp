@@ -0,0 +1,394 @@
+#include <fracdist/lrtest.hpp>
+#include <fracdist/pvalue.hpp>
+#include <fracdist/parallel.hpp>
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/SVD>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+using namespace Eigen;
+
+namespace fracdist {
+
+// Returns the first n coefficients \pi_j(e) of the fractional difference filter (1-L)^e, which
+// satisfy \pi_0 = 1, \pi_j = \pi_{j-1} (j - 1 - e) / j.
+static VectorXd fracdiff_coefs(const double &e, const size_t &n) {
+    VectorXd pi(n);
+    pi(0) = 1.0;
+    for (size_t j = 1; j < n; j++)
+        pi(j) = pi(j-1) * ((double) j - 1.0 - e) / (double) j;
+    return pi;
+}
+
+// Applies the fractional difference filter with coefficients `pi`, truncated at the start of the
+// sample, to each column of `x`: y_t = \sum_{j=0}^{t} \pi_j x_{t-j}.
+static MatrixXd fracdiff(const VectorXd &pi, const MatrixXd &x) {
+    const Index T = x.rows();
+    MatrixXd y = MatrixXd::Zero(T, x.cols());
+    for (Index k = 0; k < x.cols(); k++) {
+        for (Index j = 0; j < T; j++) {
+            if (pi(j) == 0.0) continue;
+            y.col(k).tail(T-j).noalias() += pi(j) * x.col(k).head(T-j);
+        }
+    }
+    return y;
+}
+
+// Calculates the squared canonical correlations \lambda_1 \geq ... \geq \lambda_p of the reduced
+// rank regression with moment matrices S00, S01, and S11, which solve:
+//     |\lambda S11 - S10 S00^{-1} S01| = 0
+// along with log|S00|.  If `beta` is given, it is set to the (m x m) matrix of eigenvectors,
+// normalized so that beta' S11 beta = I, in the same order as `lambda`.  Returns false (without
+// setting anything) if S00 or S11 is singular.
+static bool reduced_rank(const MatrixXd &S00, const MatrixXd &S01, const MatrixXd &S11, VectorXd &lambda, double &logdet,
+        MatrixXd *beta = nullptr) {
+    LLT<MatrixXd> L0(S00), L1(S11);
+    if (L0.info() != Success || L1.info() != Success) return false;
+
+    // A = L0^{-1} S01 L1^{-T}; the \lambda_i are its squared singular values, and the eigenvectors are
+    // L1^{-T} times its right singular vectors.
+    const MatrixXd B = L1.matrixL().solve(S01.transpose());
+    const MatrixXd A = L0.matrixL().solve(B.transpose());
+    JacobiSVD<MatrixXd> svd(A, beta ? ComputeFullV : 0);
+    const auto &sv = svd.singularValues();
+
+    const Index p = S00.rows();
+    lambda.resize(p);
+    for (Index i = 0; i < p; i++)
+        lambda(i) = std::min(sv(i) * sv(i), 1.0 - 1e-15);
+
+    logdet = 0;
+    for (Index i = 0; i < p; i++)
+        logdet += 2 * std::log(L0.matrixL()(i, i));
+
+    if (beta) *beta = L1.matrixL().transpose().solve(svd.matrixV());
+    return true;
+}
+
+// Builds the (d, b) grid described by `opt`
+static std::vector<std::pair<double, double>> lr_grid(const lr_options &opt) {
+    if (!(opt.step > 0) || opt.d_max < opt.d_min || opt.b_max < opt.b_min)
+        throw std::invalid_argument("invalid lr_options: d and b ranges must be non-empty and step must be positive");
+
+    const double eps = 1e-9 * opt.step;
+    std::vector<std::pair<double, double>> grid;
+    for (size_t i = 0; opt.d_min + i*opt.step <= opt.d_max + eps; i++) {
+        const double d = opt.d_min + i*opt.step;
+        if (opt.d_equals_b) {
+            if (d >= opt.b_min - eps && d <= opt.b_max + eps)
+                grid.emplace_back(d, d);
+            continue;
+        }
+        for (size_t j = 0; opt.b_min + j*opt.step <= opt.b_max + eps; j++) {
+            const double b = opt.b_min + j*opt.step;
+            if (b > d + eps) break;
+            grid.emplace_back(d, b);
+        }
+    }
+    if (grid.empty())
+        throw std::invalid_argument("invalid lr_options: the (d, b) grid is empty (b must not exceed d)");
+    return grid;
+}
+
+// Checks the data and returns it as a T x m matrix of levels, where m = p+1 if `constant` is true
+// (the extra column is a column of ones, for the restricted constant) and m = p otherwise.  m is thus
+// the number of columns of Z1 in the reduced rank regression.
+static MatrixXd levels(const std::vector<double> &data, const size_t &p, const bool &constant) {
+    if (p == 0)
+        throw std::invalid_argument("invalid number of series: p must be at least 1");
+    if (data.size() % p != 0)
+        throw std::invalid_argument(ostringstream() << "invalid data: size (" << data.size() << ") is not a multiple of p (" << p << ")");
+    const size_t T = data.size() / p;
+    const size_t m = p + (constant ? 1 : 0);
+    if (T <= 2*m)
+        throw std::invalid_argument(ostringstream() << "invalid data: too few observations (" << T << ") for " << p << " series");
+
+    MatrixXd X(T, m);
+    for (size_t t = 0; t < T; t++) {
+        for (size_t i = 0; i < p; i++)
+            X(t, i) = data[t*p + i];
+        if (constant) X(t, p) = 1.0;
+    }
+    return X;
+}
+
+// The best (highest) log-likelihood found for a given rank, and the grid index where it was found
+struct lr_best {
+    double loglik = -std::numeric_limits<double>::infinity();
+    size_t at = (size_t) -1;
+
+    void update(const double &ll, const size_t &i) {
+        if (ll > loglik || (ll == loglik && i < at)) { loglik = ll; at = i; }
+    }
+};
+
+std::vector<lr_result> lr_rank_tests(const std::vector<double> &data, const size_t &p, const bool &constant,
+        const lr_options &options) {
+    const MatrixXd X = levels(data, p, constant);
+    const size_t T = X.rows(), m = X.cols();
+
+    const auto grid = lr_grid(options);
+
+    // Z0 = \Delta^d X and Z1 = \Delta^{d-b} L_b X = \Delta^{d-b} X - \Delta^d X, so every grid
+    // point just needs the series filtered by \Delta^d and \Delta^{d-b}.  Collect the distinct
+    // exponents so that each filter is only computed once.
+    std::map<long long, size_t> exp_index;
+    std::vector<double> exponents;
+    auto exponent_key = [](const double &e) { return std::llround(e * 1e9); };
+    auto add_exponent = [&](const double &e) {
+        if (exp_index.emplace(exponent_key(e), exponents.size()).second)
+            exponents.push_back(e);
+    };
+    for (auto &db : grid) {
+        add_exponent(db.first);
+        add_exponent(db.first - db.second);
+    }
+
+    std::vector<MatrixXd> filtered(exponents.size());
+    parallel_for(exponents.size(), options.threads, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; i++)
+            filtered[i] = fracdiff(fracdiff_coefs(exponents[i], T), X);
+    });
+
+    // For each grid point, we do the reduced rank regression of Z0 on Z1: the squared canonical
+    // correlations \lambda_1 \geq ... \geq \lambda_p solve |\lambda S11 - S10 S00^{-1} S01| = 0, and
+    // the profile log-likelihood for rank r (up to a constant) is:
+    //     -T/2 (log|S00| + \sum_{i=1}^r log(1 - \lambda_i))
+    // We track, for every rank, the grid point maximizing it.
+    // The grid loop below runs concurrently, so it only looks up exponents (through a const
+    // reference, which can't insert)
+    const std::map<long long, size_t> &exp_lookup = exp_index;
+    const unsigned int nthreads = thread_count(options.threads, grid.size());
+    std::vector<std::vector<lr_best>> best(nthreads, std::vector<lr_best>(p+1));
+    parallel_for(grid.size(), nthreads, [&](size_t begin, size_t end, unsigned int thread) {
+        std::vector<lr_best> &mybest = best[thread];
+        MatrixXd Z1(T, m), S00(p, p), S01(p, m), S11(m, m);
+        VectorXd lambda(p);
+        double logdet;
+        for (size_t g = begin; g < end; g++) {
+            const MatrixXd &Fd = filtered[exp_lookup.at(exponent_key(grid[g].first))];
+            const MatrixXd &Fe = filtered[exp_lookup.at(exponent_key(grid[g].first - grid[g].second))];
+            const auto Z0 = Fd.leftCols(p);
+            Z1 = Fe - Fd;
+
+            S00.noalias() = Z0.transpose() * Z0 / (double) T;
+            S01.noalias() = Z0.transpose() * Z1 / (double) T;
+            S11.noalias() = Z1.transpose() * Z1 / (double) T;
+
+            if (!reduced_rank(S00, S01, S11, lambda, logdet)) continue;
+
+            double ll = -0.5 * T * logdet;
+            mybest[0].update(ll, g);
+            for (size_t r = 1; r <= p; r++) {
+                ll -= 0.5 * T * std::log(1.0 - lambda(r-1));
+                mybest[r].update(ll, g);
+            }
+        }
+    });
+
+    std::vector<lr_best> overall(p+1);
+    for (auto &b : best)
+        for (size_t r = 0; r <= p; r++)
+            overall[r].update(b[r].loglik, b[r].at);
+    if (overall[p].at == (size_t) -1)
+        throw std::runtime_error("unable to calculate LR statistic: moment matrices are singular at every grid point");
+
+    std::vector<lr_result> results(p);
+    for (unsigned int r = 0; r < p; r++) {
+        lr_result &res = results[r];
+        res.rank = r;
+        res.q = (unsigned int) (p - r);
+        res.statistic = std::max(0.0, 2 * (overall[p].loglik - overall[r].loglik));
+        res.d = grid[overall[p].at].first;
+        res.b = grid[overall[p].at].second;
+        res.d_null = grid[overall[r].at].first;
+        res.b_null = grid[overall[r].at].second;
+        res.pvalue = pvalue_advanced(res.statistic, res.q, res.b, constant, options.interp, options.approx_points);
+    }
+    return results;
+}
+
+lr_result lr_test(const std::vector<double> &data, const size_t &p, const unsigned int &rank, const bool &constant,
+        const lr_options &options) {
+    if (rank >= p)
+        throw std::invalid_argument(ostringstream() << "invalid rank (" << rank << "): must be less than p (" << p << ")");
+    return lr_rank_tests(data, p, constant, options)[rank];
+}
+
+lr_fit lr_estimate(const std::vector<double> &data, const size_t &p, const unsigned int &rank, const bool &constant,
+        const double &d, const double &b) {
+    if (rank >= p)
+        throw std::invalid_argument(ostringstream() << "invalid rank (" << rank << "): must be less than p (" << p << ")");
+    if (!(b > 0) || b > d)
+        throw std::invalid_argument(ostringstream() << "invalid d, b values (" << d << ", " << b << "): must have 0 < b <= d");
+
+    const MatrixXd X = levels(data, p, constant);
+    const size_t T = X.rows();
+
+    const MatrixXd Fd = fracdiff(fracdiff_coefs(d, T), X);
+    const MatrixXd Z1 = fracdiff(fracdiff_coefs(d - b, T), X) - Fd;
+    const auto Z0 = Fd.leftCols(p);
+    const MatrixXd S00 = Z0.transpose() * Z0 / (double) T,
+          S01 = Z0.transpose() * Z1 / (double) T,
+          S11 = Z1.transpose() * Z1 / (double) T;
+
+    VectorXd lambda;
+    double logdet;
+    MatrixXd V;
+    if (!reduced_rank(S00, S01, S11, lambda, logdet, &V))
+        throw std::runtime_error("unable to estimate model: moment matrices are singular");
+
+    lr_fit fit;
+    fit.p = p;
+    fit.T = T;
+    fit.rank = rank;
+    fit.constant = constant;
+    fit.d = d;
+    fit.b = b;
+    fit.statistic = 0;
+    for (size_t i = rank; i < p; i++)
+        fit.statistic -= T * std::log(1.0 - lambda(i));
+
+    // With beta' S11 beta = I, alpha = S01 beta
+    const MatrixXd beta = V.leftCols(rank), alpha = S01 * beta;
+    const MatrixXd resid = Z0 - Z1 * beta * alpha.transpose();
+
+    fit.alpha.resize(p*rank);
+    fit.beta.resize(p*rank);
+    fit.rho.resize(constant ? rank : 0);
+    for (size_t j = 0; j < rank; j++) {
+        for (size_t i = 0; i < p; i++) {
+            fit.alpha[i*rank + j] = alpha(i, j);
+            fit.beta[i*rank + j] = beta(i, j);
+        }
+        if (constant) fit.rho[j] = beta(p, j);
+    }
+    fit.residuals.resize(T*p);
+    for (size_t t = 0; t < T; t++)
+        for (size_t i = 0; i < p; i++)
+            fit.residuals[t*p + i] = resid(t, i);
+
+    return fit;
+}
+
+// A small, fast random number generator (splitmix64) used for the bootstrap draws
+struct splitmix64 {
+    unsigned long long state;
+    unsigned long long operator()() {
+        unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+bootstrap_result lr_bootstrap(const lr_fit &fit, const bootstrap_options &options) {
+    if (options.replications == 0)
+        throw std::invalid_argument("invalid bootstrap options: replications must be at least 1");
+
+    const size_t p = fit.p, T = fit.T, r = fit.rank, m = p + (fit.constant ? 1 : 0);
+    if (fit.residuals.size() != T*p || fit.alpha.size() != p*r || fit.beta.size() != p*r || fit.rho.size() != (fit.constant ? r : 0))
+        throw std::invalid_argument("invalid lr_fit: inconsistent dimensions");
+
+    bootstrap_result result;
+    result.statistic = fit.statistic;
+    result.asymptotic_pvalue = pvalue_advanced(fit.statistic, (unsigned int) (p - r), fit.b, fit.constant,
+            options.interp, options.approx_points);
+
+    // The bootstrap samples follow the fitted model:
+    //     \Delta^d X_t = \alpha \beta_+' Z1_t + \varepsilon^*_t,   Z1_t = \Delta^{d-b} L_b (X_t', 1)'
+    // where \beta_+ = (\beta', \rho)'.  Since \Delta^{d-b} L_b = \Delta^{d-b} - \Delta^d has
+    // coefficients \kappa_j = \pi_j(d-b) - \pi_j(d) with \kappa_0 = 0, Z1_t depends only on earlier
+    // observations, so we can generate the sample recursively:
+    //     Z1_t = \sum_{s<t} \kappa_{t-s} X_s,  Z0_t = \Gamma Z1_t + \varepsilon^*_t,
+    //     X_t = Z0_t - \sum_{s<t} \pi_{t-s}(d) X_s
+    // which also gives us the Z0 = \Delta^d X and Z1 regressors for the bootstrap statistic without
+    // having to filter the bootstrap sample again.
+    const VectorXd pi_d = fracdiff_coefs(fit.d, T+1), pi_e = fracdiff_coefs(fit.d - fit.b, T+1);
+    // Reversed coefficients, so the sums above are contiguous dot products: krev[T-t+s] = \kappa_{t-s}
+    std::vector<double> krev(T+1), pirev(T+1);
+    for (size_t i = 1; i <= T; i++) {
+        krev[i] = pi_e(T-i) - pi_d(T-i);
+        pirev[i] = pi_d(T-i);
+    }
+    // The constant column of Z1 is deterministic: \sum_{j=0}^t \kappa_j
+    std::vector<double> const_z1(T);
+    double csum = 0;
+    for (size_t t = 0; t < T; t++) {
+        csum += pi_e(t) - pi_d(t);
+        const_z1[t] = csum;
+    }
+    MatrixXd Gamma = MatrixXd::Zero(p, m);
+    for (size_t i = 0; i < p; i++)
+        for (size_t k = 0; k < m; k++)
+            for (size_t j = 0; j < r; j++)
+                Gamma(i, k) += fit.alpha[i*r + j] * (k < p ? fit.beta[k*r + j] : fit.rho[j]);
+
+    const unsigned int nthreads = thread_count(options.threads, options.replications);
+    std::vector<size_t> exceed(nthreads, 0), used(nthreads, 0);
+    parallel_for(options.replications, nthreads, [&](size_t begin, size_t end, unsigned int thread) {
+        // Per-thread workspace, allocated once and reused for every replication
+        std::vector<std::vector<double>> X(p, std::vector<double>(T));
+        MatrixXd Z0(T, p), Z1(T, m), S00(p, p), S01(p, m), S11(m, m);
+        VectorXd z1(m), dx(p), lambda(p);
+        double logdet;
+
+        for (size_t rep = begin; rep < end; rep++) {
+            splitmix64 rng{options.seed + rep * 0xD1B54A32D192ED03ULL};
+            unsigned long long bits = 0;
+            for (size_t t = 0; t < T; t++) {
+                if (t % 64 == 0) bits = rng();
+                const double w = (bits & 1) ? 1.0 : -1.0;
+                bits >>= 1;
+
+                const double *kr = krev.data() + (T - t), *pr = pirev.data() + (T - t);
+                for (size_t i = 0; i < p; i++) {
+                    const double *x = X[i].data();
+                    double zk = 0, dk = 0;
+                    for (size_t s = 0; s < t; s++) {
+                        zk += kr[s] * x[s];
+                        dk += pr[s] * x[s];
+                    }
+                    z1(i) = zk;
+                    dx(i) = dk;
+                }
+                if (m > p) z1(p) = const_z1[t];
+                Z1.row(t) = z1.transpose();
+                for (size_t i = 0; i < p; i++) {
+                    const double z0 = Gamma.row(i).dot(z1) + w * fit.residuals[t*p + i];
+                    X[i][t] = z0 - dx(i);
+                    Z0(t, i) = z0;
+                }
+            }
+
+            S00.noalias() = Z0.transpose() * Z0 / (double) T;
+            S01.noalias() = Z0.transpose() * Z1 / (double) T;
+            S11.noalias() = Z1.transpose() * Z1 / (double) T;
+            if (!reduced_rank(S00, S01, S11, lambda, logdet)) continue;
+            used[thread]++;
+
+            double stat = 0;
+            for (size_t i = r; i < p; i++)
+                stat -= T * std::log(1.0 - lambda(i));
+            if (stat >= fit.statistic) exceed[thread]++;
+        }
+    });
+
+    // Replications with singular moment matrices have no statistic, so they count for neither the
+    // numerator nor the denominator.
+    size_t total = 0, replications = 0;
+    for (unsigned int t = 0; t < nthreads; t++) {
+        total += exceed[t];
+        replications += used[t];
+    }
+    if (replications == 0)
+        throw std::runtime_error("unable to calculate bootstrap p-value: moment matrices are singular in every replication");
+    result.replications = (unsigned int) replications;
+    result.pvalue = (1.0 + total) / (replications + 1.0);
+    return result;
+}
+
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <fracdist/common.hpp>
+#include <vector>
+
+/** @file fracdist/lrtest.hpp
+ * @brief Header file for fracdist's interface to calculating fractional unit root and cointegration
+ * rank test statistics.
+ *
+ * The test statistics are the likelihood ratio (LR) rank test statistics of the fractionally
+ * cointegrated VAR model of Johansen and Nielsen (2012) without lagged differences:
+ *
+ * \f[
+ *     \Delta^d X_t = \alpha \Delta^{d-b} L_b (\beta' X_t + \rho') + \varepsilon_t
+ * \f]
+ *
+ * where \f$L_b = 1 - \Delta^b\f$ is the fractional lag operator, the fractional filters are
+ * truncated at the start of the sample, and the restricted constant term \f$\rho'\f$ is only
+ * included when `constant` is true.  For a given \f$(d, b)\f$ the model is estimated by reduced rank
+ * regression; the profile likelihood is then maximized over a grid of \f$(d, b)\f$ values.  The LR
+ * statistic for the null hypothesis of cointegration rank \f$r\f$ against the unrestricted rank
+ * \f$p\f$ model has the asymptotic distribution tabulated by fracdist with \f$q = p - r\f$.  A
+ * fractional unit root test is the special case \f$p = 1, r = 0\f$.
+ */
+
+namespace fracdist {
+
+/** Options controlling the \f$(d, b)\f$ grid search performed by lr_test() and lr_rank_tests().
+ * The grid consists of all \f$d = d_{min}, d_{min} + h, \ldots \leq d_{max}\f$ and
+ * \f$b = b_{min}, b_{min} + h, \ldots \leq b_{max}\f$ with \f$b \leq d\f$, where \f$h\f$ is `step`.
+ */
+struct lr_options {
+    /// The smallest d value in the grid search
+    double d_min;
+    /// The largest d value in the grid search
+    double d_max;
+    /// The smallest b value in the grid search; must be at least `fracdist::bvalues.front()` to
+    /// obtain a p-value.
+    double b_min;
+    /// The largest b value in the grid search; must be at most `fracdist::bvalues.back()` to obtain
+    /// a p-value.
+    double b_max;
+    /// The grid step size for both d and b
+    double step;
+    /// If true, only grid points with \f$d = b\f$ are considered (the FCVAR\f$_b\f$ model).
+    bool d_equals_b;
+    /// The number of threads to use for the grid search; 0 means one per hardware thread.
+    unsigned int threads;
+    /// The interpolation mode used when calculating p-values
+    interpolation interp;
+    /// The number of approximation points used when calculating p-values
+    unsigned int approx_points;
+
+    /// Constructs the default options: a grid with step 0.01 over \f$0.51 \leq b \leq d \leq 2\f$,
+    /// using all available hardware threads, with p-values from interpolation::JGMMON14 and 9
+    /// approximation points.
+    lr_options() : d_min(0.51), d_max(2.0), b_min(0.51), b_max(2.0), step(0.01), d_equals_b(false),
+        threads(0), interp(interpolation::JGMMON14), approx_points(9) {}
+};
+
+/** The result of an LR rank test. */
+struct lr_result {
+    /// The LR test statistic
+    double statistic;
+    /// The null hypothesis cointegration rank \f$r\f$
+    unsigned int rank;
+    /// The \f$q = p - r\f$ value of the test's asymptotic distribution
+    unsigned int q;
+    /// The estimate of \f$d\f$ in the unrestricted (rank \f$p\f$) model
+    double d;
+    /// The estimate of \f$b\f$ in the unrestricted (rank \f$p\f$) model; this is the `b` used for
+    /// the p-value.
+    double b;
+    /// The estimate of \f$d\f$ in the restricted (rank \f$r\f$) model
+    double d_null;
+    /// The estimate of \f$b\f$ in the restricted (rank \f$r\f$) model
+    double b_null;
+    /// The p-value of the statistic, from pvalue_advanced()
+    double pvalue;
+};
+
+/** Calculates the LR test statistic for the null hypothesis that the cointegration rank of the `p`
+ * series in `data` is `rank`, against the alternative of rank `p`, along with the estimated d and b
+ * values and the p-value of the statistic.
+ *
+ * `data` contains the observations in row-major order: `data[t*p + i]` is observation `t` of
+ * series `i`.
+ *
+ * The grid search is multithreaded (see lr_options::threads).  The fractionally filtered series
+ * needed at each grid point are computed once for each distinct filter exponent and shared across
+ * all grid points (and threads) that use them.
+ *
+ * The statistic is profiled over the \f$(d, b)\f$ grid: the restricted and unrestricted models each
+ * get their own estimates.  It is thus not the statistic that lr_bootstrap() bootstraps, which is
+ * lr_fit::statistic, evaluated with both models at the same fixed \f$(d, b)\f$ (and possibly
+ * quite different); a bootstrap p-value goes with bootstrap_result::statistic, not with this one.
+ *
+ * \throws std::invalid_argument if `p` is 0, `data.size()` is not a multiple of `p`, there are too
+ * few observations, `rank >= p`, or the options don't describe a non-empty grid.
+ * \throws std::out_of_range if the estimated b or `p - rank` is not supported by pvalue_advanced().
+ */
+lr_result lr_test(const std::vector<double> &data, const size_t &p, const unsigned int &rank, const bool &constant,
+        const lr_options &options = lr_options());
+
+/** Like lr_test(), but returns the results for every null hypothesis rank \f$r = 0, 1, \ldots, p-1\f$
+ * (in that order).  All of the statistics come from the same grid search, so this costs essentially
+ * the same as a single lr_test() call.
+ */
+std::vector<lr_result> lr_rank_tests(const std::vector<double> &data, const size_t &p, const bool &constant,
+        const lr_options &options = lr_options());
+
+
+/** A fitted model at fixed \f$(d, b)\f$ values under the null hypothesis of cointegration rank
+ * \f$r\f$, as returned by lr_estimate().  Matrices are stored in row-major order.
+ */
+struct lr_fit {
+    /// The number of series
+    size_t p;
+    /// The number of observations
+    size_t T;
+    /// The cointegration rank \f$r\f$ of the fitted model
+    unsigned int rank;
+    /// Whether the model includes a restricted constant
+    bool constant;
+    /// The fractional parameters the model was fitted at
+    double d, b;
+    /// The \f$p \times r\f$ adjustment coefficients \f$\alpha\f$
+    std::vector<double> alpha;
+    /// The \f$p \times r\f$ cointegrating vectors \f$\beta\f$
+    std::vector<double> beta;
+    /// The \f$r\f$ restricted constant terms \f$\rho\f$ (empty if `constant` is false)
+    std::vector<double> rho;
+    /// The \f$T \times p\f$ residuals \f$\hat\varepsilon_t\f$
+    std::vector<double> residuals;
+    /// The LR statistic for rank \f$r\f$ against rank \f$p\f$, evaluated at the fixed \f$(d, b)\f$
+    double statistic;
+};
+
+/** Estimates the model with cointegration rank `rank` by reduced rank regression at the given,
+ * fixed `d` and `b` values, returning the estimated coefficients, the residuals, and the LR
+ * statistic for rank `rank` against rank `p` at those `d` and `b` values.  The `d` and `b` values
+ * would typically be the restricted estimates (lr_result::d_null and lr_result::b_null) from
+ * lr_test().
+ *
+ * \throws std::invalid_argument for invalid data or rank (as in lr_test()), or if `b > d` or `b <= 0`.
+ * \throws std::runtime_error if the moment matrices are singular.
+ */
+lr_fit lr_estimate(const std::vector<double> &data, const size_t &p, const unsigned int &rank, const bool &constant,
+        const double &d, const double &b);
+
+/** Options for lr_bootstrap(). */
+struct bootstrap_options {
+    /// The number of bootstrap replications
+    unsigned int replications;
+    /// The random number seed.  The bootstrap samples depend only on the seed and the replication
+    /// number, so results are reproducible regardless of the number of threads.
+    unsigned long long seed;
+    /// The number of threads to use; 0 means one per hardware thread.
+    unsigned int threads;
+    /// The interpolation mode used when calculating the asymptotic p-value
+    interpolation interp;
+    /// The number of approximation points used when calculating the asymptotic p-value
+    unsigned int approx_points;
+
+    /// Constructs the default options: 999 replications with a fixed seed, using all available
+    /// hardware threads, and the default interpolation::JGMMON14, 9-point asymptotic p-value.
+    bootstrap_options() : replications(999), seed(0x5eed5eed5eedULL), threads(0),
+        interp(interpolation::JGMMON14), approx_points(9) {}
+};
+
+/** The result of lr_bootstrap(). */
+struct bootstrap_result {
+    /// The LR statistic (lr_fit::statistic, at the fit's fixed \f$(d, b)\f$; not lr_result::statistic)
+    double statistic;
+    /** The bootstrap p-value, \f$(1 + k)/(B + 1)\f$, where \f$k\f$ of the \f$B\f$ bootstrap
+     * statistics are at least as large as `statistic`
+     */
+    double pvalue;
+    /// The asymptotic p-value of `statistic`, from pvalue_advanced() with \f$q = p - r\f$
+    double asymptotic_pvalue;
+    /** The number of bootstrap replications used, \f$B\f$: `options.replications` less any whose
+     * moment matrices were singular (which are skipped)
+     */
+    unsigned int replications;
+};
+
+/** Calculates a wild bootstrap p-value for the LR rank test statistic of a fitted model, along with
+ * the asymptotic p-value for comparison.
+ *
+ * Each bootstrap sample is generated recursively from the fitted model (at its fixed \f$d\f$ and
+ * \f$b\f$) using the residuals multiplied by independent Rademacher (\f$\pm 1\f$) draws, and its LR
+ * statistic is computed at the same fixed \f$d\f$ and \f$b\f$.  The replications are distributed
+ * across threads, each of which allocates its workspace once and reuses it for all of its
+ * replications.
+ *
+ * The bootstrapped statistic is the fit's lr_fit::statistic, for rank \f$r\f$ against rank \f$p\f$
+ * with both models at the fit's \f$(d, b)\f$.  It is not the profiled lr_result::statistic from
+ * lr_test() for the same data and rank, which can differ considerably (the unrestricted model gets
+ * its own \f$(d, b)\f$ there), so the bootstrap p-value must not be compared with that statistic.
+ *
+ * \throws std::invalid_argument if `options.replications` is 0.
+ * \throws std::runtime_error if the moment matrices are singular in every replication.
+ * \throws std::out_of_range if `fit.b` or `fit.p - fit.rank` is not supported by pvalue_advanced().
+ */
+bootstrap_result lr_bootstrap(const lr_fit &fit, const bootstrap_options &options = bootstrap_options());
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+/** @file fracdist/monotone.hpp
+ * @brief Allocation-free monotone piecewise cubic interpolation.
+ */
+
+namespace fracdist {
+
+/** A shape-preserving piecewise cubic Hermite interpolant (often called PCHIP) through `N` points
+ * with strictly increasing \f$x\f$ values.  The slopes at the interior points are the weighted
+ * harmonic means of the adjacent secants (Fritsch and Butland, 1984), or 0 where the secants
+ * differ in sign, so the interpolant is monotone wherever the data are, and has no overshoot.
+ *
+ * Evaluation is a binary search for the interval followed by a cubic polynomial evaluation.
+ * Outside \f$[x_0, x_{N-1}]\f$ the interpolant is extended linearly using the end slopes.
+ */
+template <size_t N>
+class monotone_cubic {
+    public:
+        static_assert(N >= 2, "monotone_cubic requires at least 2 points");
+
+        /** Constructs the interpolant through the points \f$(x_i, y_i)\f$, i = 0, ..., N-1.
+         *
+         * \throws std::runtime_error if the `x` values are not strictly increasing.
+         */
+        monotone_cubic(const double *x, const double *y) {
+            std::array<double, N-1> h, secant;
+            for (size_t i = 0; i < N-1; i++) {
+                h[i] = x[i+1] - x[i];
+                if (!(h[i] > 0))
+                    throw std::runtime_error("monotone_cubic requires strictly increasing x values");
+                secant[i] = (y[i+1] - y[i]) / h[i];
+            }
+
+            std::array<double, N> d;
+            if (N == 2) {
+                d[0] = d[N-1] = secant[0];
+            }
+            else {
+                for (size_t i = 1; i < N-1; i++) {
+                    if (secant[i-1] * secant[i] <= 0)
+                        d[i] = 0;
+                    else {
+                        const double w1 = 2*h[i] + h[i-1], w2 = h[i] + 2*h[i-1];
+                        d[i] = (w1 + w2) / (w1 / secant[i-1] + w2 / secant[i]);
+                    }
+                }
+                d[0] = end_slope(h[0], h[1], secant[0], secant[1]);
+                d[N-1] = end_slope(h[N-2], h[N-3], secant[N-2], secant[N-3]);
+            }
+
+            for (size_t i = 0; i < N; i++) x_[i] = x[i];
+            for (size_t i = 0; i < N-1; i++) {
+                coef_[i][0] = y[i];
+                coef_[i][1] = d[i];
+                coef_[i][2] = (3*secant[i] - 2*d[i] - d[i+1]) / h[i];
+                coef_[i][3] = (d[i] + d[i+1] - 2*secant[i]) / (h[i]*h[i]);
+            }
+            y_last_ = y[N-1];
+            d_last_ = d[N-1];
+        }
+
+        /// Evaluates the interpolant at `v`
+        double operator()(const double &v) const {
+            if (v >= x_[N-1]) return y_last_ + d_last_ * (v - x_[N-1]);
+            if (v <= x_[0]) return coef_[0][0] + coef_[0][1] * (v - x_[0]);
+            const size_t i = std::upper_bound(x_.begin(), x_.end(), v) - x_.begin() - 1;
+            const std::array<double, 4> &c = coef_[i];
+            const double s = v - x_[i];
+            return c[0] + s * (c[1] + s * (c[2] + s * c[3]));
+        }
+
+        /// The x values of the interpolation points
+        const std::array<double, N>& x() const { return x_; }
+
+    private:
+        // The one-sided three-point slope estimate at an end point, adjusted to preserve shape: h0
+        // and s0 are the width and secant of the end interval, h1 and s1 of its neighbour.
+        static double end_slope(const double &h0, const double &h1, const double &s0, const double &s1) {
+            double d = ((2*h0 + h1) * s0 - h0 * s1) / (h0 + h1);
+            if (d * s0 <= 0) d = 0;
+            else if (s0 * s1 <= 0 && std::fabs(d) > std::fabs(3*s0)) d = 3*s0;
+            return d;
+        }
+
+        std::array<double, N> x_;
+        // coef_[i] holds the coefficients of the cubic in (v - x_[i]) on [x_[i], x_[i+1]]
+        std::array<std::array<double, 4>, N-1> coef_;
+        double y_last_, d_last_;
+};
+
+}
@@ -0,0 +1,139 @@
+#include <fracdist/panel.hpp>
+#include <fracdist/pvalue.hpp>
+#include <fracdist/parallel.hpp>
+#include <fracdist/sweep.hpp>
+#include <boost/math/special_functions/gamma.hpp>
+#include <algorithm>
+#include <memory>
+#include <tuple>
+
+namespace fracdist {
+
+// See description in fracdist/panel.hpp
+status pvalue_panel(const panel_series *series, const size_t &n, panel_result &result,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T,
+        const unsigned int &threads) noexcept {
+    try {
+        result.pvalues.assign(n, NAN);
+        result.row_status.assign(n, status::ok);
+
+        // Series with a non-finite b (which can't be sorted, and are invalid anyway) get their
+        // statuses directly; the rest are sorted.
+        std::vector<size_t> order;
+        order.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            if (std::isfinite(series[i].b)) order.push_back(i);
+            else {
+                status st;
+                pvalue_batch(&series[i].test_stat, &result.pvalues[i], 1, series[i].q, series[i].b, series[i].constant,
+                        interp_mode, approx_points, T, &st);
+                result.row_status[i] = st;
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](const size_t &a, const size_t &b) {
+            return std::make_tuple(series[a].q, series[a].constant, series[a].b) < std::make_tuple(series[b].q, series[b].constant, series[b].b);
+        });
+
+        parallel_for(order.size(), threads, [&](size_t begin, size_t end, unsigned int) {
+            // Each group of series with the same q and constant is walked in increasing b with a
+            // quantile_sweep, and each run of series with the same b within it is one pvalue_rows()
+            // call; the statistics are gathered into (and the results scattered from) contiguous
+            // buffers.  Series with invalid parameters go through pvalue_batch() for their statuses.
+            std::vector<double> stats, pvals;
+            std::vector<status> statuses;
+            for (size_t group = begin; group < end; ) {
+                const panel_series &g = series[order[group]];
+                size_t group_end = group + 1;
+                while (group_end < end && series[order[group_end]].q == g.q && series[order[group_end]].constant == g.constant)
+                    group_end++;
+                std::unique_ptr<quantile_sweep> sweep;
+                if (check_parameters(g.q, bvalues.front(), g.constant, T) == status::ok)
+                    sweep.reset(new quantile_sweep(g.q, g.constant, interp_mode, T));
+
+                for (size_t run = group; run < group_end; ) {
+                    const panel_series &s = series[order[run]];
+                    size_t run_end = run + 1;
+                    while (run_end < group_end && series[order[run_end]].b == s.b) run_end++;
+
+                    const size_t m = run_end - run;
+                    stats.resize(m);
+                    pvals.resize(m);
+                    statuses.resize(m);
+                    for (size_t i = 0; i < m; i++) stats[i] = series[order[run + i]].test_stat;
+                    if (sweep && check_parameters(s.q, s.b, s.constant, T) == status::ok)
+                        detail::pvalue_rows(&(*sweep)(s.b), status::ok, s.q, approx_points, stats.data(), pvals.data(), m, statuses.data());
+                    else
+                        pvalue_batch(stats.data(), pvals.data(), m, s.q, s.b, s.constant, interp_mode, approx_points, T, statuses.data());
+                    for (size_t i = 0; i < m; i++) {
+                        result.pvalues[order[run + i]] = pvals[i];
+                        result.row_status[order[run + i]] = statuses[i];
+                    }
+                    run = run_end;
+                }
+                group = group_end;
+            }
+        });
+
+        combine_pvalues(result);
+    }
+    catch (...) {
+        // Couldn't allocate or start threads; if even the failed results can't be allocated, leave
+        // them empty.
+        try {
+            result.pvalues.assign(n, NAN);
+            result.row_status.assign(n, status::internal_error);
+            result.bh_adjusted.assign(n, NAN);
+        }
+        catch (...) {
+            result.pvalues.clear();
+            result.row_status.clear();
+            result.bh_adjusted.clear();
+        }
+        result.valid = 0;
+        result.fisher_stat = result.fisher_pvalue = result.simes_pvalue = NAN;
+        return n > 0 ? status::internal_error : status::ok;
+    }
+
+    for (auto &s : result.row_status)
+        if (s != status::ok) return s;
+    return status::ok;
+}
+
+// See description in fracdist/panel.hpp
+void combine_pvalues(panel_result &result) {
+    const size_t n = result.pvalues.size();
+    if (result.row_status.size() != n)
+        throw std::invalid_argument(ostringstream() << "invalid panel_result: " << n << " p-values but " << result.row_status.size() << " statuses");
+
+    // The valid series, sorted by p-value
+    std::vector<size_t> order;
+    for (size_t i = 0; i < n; i++)
+        if (result.row_status[i] == status::ok) order.push_back(i);
+    std::sort(order.begin(), order.end(), [&](const size_t &a, const size_t &b) { return result.pvalues[a] < result.pvalues[b]; });
+    const size_t k = order.size();
+    result.valid = k;
+
+    // Benjamini-Hochberg: the adjusted p-value of the i-th smallest p-value is the smallest of
+    // min(1, k p_(j) / j) over j >= i; the smallest of them is Simes' p-value.
+    result.bh_adjusted.assign(n, NAN);
+    double adjusted = 1.0;
+    for (size_t j = k; j > 0; j--) {
+        adjusted = std::min(adjusted, k * result.pvalues[order[j-1]] / j);
+        result.bh_adjusted[order[j-1]] = adjusted;
+    }
+    result.simes_pvalue = k > 0 ? adjusted : NAN;
+
+    if (k == 0) {
+        result.fisher_stat = result.fisher_pvalue = NAN;
+        return;
+    }
+    double fisher = 0;
+    for (const size_t &i : order)
+        fisher -= 2 * std::log(result.pvalues[i]);
+    result.fisher_stat = fisher;
+    // The chi-squared upper tail with 2k degrees of freedom, Q(k, x/2); a p-value of 0 makes the
+    // statistic infinite, and the combined p-value 0.
+    result.fisher_pvalue = std::isinf(fisher) ? 0.0 : boost::math::gamma_q((double) k, fisher / 2);
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <fracdist/common.hpp>
+#include <cstddef>
+#include <vector>
+
+/** @file fracdist/panel.hpp
+ * @brief P-values for a panel of separately tested series, and their multiple-testing combinations.
+ */
+
+namespace fracdist {
+
+/** One series of a panel: the parameters of its test and its test statistic. */
+struct panel_series {
+    /// The q value
+    unsigned int q;
+    /// The (estimated) b value
+    double b;
+    /// Whether the model has a constant
+    bool constant;
+    /// The test statistic
+    double test_stat;
+};
+
+/** The results of pvalue_panel(): the p-value of each series and the combinations of them.  The
+ * combinations use only the series whose p-values could be calculated (`valid` of them); if there
+ * are none, the combined p-values are NaN.
+ */
+struct panel_result {
+    /// The p-value of each series (NaN if it couldn't be calculated)
+    std::vector<double> pvalues;
+    /// The status of each series' p-value
+    std::vector<status> row_status;
+    /** The Benjamini-Hochberg adjusted p-value of each series (NaN for an invalid series): the
+     * smallest false discovery rate at which the BH procedure rejects the series.  The series
+     * rejected at false discovery rate \f$\alpha\f$ are those with adjusted p-values \f$\le\alpha\f$.
+     */
+    std::vector<double> bh_adjusted;
+    /// The number of series whose p-values could be calculated
+    size_t valid = 0;
+    /// Fisher's combination statistic, \f$-2\sum_i \log p_i\f$
+    double fisher_stat = NAN;
+    /** The p-value of Fisher's statistic (the upper tail of the chi-squared distribution with
+     * \f$2k\f$ degrees of freedom, for \f$k\f$ valid series), for the null hypothesis that every
+     * series' null is true, assuming the series are independent.
+     */
+    double fisher_pvalue = NAN;
+    /** Simes' combined p-value, \f$\min_i k p_{(i)}/i\f$ over the sorted p-values \f$p_{(i)}\f$, for
+     * the same null as fisher_pvalue but also valid for positively dependent series.  (This is also
+     * the smallest of the BH adjusted p-values.)
+     */
+    double simes_pvalue = NAN;
+};
+
+/** Calculates the p-value (as pvalue_advanced() does) of each of the `n` series `series[0]` through
+ * `series[n-1]`, each with its own q, b, constant, and test statistic, then combines them.  The
+ * series are sorted by q, constant, and b, and the sorted order divided among `threads` threads (0
+ * for one per hardware thread).  Each thread walks the series of each (q, constant) in increasing
+ * b with a quantile_sweep, so that interpolating the quantiles at a new b value is cheap even when
+ * every series has its own b, and interpolates them just once for series sharing a b value.  As
+ * for quantile_sweep, the p-values agree with pvalue_advanced() up to rounding error.
+ *
+ * Statuses and NaN p-values are as for pvalue_batch(), but per series.  Returns status::ok if every
+ * p-value was calculated, otherwise the status of the first failure (in series order).
+ */
+status pvalue_panel(const panel_series *series, const size_t &n, panel_result &result,
+        const interpolation &interp_mode = interpolation::JGMMON14, const unsigned int &approx_points = 9,
+        const unsigned int &T = 0, const unsigned int &threads = 0) noexcept;
+
+/** Calculates the combinations (Fisher, Simes, and Benjamini-Hochberg) of `result.pvalues` for the
+ * series with `result.row_status` equal to status::ok, storing them in `result`.  pvalue_panel()
+ * calls this; it is also useful for combining p-values calculated some other way (in which case
+ * `row_status` must have the same size as `pvalues`).
+ *
+ * \throws std::invalid_argument if `result.pvalues` and `result.row_status` have different sizes
+ */
+void combine_pvalues(panel_result &result);
+
+}
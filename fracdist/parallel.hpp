@@ -0,0 +1,50 @@
+#pragma once
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+/** @file fracdist/parallel.hpp
+ * @brief Header file for the small threading helper used by fracdist's multithreaded routines.
+ */
+
+namespace fracdist {
+
+/** Returns the number of threads to use for a multithreaded operation when the caller requests
+ * `threads` threads: `threads` itself if non-zero, otherwise the number of hardware threads (or 1 if
+ * that cannot be determined).  The result is never larger than `tasks` (unless `tasks` is 0).
+ */
+inline unsigned int thread_count(const unsigned int &threads, const size_t &tasks) {
+    unsigned int n = threads ? threads : std::thread::hardware_concurrency();
+    if (n == 0) n = 1;
+    if (tasks > 0 && n > tasks) n = (unsigned int) tasks;
+    return n;
+}
+
+/** Splits the index range \f$[0, n)\f$ into `threads` contiguous chunks and calls `f(begin, end,
+ * thread_index)` for each chunk, each in its own thread (the last chunk runs in the calling thread).
+ * Returns once all chunks have finished.  If any call throws, the first exception (by thread index)
+ * is rethrown in the calling thread after all threads have finished.
+ */
+template <typename F>
+void parallel_for(const size_t &n, const unsigned int &threads, F f) {
+    const unsigned int nt = thread_count(threads, n);
+    std::vector<std::exception_ptr> errors(nt);
+    auto run = [&](unsigned int t) {
+        size_t begin = n * t / nt, end = n * (t+1) / nt;
+        try { f(begin, end, t); }
+        catch (...) { errors[t] = std::current_exception(); }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(nt - 1);
+    for (unsigned int t = 0; t + 1 < nt; t++)
+        pool.emplace_back(run, t);
+    run(nt - 1);
+    for (auto &th : pool) th.join();
+
+    for (auto &e : errors)
+        if (e) std::rethrow_exception(e);
+}
+
+}
@@ -1,80 +1,305 @@
 #include <fracdist/pvalue.hpp>
-#include <boost/math/distributions/chi_squared.hpp>
-#include <Eigen/Core>
-#include <Eigen/SVD>
-
-using namespace Eigen;
+#include <fracdist/tables.hpp>
+#include <fracdist/stats.hpp>
+#include <fracdist/parallel.hpp>
+#include <algorithm>
 
 namespace fracdist {
 
+static inline status approximate_pvalue(const double &test_stat, const std::array<double, p_length> &quant,
+        const unsigned int &q, const unsigned int &approx_points, double &pval);
+
 // See description in fracdist.h
 double pvalue(const double &test_stat, const unsigned int &q, const double &b, const bool &constant) {
     return pvalue_advanced(test_stat, q, b, constant, interpolation::JGMMON14, 9);
 }
 
+#if FRACDIST_RESPONSE_SURFACE
+// See description in fracdist.h
+double pvalue(const double &test_stat, const unsigned int &q, const double &b, const bool &constant, const unsigned int &T) {
+    return pvalue_advanced(test_stat, q, b, constant, interpolation::JGMMON14, 9, T);
+}
+#endif
+
 // See description in fracdist.h
 double pvalue_advanced(const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
         const interpolation &interp_mode, const unsigned int &approx_points) {
+    return pvalue_advanced(test_stat, q, b, constant, interp_mode, approx_points, 0);
+}
 
-    if (test_stat < 0)
-        throw std::out_of_range(ostringstream() << "test stat (" << test_stat << ") invalid: cannot be negative");
-    // The critical values for test stats of 0 or infinity are trivial: 1 or 0.
-    if (test_stat == 0)
-        return 1.0;
-    if (std::isinf(test_stat))
-        return 0.0;
+// See description in fracdist.h
+double pvalue_advanced(const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) {
+
+    double pval;
+    if (detail::pvalue_trivial(test_stat, pval)) return pval;
 
     // First get the set of quantiles to use (this also checks and q and b are valid):
-    auto quant = quantiles(q, b, constant, interp_mode);
+    auto quant = quantiles(q, b, constant, interp_mode, T);
+
+    FRACDIST_STATS_TIME(pvalue_regression);
+    if (approximate_pvalue(test_stat, quant, q, approx_points, pval) != status::ok)
+        detail::throw_approx_points(approx_points);
+    return pval;
+}
 
-    // If asked for the p-value for a value less than half the smallest quantile we have, or more
-    // than double the largest quantile we have, just give back 0 or 1.
-    if (test_stat < 0.5*quant.front()) return 1.0;
-    if (test_stat > 2*quant.back()) return 0.0;
+// Calls the p-value approximation; the default number of points gets the fixed-size regression.
+static inline status approximate_pvalue(const double &test_stat, const std::array<double, p_length> &quant,
+        const unsigned int &q, const unsigned int &approx_points, double &pval) {
+    return approx_points == 9
+        ? detail::pvalue_from_quantiles<9>(test_stat, quant, q, approx_points, pval)
+        : detail::pvalue_from_quantiles<p_length>(test_stat, quant, q, approx_points, pval);
+}
 
-    // Otherwise we need to do some more work.
+// See description in fracdist/pvalue.hpp
+pvalue_derivatives pvalue_with_derivatives(const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) {
+    pvalue_derivatives result = { 0.0, 0.0, 0.0 };
+    if (detail::pvalue_trivial(test_stat, result.pvalue)) return result;
 
-    // First find the location with a quantile closest to the requested one
-    size_t min_at = find_closest(test_stat, quant);
+    const auto quant = quantiles(q, b, constant, interp_mode, T);
 
-    // Now figure out a set of `approx_points' consecutive points centered on the closest value
-    auto ap = find_bracket(min_at, p_length-1, approx_points);
+    // The same steps as detail::pvalue_from_quantiles(), but keeping the regression
+    FRACDIST_STATS_TIME(pvalue_regression);
+    if (test_stat < 0.5*quant.front()) { result.pvalue = 1.0; return result; }
+    if (test_stat > 2*quant.back()) { result.pvalue = 0.0; return result; }
 
+    const auto ap = find_bracket(find_closest(test_stat, quant), p_length-1, std::min<size_t>(approx_points, p_length));
     if (ap.second - ap.first < 2)
-        throw std::runtime_error(ostringstream() << "approx_points (" << approx_points << ") too small: not enough data points for quadratic approximation");
-
-    // Now we're going to run the regression:
-    // 
-    //     chisqinv_i = \beta_1 + \beta_2 quantile_i + \beta_3 quantile_i^2
-    //
-    // where chisqinv_i is the inverse cdf at p=pvalue[i] of a chi-squared distribution with q^2 df
-    //
-    // The fitted value then gives us a fitted chi-squared value for which we can get a pvalue.
-
-    MatrixX3d X(ap.second - ap.first + 1, 3);
-    VectorXd y(ap.second - ap.first + 1);
-    for (size_t i = ap.first; i <= ap.second; i++) {
-        X(i-ap.first, 0) = 1.0;
-        X(i-ap.first, 1) = quant[i];
-        X(i-ap.first, 2) = quant[i] * quant[i];
-
-        y(i-ap.first) = chisq_inv_p_i(i, q);
+        detail::throw_approx_points(approx_points);
+    const size_t n = ap.second - ap.first + 1;
+    std::array<double, p_length> y;
+    for (size_t i = 0; i < n; i++)
+        y[i] = chisq_inv_p_i(ap.first + i, q);
+
+    const quadratic_fit<p_length> fit(&quant[ap.first], nullptr, n);
+    double beta[3];
+    fit.coefficients(y.data(), beta);
+    const double fitted = beta[0] + test_stat * (beta[1] + test_stat * beta[2]);
+    if (fitted < 0) { result.pvalue = 1.0; return result; }
+
+    result.pvalue = chisq_cdf_upper(q, fitted);
+    const double density = chisq_pdf(q, fitted);
+    result.dstat = -density * (beta[1] + 2 * beta[2] * test_stat);
+
+    // df/db = sum_i df/dQ_i dQ_i/db over the quantiles in the regression
+    const auto dquant = quantile_derivatives(q, b, constant, interp_mode, T);
+    std::array<double, p_length> grad;
+    fit.fitted_gradient(test_stat, &quant[ap.first], y.data(), grad.data());
+    double dfdb = 0;
+    for (size_t i = 0; i < n; i++)
+        dfdb += grad[i] * dquant[ap.first + i];
+    result.db = -density * dfdb;
+    return result;
+}
+
+// See description in fracdist/pvalue.hpp
+status try_pvalue(double &pval, const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) noexcept {
+    return pvalue_batch(&test_stat, &pval, 1, q, b, constant, interp_mode, approx_points, T);
+}
+
+// See description in fracdist/pvalue.hpp
+status pvalue_batch(const double *test_stats, double *pvals, const size_t &n, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T, status *row_status) noexcept {
+    status params = check_parameters(q, b, constant, T);
+    std::array<double, p_length> quant;
+    if (params == status::ok) {
+        // Shouldn't throw: every exception quantiles() can throw is prevented by check_parameters
+        try { quant = quantiles(q, b, constant, interp_mode, T); }
+        catch (...) { params = status::internal_error; }
     }
-    RowVector3d data;
-    data(0) = 1.0;
-    data(1) = test_stat;
-    data(2) = test_stat*test_stat;
+    return detail::pvalue_rows(params == status::ok ? &quant : nullptr, params, q, approx_points, test_stats, pvals, n, row_status);
+}
+
+// See description in fracdist/pvalue.hpp
+FRACDIST_KERNEL status detail::pvalue_rows(const std::array<double, p_length> *quant, const status &params, const unsigned int &q,
+        const unsigned int &approx_points, const double *test_stats, double *pvals, const size_t &n, status *row_status) noexcept {
+    status first = status::ok;
+    for (size_t i = 0; i < n; i++) {
+        const double &t = test_stats[i];
+        double &pval = pvals[i];
+        status s = status::ok;
+        // The same checks, in the same order, as pvalue_advanced()
+        if (!(t >= 0)) s = status::invalid_test_stat;
+        else if (t == 0) pval = 1.0;
+        else if (std::isinf(t)) pval = 0.0;
+        else if (params != status::ok) s = params;
+        else {
+            FRACDIST_STATS_TIME(pvalue_regression);
+            try { s = approximate_pvalue(t, *quant, q, approx_points, pval); }
+            catch (...) { s = status::internal_error; }
+        }
+        if (s != status::ok) {
+            pval = NAN;
+            if (first == status::ok) first = s;
+        }
+        if (row_status) row_status[i] = s;
+    }
+    return first;
+}
+
+// Calculates the p-values of test_stats[order[0]], test_stats[order[1]], ... (which must be positive,
+// finite, and increasing) for one row of pvalue_surface(), storing them in `pvals` (and any failures
+// in `statuses`) at the same indices.  The results are identical to pvalue_from_quantiles<MaxPoints>(),
+// but when the quantiles are increasing, the closest quantile can only move forward as the statistic
+// increases, so it is found by advancing a cursor; and the regression is refitted only when the
+// bracket of quantiles it uses changes.
+template <size_t MaxPoints>
+static void surface_sweep(const std::array<double, p_length> &quant, const unsigned int &q, const unsigned int &approx_points,
+        const double *test_stats, const std::vector<size_t> &order, double *pvals, status *statuses) {
+    bool increasing = true;
+    for (size_t i = 1; i < p_length && increasing; i++)
+        increasing = quant[i] > quant[i-1];
 
-    JacobiSVD<MatrixXd> svd(X, ComputeThinU | ComputeThinV);
-    double fitted = data * svd.solve(y);
+    const size_t size = std::min<size_t>(approx_points, MaxPoints);
+    std::pair<size_t, size_t> fit_ap(1, 0); // An impossible bracket: nothing fitted yet
+    double beta[3] = { 0, 0, 0 };
+    size_t cursor = 0;
+    for (const size_t &j : order) {
+        const double &t = test_stats[j];
+        // The same steps as pvalue_from_quantiles()
+        if (t < 0.5*quant.front()) { pvals[j] = 1.0; continue; }
+        if (t > 2*quant.back()) { pvals[j] = 0.0; continue; }
 
-    // A negative isn't valid, so if we predicted one anyway, truncate it at 0 (which corresponds to
-    // a pvalue of 1).
-    if (fitted < 0) return 1.0;
+        size_t min_at;
+        if (increasing) {
+            // Stopping at the first non-improvement picks the first of two equally close quantiles,
+            // just as find_closest() does
+            while (cursor+1 < p_length && fabs(t - quant[cursor+1]) < fabs(t - quant[cursor])) cursor++;
+            min_at = cursor;
+        }
+        else min_at = find_closest(t, quant);
 
-    // NB: chisq_Q gets the *upper-tail* chisq cdf (chisq_P gives the lower tail)
-    boost::math::chi_squared_distribution<double> chisq(q*q);
-    return cdf(complement(chisq, fitted));
+        const auto ap = find_bracket(min_at, p_length-1, size);
+        if (ap.second - ap.first < 2) { statuses[j] = status::invalid_approx_points; continue; }
+        if (ap != fit_ap) {
+            const size_t n = ap.second - ap.first + 1;
+            std::array<double, MaxPoints> y;
+            for (size_t i = 0; i < n; i++)
+                y[i] = chisq_inv_p_i(ap.first + i, q);
+            if (n == MaxPoints) quadratic_fit<MaxPoints>(&quant[ap.first], nullptr).coefficients(y.data(), beta);
+            else quadratic_fit<MaxPoints>(&quant[ap.first], nullptr, n).coefficients(y.data(), beta);
+            fit_ap = ap;
+        }
+        const double fitted = beta[0] + t * (beta[1] + t * beta[2]);
+        pvals[j] = fitted < 0 ? 1.0 : chisq_cdf_upper(q, fitted);
+    }
+}
+
+// Calculates one row (for a single b value) of pvalue_surface(); `order` holds the indices of the
+// statistics that need a regression, sorted by statistic.  Returns the first failure in the row.
+FRACDIST_KERNEL static status surface_row(const double &b, const double *test_stats, const size_t &ns, const std::vector<size_t> &order,
+        const unsigned int &q, const bool &constant, const interpolation &interp_mode, const unsigned int &approx_points,
+        const unsigned int &T, double *pvals, status *statuses) {
+    status params = check_parameters(q, b, constant, T);
+    std::array<double, p_length> quant;
+    if (params == status::ok) {
+        try { quant = quantiles(q, b, constant, interp_mode, T); }
+        catch (...) { params = status::internal_error; }
+    }
+
+    // The same checks, in the same order, as pvalue_rows(); statistics needing the regression are
+    // left for the sweep.
+    for (size_t j = 0; j < ns; j++) {
+        const double &t = test_stats[j];
+        status &s = statuses[j];
+        s = status::ok;
+        if (!(t >= 0)) s = status::invalid_test_stat;
+        else if (t == 0) pvals[j] = 1.0;
+        else if (std::isinf(t)) pvals[j] = 0.0;
+        else if (params != status::ok) s = params;
+    }
+    if (params == status::ok) {
+        FRACDIST_STATS_TIME(pvalue_regression);
+        try {
+            if (approx_points == 9) surface_sweep<9>(quant, q, approx_points, test_stats, order, pvals, statuses);
+            else surface_sweep<p_length>(quant, q, approx_points, test_stats, order, pvals, statuses);
+        }
+        catch (...) {
+            for (const size_t &j : order) statuses[j] = status::internal_error;
+        }
+    }
+
+    status first = status::ok;
+    for (size_t j = 0; j < ns; j++) {
+        if (statuses[j] != status::ok) {
+            pvals[j] = NAN;
+            if (first == status::ok) first = statuses[j];
+        }
+    }
+    return first;
+}
+
+// See description in fracdist/pvalue.hpp
+status pvalue_surface(const double *b_grid, const size_t &nb, const double *test_stats, const size_t &ns, double *pvals,
+        const unsigned int &q, const bool &constant, const interpolation &interp_mode, const unsigned int &approx_points,
+        const unsigned int &T, const unsigned int &threads, status *cell_status) noexcept {
+    if (nb == 0 || ns == 0) return status::ok;
+    try {
+        std::vector<size_t> order;
+        for (size_t j = 0; j < ns; j++) {
+            if (test_stats[j] > 0 && !std::isinf(test_stats[j])) order.push_back(j);
+        }
+        std::sort(order.begin(), order.end(), [&](const size_t &a, const size_t &b) { return test_stats[a] < test_stats[b]; });
+
+        std::vector<status> row_first(nb);
+        parallel_for(nb, threads, [&](size_t begin, size_t end, unsigned int) {
+            std::vector<status> local(cell_status ? 0 : ns);
+            for (size_t i = begin; i < end; i++) {
+                row_first[i] = surface_row(b_grid[i], test_stats, ns, order, q, constant, interp_mode, approx_points, T,
+                        pvals + i*ns, cell_status ? cell_status + i*ns : local.data());
+            }
+        });
+        for (auto &s : row_first)
+            if (s != status::ok) return s;
+        return status::ok;
+    }
+    catch (...) {
+        // Couldn't allocate or start threads
+        std::fill(pvals, pvals + nb*ns, NAN);
+        if (cell_status) std::fill(cell_status, cell_status + nb*ns, status::internal_error);
+        return status::internal_error;
+    }
+}
+
+// See description in fracdist/pvalue.hpp
+std::vector<double> pvalue_rank_sequence(const std::vector<double> &test_stats, const double &b, const bool &constant) {
+    return pvalue_rank_sequence_advanced(test_stats, b, constant, interpolation::JGMMON14, 9);
+}
+
+// See description in fracdist/pvalue.hpp
+std::vector<double> pvalue_rank_sequence_advanced(const std::vector<double> &test_stats, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points) {
+    for (auto &t : test_stats) {
+        if (!(t >= 0))
+            throw std::out_of_range(ostringstream() << "test stat (" << t << ") invalid: cannot be negative");
+    }
+
+    // The b weights are the same for every q, so calculate them just once and apply them to each q's
+    // rows exactly as quantiles() does.  (Spline and chebyshev quantiles aren't calculated from
+    // weights, so for them quantiles() is called for each q.)
+    const size_t n = test_stats.size();
+    std::vector<std::array<double, p_length>> quant(n);
+    if (interp_mode == interpolation::spline || interp_mode == interpolation::chebyshev) {
+        for (size_t k = 0; k < n; k++)
+            quant[k] = quantiles(k+1, b, constant, interp_mode);
+    }
+    else {
+        const bweights bw = interpolation_weights(b, interp_mode);
+        for (size_t k = 0; k < n; k++)
+            apply_weights(bw, table(k+1, constant), quant[k]);
+    }
+
+    std::vector<double> result(n);
+    for (size_t k = 0; k < n; k++) {
+        const double &t = test_stats[k];
+        if (t == 0) result[k] = 1.0;
+        else if (std::isinf(t)) result[k] = 0.0;
+        else if (approximate_pvalue(t, quant[k], k+1, approx_points, result[k]) != status::ok)
+            detail::throw_approx_points(approx_points);
+    }
+    return result;
 }
 
 }
@@ -1,5 +1,8 @@
 #pragma once
 #include <fracdist/common.hpp>
+#include <fracdist/quadratic.hpp>
+#include <stdexcept>
+#include <vector>
 
 /** @file fracdist/pvalue.hpp
  * @brief Header file for fracdist's interface to finding a pvalue from a test statistic.
@@ -20,6 +23,19 @@ namespace fracdist {
  */
 double pvalue(const double &test_stat, const unsigned int &q, const double &b, const bool &constant);
 
+#if FRACDIST_RESPONSE_SURFACE
+/** Like pvalue(), but calculates a finite-sample p-value for a sample of size `T` using the
+ * response surface data.  Exactly equivalent to calling:
+ *
+ *     pvalue_advanced(test_stat, q, b, constant, interpolation::JGMMON14, 9, T)
+ *
+ * \throws std::out_of_range for an invalid b or q value
+ * \throws std::runtime_error if `T > 0` and there is no response surface data for `q` (that is, for
+ * a `q` larger than `fracdist::q_length`, loaded from an external table)
+ */
+double pvalue(const double &test_stat, const unsigned int &q, const double &b, const bool &constant, const unsigned int &T);
+#endif
+
 /** Like pvalue(), but requires an interpolation mode and number of P-value approximation
  * points.  `approx_points` must be at least 3 (and depending on the test_stat and parameters, might
  * need to be at least 5).
@@ -39,4 +55,214 @@ double pvalue(const double &test_stat, const unsigned int &q, const double &b, c
 double pvalue_advanced(const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
         const interpolation &interp_mode, const unsigned int &approx_points);
 
+/** Like pvalue_advanced(), but uses finite-sample quantiles for a sample of size `T` (see
+ * quantiles()).  A `T` of 0 gives the asymptotic p-value.
+ *
+ * \throws std::out_of_range for an invalid b, q value
+ * \throws std::runtime_error if approx_points is too small, or if `T > 0` and fracdist was built
+ * without response surface data.
+ */
+double pvalue_advanced(const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T);
+
+/** Calculates p-values for a sequence of test statistics that share the same b value and constant
+ * setting but have \f$q = 1, 2, \ldots, n\f$ (where \f$n\f$ is `test_stats.size()`): the p-value of
+ * `test_stats[k]` is calculated using \f$q = k+1\f$.  This is the pattern that arises in
+ * Johansen-style determination of the cointegration rank, where the test of rank \f$r\f$ in a
+ * system of \f$p\f$ variables uses \f$q = p - r\f$.
+ *
+ * The result is identical to calling pvalue() for each statistic, but is faster: the b
+ * interpolation weights are calculated just once and applied to each q value's table.  Statistics for \f$q > q_{length}\f$ are supported if tables for those q
+ * values are available (see fracdist/tables.hpp).
+ *
+ * \throws std::out_of_range for an invalid b value, a negative test statistic, or a q value without
+ * available quantile data.
+ */
+std::vector<double> pvalue_rank_sequence(const std::vector<double> &test_stats, const double &b, const bool &constant);
+
+/** Like pvalue_rank_sequence(), but requires an interpolation mode and number of P-value approximation
+ * points, as in pvalue_advanced(), to whose results it is identical.  (interpolation::spline and
+ * interpolation::chebyshev don't interpolate with weights, so for them this simply calls
+ * quantiles() for each q value.)
+ *
+ * \sa pvalue_rank_sequence()
+ *
+ * \throws std::out_of_range for an invalid b value, a negative test statistic, or a q value without
+ * available quantile data.
+ * \throws std::runtime_error if approx_points is too small to perform the required quadratic
+ * approximation.
+ */
+std::vector<double> pvalue_rank_sequence_advanced(const std::vector<double> &test_stats, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points);
+
+/** A p-value and its derivatives, as returned by pvalue_with_derivatives(). */
+struct pvalue_derivatives {
+    /// The p-value
+    double pvalue;
+    /// The derivative of the p-value with respect to the test statistic (i.e. minus the density of
+    /// the test statistic's distribution at the statistic)
+    double dstat;
+    /// The derivative of the p-value with respect to b
+    double db;
+};
+
+/** Calculates the p-value (exactly as pvalue_advanced() does) along with its derivatives with
+ * respect to the test statistic and to b, in closed form.  The p-value is
+ * \f$1 - F_{\chi^2}(f(s))\f$, where \f$f\f$ is the local quadratic fitted to the
+ * inverse chi-squared values at the nearby quantiles, so its derivative with respect to the
+ * statistic \f$s\f$ is \f$-\phi_{\chi^2}(f(s)) f'(s)\f$.  The derivative with respect to b follows
+ * from the derivatives of the quantiles (see quantile_derivatives()) and of the local quadratic's
+ * fitted value with respect to each quantile.
+ *
+ * This costs little more than a single pvalue_advanced() call, which makes it considerably cheaper
+ * (and more accurate) than numerical differentiation.  The derivatives are those of the smooth
+ * pieces of the approximation: where the p-value is 0 or 1 (including statistics beyond the range
+ * the approximation covers), both derivatives are 0, and changes in which quantiles are used in the
+ * local regression are ignored.
+ *
+ * \throws std::out_of_range for an invalid b, q value or a negative test statistic
+ * \throws std::runtime_error if approx_points is too small, or if `T > 0` and fracdist was built
+ * without response surface data.
+ */
+pvalue_derivatives pvalue_with_derivatives(const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode = interpolation::JGMMON14, const unsigned int &approx_points = 9, const unsigned int &T = 0);
+
+/** Non-throwing version of pvalue_advanced().  On success, stores the p-value in `pval` and returns
+ * status::ok.  Where pvalue_advanced() would throw, this instead sets `pval` to NaN and returns a
+ * status code describing the problem; no error message is constructed (see status_message()).  A
+ * NaN test statistic gives status::invalid_test_stat.
+ */
+status try_pvalue(double &pval, const double &test_stat, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) noexcept;
+
+/** Calculates p-values for `n` test statistics sharing the same q, b, constant, interpolation, and
+ * sample size values, storing them in `pvals[0]` through `pvals[n-1]`, without throwing.  The
+ * parameters are checked (and the quantiles interpolated) just once.
+ *
+ * A test statistic that can't be evaluated (or all of them, if the parameters are invalid) gets a
+ * NaN p-value; if `row_status` is non-null, the status of each statistic is stored in
+ * `row_status[0]` through `row_status[n-1]`.  Returns status::ok if every p-value was calculated,
+ * otherwise the status of the first failure.
+ */
+status pvalue_batch(const double *test_stats, double *pvals, const size_t &n, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T, status *row_status = nullptr) noexcept;
+
+/** Calculates the p-values of every combination of the `nb` b values `b_grid[0]` through
+ * `b_grid[nb-1]` and the `ns` test statistics `test_stats[0]` through `test_stats[ns-1]` (as for
+ * plotting a p-value surface), storing them row-major in `pvals`: the p-value of `test_stats[j]` at
+ * `b_grid[i]` goes in `pvals[i*ns + j]`.  The results are identical to calling pvalue_batch() for
+ * each b value, but a large grid is much faster:
+ * - the rows are divided among `threads` threads (0 for one per hardware thread), and the quantiles
+ *   are interpolated once per row;
+ * - the statistics are sorted once, then visited in increasing order within each row, so that the
+ *   closest quantile is found by advancing a cursor rather than by searching all of the quantiles,
+ *   and the local regression is refitted only when the quantiles it uses change.
+ *
+ * Statuses are as for pvalue_batch(), with `cell_status` (if non-null) receiving the status of each
+ * p-value in the same layout as `pvals`; an invalid b value gives a row of NaN p-values.  Returns
+ * status::ok if every p-value was calculated, otherwise the status of the first failure in
+ * row-major order.
+ */
+status pvalue_surface(const double *b_grid, const size_t &nb, const double *test_stats, const size_t &ns, double *pvals,
+        const unsigned int &q, const bool &constant, const interpolation &interp_mode = interpolation::JGMMON14,
+        const unsigned int &approx_points = 9, const unsigned int &T = 0, const unsigned int &threads = 0,
+        status *cell_status = nullptr) noexcept;
+
+/// @cond INTERNAL
+namespace detail {
+
+/* Handles the trivial test statistic cases: throws for a negative statistic, and returns true (and
+ * sets `pval`) for a statistic of 0 or infinity.  Returns false if the p-value needs to be
+ * calculated.
+ */
+inline bool pvalue_trivial(const double &test_stat, double &pval) {
+    if (!(test_stat >= 0))
+        throw std::out_of_range(ostringstream() << "test stat (" << test_stat << ") invalid: cannot be negative");
+    // The p-values for test stats of 0 or infinity are trivial: 1 or 0.
+    if (test_stat == 0) { pval = 1.0; return true; }
+    if (std::isinf(test_stat)) { pval = 0.0; return true; }
+    return false;
+}
+
+/* The row loop of pvalue_batch(): calculates p-values for `n` test statistics from the interpolated
+ * quantiles `quant`.  `params` is the result of checking the distribution parameters; if it isn't
+ * status::ok (in which case `quant` may be null) it becomes the status of every statistic that isn't
+ * invalid or trivial.
+ */
+status pvalue_rows(const std::array<double, p_length> *quant, const status &params, const unsigned int &q,
+        const unsigned int &approx_points, const double *test_stats, double *pvals, const size_t &n, status *row_status) noexcept;
+
+/* Calculates the p-value for a (positive, finite) test statistic from an already-interpolated set
+ * of quantiles using min(approx_points, MaxPoints) points, storing it in `pval`.  When the full
+ * MaxPoints points are available (i.e. away from the ends of the data) the regression size is a
+ * compile-time constant.  Returns status::invalid_approx_points (without setting `pval`) if there
+ * are fewer than 3 points available.
+ */
+template <size_t MaxPoints>
+status pvalue_from_quantiles(const double &test_stat, const std::array<double, p_length> &quant,
+        const unsigned int &q, const unsigned int &approx_points, double &pval) {
+    // If asked for the p-value for a value less than half the smallest quantile we have, or more
+    // than double the largest quantile we have, just give back 0 or 1.
+    if (test_stat < 0.5*quant.front()) { pval = 1.0; return status::ok; }
+    if (test_stat > 2*quant.back()) { pval = 0.0; return status::ok; }
+
+    // Otherwise we need to do some more work.
+
+    // First find the location with a quantile closest to the requested one
+    size_t min_at = find_closest(test_stat, quant);
+
+    // Now figure out a set of `approx_points' consecutive points centered on the closest value
+    auto ap = find_bracket(min_at, p_length-1, std::min<size_t>(approx_points, MaxPoints));
+
+    if (ap.second - ap.first < 2)
+        return status::invalid_approx_points;
+
+    // Now we're going to run the regression:
+    //
+    //     chisqinv_i = \beta_1 + \beta_2 quantile_i + \beta_3 quantile_i^2
+    //
+    // where chisqinv_i is the inverse cdf at p=pvalue[i] of a chi-squared distribution with q^2 df
+    //
+    // The fitted value then gives us a fitted chi-squared value for which we can get a pvalue.
+    const size_t n = ap.second - ap.first + 1;
+    std::array<double, MaxPoints> y;
+    for (size_t i = 0; i < n; i++)
+        y[i] = chisq_inv_p_i(ap.first + i, q);
+
+    const double fitted = n == MaxPoints
+        ? quadratic_fit<MaxPoints>(&quant[ap.first], nullptr).fitted(test_stat, y.data())
+        : quadratic_fit<MaxPoints>(&quant[ap.first], nullptr, n).fitted(test_stat, y.data());
+
+    // A negative isn't valid, so if we predicted one anyway, truncate it at 0 (which corresponds to
+    // a pvalue of 1).
+    pval = fitted < 0 ? 1.0 : chisq_cdf_upper(q, fitted);
+    return status::ok;
+}
+
+}
+/// @endcond
+
+/** Like pvalue_advanced(), but with the interpolation mode and number of approximation points fixed
+ * at compile time, for example:
+ *
+ *     double p = fracdist::pvalue<fracdist::interpolation::JGMMON14, 9>(test_stat, q, b, constant);
+ *
+ * is equivalent to `pvalue(test_stat, q, b, constant)`, but the p-value approximation is inlined
+ * into the caller and specialized for the given number of points.  `T` optionally gives the
+ * sample size, as in the `T` version of pvalue_advanced().
+ *
+ * \throws std::out_of_range for an invalid b, q value
+ * \throws std::runtime_error if ApproxPoints is too small for the test statistic (see
+ * pvalue_advanced()), or if `T > 0` and fracdist was built without response surface data.
+ */
+template <interpolation Interp, unsigned int ApproxPoints>
+double pvalue(const double &test_stat, const unsigned int &q, const double &b, const bool &constant, const unsigned int &T = 0) {
+    static_assert(ApproxPoints >= 3, "ApproxPoints must be at least 3");
+    double pval;
+    if (detail::pvalue_trivial(test_stat, pval)) return pval;
+    if (detail::pvalue_from_quantiles<ApproxPoints>(test_stat, quantiles<Interp>(q, b, constant, T), q, ApproxPoints, pval) != status::ok)
+        detail::throw_approx_points(ApproxPoints);
+    return pval;
+}
+
 };
@@ -0,0 +1,197 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+/** @file fracdist/quadratic.hpp
+ * @brief Allocation-free least squares fitting of the local quadratic regressions used to
+ * interpolate the quantile tables.
+ */
+
+namespace fracdist {
+
+/** Weighted least squares fit of a quadratic in one variable, for at most `MaxRows` observations.
+ *
+ * The regressors are the rows \f$w_i (1, z_i, z_i^2)\f$; the class calculates a Householder QR
+ * decomposition of this \f$n \times 3\f$ matrix (in fixed-size storage, so no heap allocations are
+ * performed) which can then be used to obtain fitted values at \f$(1, x, x^2)\f$ for any
+ * regressand, or the weights on the regressand values that yield the fitted value.
+ *
+ * If the regressor matrix is rank deficient (e.g. because of repeated \f$z\f$ values), the
+ * coefficients of the dependent columns are set to 0.
+ */
+template <size_t MaxRows>
+class quadratic_fit {
+    public:
+        static_assert(MaxRows >= 3, "quadratic_fit requires at least 3 rows");
+
+        /** Decomposes the regressor matrix with rows \f$w_i (1, z_i, z_i^2)\f$ for i from 0 to n-1.
+         * If `w` is nullptr, all row weights are 1.
+         *
+         * \throws std::out_of_range if `n` is less than 3 or larger than MaxRows.
+         */
+        quadratic_fit(const double *z, const double *w, const size_t &n) : n_(n) { decompose(z, w); }
+
+        /** Decomposes the regressor matrix using exactly MaxRows observations.  Since the number of
+         * rows is then a compile-time constant the decomposition and fitting loops can be unrolled.
+         */
+        quadratic_fit(const double *z, const double *w) : n_(MaxRows) { decompose(z, w); }
+
+    private:
+        void decompose(const double *z, const double *w) {
+            const size_t n = n_;
+            if (n < 3 || n > MaxRows)
+                throw std::out_of_range("quadratic_fit: invalid number of observations");
+            for (size_t i = 0; i < n; i++) {
+                const double wi = w ? w[i] : 1.0;
+                a_[0][i] = wi;
+                a_[1][i] = wi * z[i];
+                a_[2][i] = wi * z[i] * z[i];
+            }
+
+            for (size_t k = 0; k < 3; k++) {
+                // Householder reflection H_k = I - beta_k v v' zeroing column k below the diagonal;
+                // v is stored in place of the column.
+                double norm2 = 0;
+                for (size_t i = k; i < n; i++) norm2 += a_[k][i] * a_[k][i];
+                const double norm = std::sqrt(norm2);
+                if (norm == 0) {
+                    beta_[k] = 0;
+                    rdiag_[k] = 0;
+                    continue;
+                }
+                const double alpha = a_[k][k] > 0 ? -norm : norm;
+                a_[k][k] -= alpha;
+                // With c the original a_kk, v'v = (c - alpha)^2 + norm^2 - c^2 = 2 (norm^2 - alpha c)
+                beta_[k] = 1.0 / (norm2 - alpha * (a_[k][k] + alpha));
+                rdiag_[k] = alpha;
+                for (size_t j = k+1; j < 3; j++) {
+                    double s = 0;
+                    for (size_t i = k; i < n; i++) s += a_[k][i] * a_[j][i];
+                    s *= beta_[k];
+                    for (size_t i = k; i < n; i++) a_[j][i] -= s * a_[k][i];
+                }
+            }
+
+            const double tol = 1e-13 * n * std::fabs(rdiag_[0]);
+            for (size_t k = 0; k < 3; k++)
+                full_[k] = std::fabs(rdiag_[k]) > tol;
+        }
+
+    public:
+
+        /** Returns the fitted value at \f$(1, x, x^2)\f$ of the regression of \f$w_i y_i\f$ on the
+         * regressors.
+         */
+        double fitted(const double &x, const double *y, const double *w = nullptr) const {
+            double b[3];
+            coefficients(y, b, w);
+            return b[0] + x * (b[1] + x * b[2]);
+        }
+
+        /** Calculates the coefficients \f$(\beta_0, \beta_1, \beta_2)\f$ (stored in `beta`) of the
+         * regression of \f$w_i y_i\f$ on the regressors.
+         */
+        void coefficients(const double *y, double *beta, const double *w = nullptr) const {
+            std::array<double, MaxRows> t;
+            for (size_t i = 0; i < n_; i++) t[i] = w ? w[i] * y[i] : y[i];
+            // t = Q'y
+            for (size_t k = 0; k < 3; k++) {
+                if (beta_[k] == 0) continue;
+                double s = 0;
+                for (size_t i = k; i < n_; i++) s += a_[k][i] * t[i];
+                s *= beta_[k];
+                for (size_t i = k; i < n_; i++) t[i] -= s * a_[k][i];
+            }
+            // Back-substitute R beta = t
+            back_substitute(t.data(), beta);
+        }
+
+        /** Calculates weights \f$\omega_i\f$ (stored in `out[0]` through `out[n-1]`) such that the
+         * fitted value at \f$(1, x, x^2)\f$ of the regression of \f$w_i y_i\f$ on the regressors
+         * is \f$\sum_i \omega_i y_i\f$ for any \f$y\f$.  (The row weights \f$w_i\f$ are *not*
+         * included in \f$\omega_i\f$).
+         */
+        void fitted_weights(const double &x, double *out) const {
+            const double c[3] = { 1.0, x, x*x };
+            linear_weights(c, out);
+        }
+
+        /** Like fitted_weights(), but the weights give the slope \f$\beta_1 + 2 \beta_2 x\f$ of the
+         * fitted quadratic at `x`.
+         */
+        void slope_weights(const double &x, double *out) const {
+            const double c[3] = { 0.0, 1.0, 2*x };
+            linear_weights(c, out);
+        }
+
+        /** For an unweighted fit (i.e. one decomposed with `w` equal to nullptr), calculates the
+         * derivatives of the fitted value at `x` of the regression of `y` with respect to each
+         * regressor value \f$z_i\f$, storing them in `out[0]` through `out[n-1]`.  `z` and `y` must
+         * be the values the fit was decomposed and evaluated with.
+         *
+         * With \f$G = X'X\f$, \f$x_0 = (1, x, x^2)'\f$, and residuals \f$r_i\f$, this is
+         * \f$x_0' G^{-1} (d_i r_i - x_i d_i' \beta)\f$, where \f$d_i = (0, 1, 2z_i)'\f$ is the
+         * derivative of the regressor row \f$x_i\f$.
+         */
+        void fitted_gradient(const double &x, const double *z, const double *y, double *out) const {
+            double beta[3];
+            coefficients(y, beta);
+            // u = G^{-1} x_0 = R^{-1} R^{-T} x_0
+            const double x0[3] = { 1.0, x, x*x };
+            double v[3], u[3];
+            forward_substitute(x0, v);
+            back_substitute(v, u);
+            for (size_t i = 0; i < n_; i++) {
+                const double r = y[i] - (beta[0] + z[i] * (beta[1] + z[i] * beta[2]));
+                const double xi_u = u[0] + z[i] * (u[1] + z[i] * u[2]);
+                out[i] = (u[1] + 2 * z[i] * u[2]) * r - xi_u * (beta[1] + 2 * z[i] * beta[2]);
+            }
+        }
+
+    private:
+        // Solves R'v = c
+        void forward_substitute(const double *c, double *v) const {
+            for (size_t k = 0; k < 3; k++) {
+                if (!full_[k]) { v[k] = 0; continue; }
+                double s = c[k];
+                for (size_t j = 0; j < k; j++) s -= a_[k][j] * v[j];
+                v[k] = s / rdiag_[k];
+            }
+        }
+
+        // Solves R v = t (using the first 3 elements of t)
+        void back_substitute(const double *t, double *v) const {
+            for (size_t k = 3; k-- > 0; ) {
+                if (!full_[k]) { v[k] = 0; continue; }
+                double s = t[k];
+                for (size_t j = k+1; j < 3; j++) s -= a_[j][k] * v[j];
+                v[k] = s / rdiag_[k];
+            }
+        }
+
+        // Calculates the weights on the regressand values giving c'beta
+        void linear_weights(const double *c, double *out) const {
+            // omega = Q R^{-T} c: first forward-substitute R'z = c...
+            double z[3];
+            forward_substitute(c, z);
+            // ... then apply Q = H_0 H_1 H_2 to (z, 0, ..., 0)
+            for (size_t i = 0; i < n_; i++) out[i] = i < 3 ? z[i] : 0.0;
+            for (size_t k = 3; k-- > 0; ) {
+                if (beta_[k] == 0) continue;
+                double s = 0;
+                for (size_t i = k; i < n_; i++) s += a_[k][i] * out[i];
+                s *= beta_[k];
+                for (size_t i = k; i < n_; i++) out[i] -= s * a_[k][i];
+            }
+        }
+
+        const size_t n_;
+        // Column-major: R above the diagonal, Householder vectors on and below it
+        std::array<double, MaxRows> a_[3];
+        double rdiag_[3], beta_[3];
+        bool full_[3];
+};
+
+}
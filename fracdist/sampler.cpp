@@ -0,0 +1,255 @@
+#include <fracdist/sampler.hpp>
+#include <fracdist/monotone.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace fracdist {
+
+// The most cells a tabulated p interval is divided into; intervals that would need more (which
+// only happens where the inverse cdf is truncated at 0) use this many and exceed the tolerance.
+static constexpr size_t sampler_max_cells = 64;
+
+// The number of p values processed at a time by inverse_cdf()
+static constexpr size_t sampler_block = 256;
+
+// Returns the inverse chi-squared cdf at each of the tabulated p values
+static std::array<double, p_length> chisq_at_pvalues(const unsigned int &q) {
+    std::array<double, p_length> chisq;
+    for (size_t i = 0; i < p_length; i++)
+        chisq[i] = chisq_inv_p_i(i, q);
+    return chisq;
+}
+
+struct sampler::table {
+    table(const distribution &dist);
+
+    // The exact inverse cdf at p, for p in [0, 1]
+    double exact(const double &p) const;
+
+    // Evaluates the cubic of cell c at position t in [0, 1] within the cell, truncated at 0
+    double cell(const size_t &c, const double &t) const {
+        const double v = c0[c] + t * (c1[c] + t * (c2[c] + t * c3[c]));
+        return v < 0 ? 0.0 : v;
+    }
+
+    // Evaluates the table at p within tabulated p interval k
+    double interval(const size_t &k, const double &p) const {
+        double t = (p - pvalues[k]) * inv_width[k];
+        const double c = std::min(std::max(std::floor(t), 0.0), cells[k] - 1);
+        return cell(first[k] + (size_t) c, t - c);
+    }
+
+    // Evaluates the inverse cdf at p values outside the evenly spaced run
+    double outside_run(const double &p) const;
+
+    // Evaluates the table for the n (at most sampler_block) p values in `p`, storing the results in
+    // `x`.  Only the results for p values in [run_lo, run_hi) are meaningful; the others must be
+    // replaced with outside_run() values.
+    void run_rows(const double *p, double *x, const size_t &n) const;
+
+    unsigned int q;
+    // The monotone map from inverse chi-squared cdf values to quantiles
+    monotone_cubic<p_length> quantile_map;
+
+    // For each tabulated p interval k (from pvalues[k] to pvalues[k+1]), the index of its first
+    // cell, its number of cells (as a double, for the clamping in interval()), and its cells per
+    // unit of p.
+    std::array<int, p_length-1> first;
+    std::array<double, p_length-1> cells, inv_width;
+
+    // The cubic coefficients of each cell, in the position within the cell
+    std::vector<double> c0, c1, c2, c3;
+
+    // The longest run of evenly spaced tabulated p values, pvalues[run_first] = run_lo through
+    // pvalues[run_last] = run_hi, and the reciprocal of their spacing
+    size_t run_first, run_last;
+    double run_lo, run_hi, run_inv_step;
+};
+
+sampler::table::table(const distribution &dist)
+    : q(dist.q()), quantile_map(chisq_at_pvalues(dist.q()).data(), dist.quantiles().data())
+{
+    const double tolerance = sampler_tolerance * std::fabs(dist.quantiles()[p_length / 2]);
+
+    std::vector<double> y;
+    for (size_t k = 0; k < p_length-1; k++) {
+        const double lo = pvalues[k], width = pvalues[k+1] - lo;
+        // Double the number of cells until the cubics, each through four evenly spaced points of
+        // its cell, are within the tolerance half way between those points.
+        size_t n = 1;
+        for (;; n *= 2) {
+            y.resize(3*n + 1);
+            for (size_t j = 0; j < 3*n; j++)
+                y[j] = exact(lo + width * j / (3*n));
+            y[3*n] = exact(pvalues[k+1]);
+
+            bool ok = true;
+            for (size_t c = 0; c < n && ok; c++) {
+                for (const double s : {0.5, 1.5, 2.5}) {
+                    const double *yc = &y[3*c];
+                    // The Lagrange cubic through (0, yc[0]), ..., (3, yc[3]) at s
+                    const double v = -yc[0] * (s-1)*(s-2)*(s-3) / 6 + yc[1] * s*(s-2)*(s-3) / 2
+                        - yc[2] * s*(s-1)*(s-3) / 2 + yc[3] * s*(s-1)*(s-2) / 6;
+                    if (!(std::fabs(v - exact(lo + width * (3*c + s) / (3*n))) <= tolerance)) { ok = false; break; }
+                }
+            }
+            if (ok || n == sampler_max_cells) break;
+        }
+
+        first[k] = (int) c0.size();
+        cells[k] = n;
+        inv_width[k] = n / width;
+        for (size_t c = 0; c < n; c++) {
+            // Convert the forward differences of the four points into monomial coefficients in
+            // s = 3t, then scale to t, the position within the cell.
+            const double *yc = &y[3*c];
+            const double d1 = yc[1] - yc[0], d2 = yc[2] - 2*yc[1] + yc[0], d3 = yc[3] - 3*yc[2] + 3*yc[1] - yc[0];
+            c0.push_back(yc[0]);
+            c1.push_back(3 * (d1 - d2/2 + d3/3));
+            c2.push_back(9 * (d2 - d3) / 2);
+            c3.push_back(27 * d3 / 6);
+        }
+    }
+
+    // Find the longest run of evenly spaced p values
+    run_first = run_last = 0;
+    for (size_t i = 0; i < p_length-1; ) {
+        const double step = pvalues[i+1] - pvalues[i];
+        size_t j = i + 1;
+        while (j < p_length-1 && std::fabs(pvalues[j+1] - pvalues[j] - step) <= 1e-9 * step) j++;
+        if (j - i > run_last - run_first) { run_first = i; run_last = j; }
+        i = j;
+    }
+    run_lo = pvalues[run_first];
+    run_hi = pvalues[run_last];
+    run_inv_step = (run_last - run_first) / (run_hi - run_lo);
+}
+
+double sampler::table::exact(const double &p) const {
+    if (p <= 0) return 0.0;
+    if (p >= 1) return INFINITY;
+    const double x = quantile_map(chisq_inv(q, p));
+    return x < 0 ? 0.0 : x;
+}
+
+double sampler::table::outside_run(const double &p) const {
+    if (!(p >= 0 && p <= 1)) return NAN;
+    if (p < pvalues.front() || p >= pvalues.back()) return exact(p);
+    return interval(std::upper_bound(pvalues.begin(), pvalues.end(), p) - pvalues.begin() - 1, p);
+}
+
+FRACDIST_KERNEL void sampler::table::run_rows(const double *p, double *x, const size_t &n) const {
+    // Local copies of everything the loop reads, and a local result array, so that the compiler
+    // knows nothing is aliased and can vectorize the loop (with gathers for the table lookups).
+    const double lo = run_lo, hi = run_hi, inv_step = run_inv_step, last_k = run_last - run_first - 1;
+    const double *start = pvalues.data() + run_first, *iw = inv_width.data() + run_first, *nc = cells.data() + run_first;
+    const int *fc = first.data() + run_first;
+    const double *a0 = c0.data(), *a1 = c1.data(), *a2 = c2.data(), *a3 = c3.data();
+    std::array<double, sampler_block> result;
+    for (size_t i = 0; i < n; i++) {
+        // Values outside the run (including NaNs) are replaced with run_lo so that every lookup
+        // stays in bounds; their results are overwritten afterwards.
+        const double pv = p[i];
+        const double pi = (pv >= lo) & (pv < hi) ? pv : lo;
+        const int k = (int) std::min(std::floor((pi - lo) * inv_step), last_k);
+        double t = (pi - start[k]) * iw[k];
+        const double c = std::min(std::max(std::floor(t), 0.0), nc[k] - 1);
+        const int j = fc[k] + (int) c;
+        t -= c;
+        const double v = a0[j] + t * (a1[j] + t * (a2[j] + t * a3[j]));
+        result[i] = v < 0 ? 0.0 : v;
+    }
+    std::copy(result.begin(), result.begin() + n, x);
+}
+
+// See description in fracdist/sampler.hpp
+sampler::sampler(const distribution &dist, const uint64_t &seed)
+    : dist_(dist), table_(std::make_shared<table>(dist))
+{
+    this->seed(seed);
+}
+
+// See description in fracdist/sampler.hpp
+double sampler::operator()() {
+    return inverse_cdf(uniform());
+}
+
+// See description in fracdist/sampler.hpp
+void sampler::fill(double *out, const size_t &n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = uniform();
+    inverse_cdf(out, out, n);
+}
+
+// See description in fracdist/sampler.hpp
+double sampler::inverse_cdf(const double &p) const {
+    if (p >= table_->run_lo && p < table_->run_hi) {
+        double x;
+        table_->run_rows(&p, &x, 1);
+        return x;
+    }
+    return table_->outside_run(p);
+}
+
+// See description in fracdist/sampler.hpp
+void sampler::inverse_cdf(const double *p, double *x, const size_t &n) const {
+    const table &tab = *table_;
+    std::array<double, sampler_block> block;
+    for (size_t start = 0; start < n; start += sampler_block) {
+        const size_t m = std::min(sampler_block, n - start);
+        // Copy the p values first, since x may be the same array
+        std::copy(p + start, p + start + m, block.begin());
+        tab.run_rows(block.data(), x + start, m);
+        for (size_t i = 0; i < m; i++) {
+            if (!(block[i] >= tab.run_lo && block[i] < tab.run_hi))
+                x[start + i] = tab.outside_run(block[i]);
+        }
+    }
+}
+
+// See description in fracdist/sampler.hpp
+void sampler::seed(const uint64_t &seed) {
+    uint64_t sm = seed;
+    for (uint64_t &s : state_) {
+        uint64_t z = (sm += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        s = z ^ (z >> 31);
+    }
+}
+
+// Advances the xoshiro256 state by one step; returns the xoshiro256+ output
+static inline uint64_t xoshiro_next(std::array<uint64_t, 4> &s) {
+    const uint64_t result = s[0] + s[3];
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
+
+// See description in fracdist/sampler.hpp
+void sampler::jump() {
+    static const uint64_t jump_poly[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    std::array<uint64_t, 4> s = {{0, 0, 0, 0}};
+    for (const uint64_t &j : jump_poly) {
+        for (int b = 0; b < 64; b++) {
+            if (j & (uint64_t(1) << b))
+                for (size_t i = 0; i < 4; i++) s[i] ^= state_[i];
+            xoshiro_next(state_);
+        }
+    }
+    state_ = s;
+}
+
+double sampler::uniform() {
+    // The top 53 bits (the low bits of xoshiro256+ are weaker), offset to the middle of their
+    // interval so that 0 is never returned
+    return ((xoshiro_next(state_) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <fracdist/distribution.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/** @file fracdist/sampler.hpp
+ * @brief Fast generation of random variates from a fractional distribution.
+ */
+
+namespace fracdist {
+
+/** The maximum absolute error of sampler::inverse_cdf()'s piecewise cubic table, as a fraction of
+ * the distribution's median, for p values within the tabulated range.
+ */
+constexpr double sampler_tolerance = 1e-7;
+
+/** Generates random variates from a fractional distribution by inversion, using a table built once
+ * from the distribution's quantiles and a xoshiro256+ uniform generator (seeded with splitmix64).
+ *
+ * The inverse cdf used is that of pvalue_method::monotone_map: between the tabulated p values
+ * (fracdist::pvalues) it is the monotone piecewise cubic interpolant (see monotone_cubic) through
+ * the points (inverse chi-squared cdf, quantile), evaluated at the inverse chi-squared cdf of \f$p\f$,
+ * so that the distribution is chi-squared-smoothed between the quantiles and its tails extend
+ * linearly on the chi-squared scale (truncated at 0) beyond them, like the quadratic chi-squared
+ * regression of critical_advanced().  Unlike critical_advanced(), whose regression windows shift as
+ * the level changes, this inverse cdf is continuous and (for increasing quantiles) monotone.
+ *
+ * To avoid an inverse chi-squared calculation for every draw, each interval between tabulated p
+ * values is divided into equal cells, as many as needed for a cubic in \f$p\f$ on each cell to be
+ * within sampler_tolerance of the exact value.  A draw within the evenly spaced middle of the
+ * tabulated p values (which covers 98% of the probability) then needs no search, and whole blocks
+ * of them are evaluated in a vectorizable loop; draws further out need a short binary search, and
+ * only those beyond the tabulated p values (0.02% of them) evaluate the exact inverse.
+ *
+ * The table is shared by copies of a sampler, while each copy has its own generator state, so
+ * independent streams for several threads can be made by copying a sampler and calling jump()
+ * a different number of times on each copy.  A sampler must not be used by more than one thread at
+ * a time, but its const methods may be.
+ */
+class sampler {
+    public:
+        /** Builds the inverse cdf table for the given distribution (whose parameters other than q
+         * and the quantiles are irrelevant) and seeds the generator with `seed`.
+         */
+        explicit sampler(const distribution &dist, const uint64_t &seed = 0);
+
+        /** Returns a single random variate. */
+        double operator()();
+
+        /** Stores `n` random variates in `out[0]` through `out[n-1]`.  Equivalent to (but much faster
+         * than) calling operator() `n` times.
+         */
+        void fill(double *out, const size_t &n);
+
+        /** Returns the value with cdf `p`, that is, the variate that a uniform draw of `p` becomes.
+         * `p` values of 0 and 1 give 0 and infinity; a `p` outside \f$[0, 1]\f$ (or NaN) gives NaN.
+         */
+        double inverse_cdf(const double &p) const;
+
+        /** Calculates the inverse cdf of `p[0]` through `p[n-1]`, storing them in `x` (which may be the
+         * same array as `p`).
+         */
+        void inverse_cdf(const double *p, double *x, const size_t &n) const;
+
+        /** Reseeds the generator: the generator state is filled from a splitmix64 generator seeded
+         * with `seed`, so that any seed (including 0) gives a usable state.
+         */
+        void seed(const uint64_t &seed);
+
+        /** Advances the generator by \f$2^{128}\f$ draws, as if that many draws had been made.  Calling
+         * jump() 0, 1, 2, ... times on copies of a sampler gives non-overlapping streams.
+         */
+        void jump();
+
+        /// The distribution the sampler draws from
+        const distribution& dist() const { return dist_; }
+
+    private:
+        struct table;
+
+        // Returns a uniform draw in (0, 1) with 53 random bits
+        double uniform();
+
+        distribution dist_;
+        std::shared_ptr<const table> table_;
+        std::array<uint64_t, 4> state_;
+};
+
+}
@@ -0,0 +1,252 @@
+#include <fracdist/solve.hpp>
+#include <fracdist/pvalue.hpp>
+#include <fracdist/critical.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace fracdist {
+
+// Finds a root of `f` (which returns the function value at x and stores its derivative in `deriv`)
+// in [lo, hi], where flo = f(lo) and fhi = f(hi) have opposite signs, starting at x in the bracket.
+// Newton steps are taken unless they would leave the (shrinking) bracket or aren't converging
+// quickly enough, in which case the bracket is bisected instead.
+template <typename F>
+static double newton_bracketed(const F &f, double lo, double hi, double flo, double x) {
+    double step = hi - lo, prev_step = step;
+    for (int iter = 0; iter < 100; iter++) {
+        double deriv;
+        const double fx = f(x, deriv);
+        if (fx == 0) return x;
+        if ((fx < 0) == (flo < 0)) { lo = x; flo = fx; }
+        else hi = x;
+
+        double next = x - fx / deriv;
+        if (!(next > lo && next < hi) || std::fabs(2*fx) > std::fabs(prev_step * deriv)) {
+            next = 0.5 * (lo + hi);
+            prev_step = step = hi - lo;
+        }
+        else {
+            prev_step = step;
+            step = next - x;
+        }
+        if (std::fabs(next - x) <= 1e-12 * std::max(1.0, std::fabs(x))) return next;
+        x = next;
+    }
+    return x;
+}
+
+// For a function `f` (as for newton_bracketed()) that has the same sign (that of `gk`) at every
+// tabulated b value, looks for a root in the intervals next to bvalues[k] (the tabulated b value
+// at which f is closest to 0), where f could reach 0 at a local extremum between tabulated b values.
+// The extremum is located by bisection on the sign of the derivative, stopping as soon as a point on
+// the other side of 0 is found.  Returns true and sets `b` to the (first) root if one is found.
+template <typename F>
+static bool solve_near_extremum(const F &f, const size_t &k, const double &gk, double &b) {
+    double lo = bvalues[k > 0 ? k-1 : 0], hi = bvalues[std::min(k+1, b_length-1)];
+    const bool negative = gk < 0;
+    double deriv;
+    const double glo = f(lo, deriv);
+    // For negative values we're looking for a maximum, so the derivative must start positive
+    if (deriv == 0 || (deriv > 0) != negative) return false;
+    f(hi, deriv);
+    if (deriv == 0 || (deriv > 0) == negative) return false;
+    while (hi - lo > 1e-12) {
+        const double mid = 0.5 * (lo + hi);
+        const double gm = f(mid, deriv);
+        if (gm == 0) { b = mid; return true; }
+        if ((gm < 0) != negative) {
+            b = newton_bracketed(f, lo, mid, glo, 0.5 * (lo + mid));
+            return true;
+        }
+        if ((deriv > 0) == negative) lo = mid;
+        else hi = mid;
+    }
+    return false;
+}
+
+// See description in fracdist/solve.hpp
+double solve_b(const double &test_stat, const double &level, const unsigned int &q, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) {
+    // Throw the same exceptions as pvalue_advanced() and critical_advanced() for invalid arguments
+    if (test_stat < 0)
+        throw std::out_of_range(ostringstream() << "test stat (" << test_stat << ") invalid: cannot be negative");
+    if (!(level >= 0 && level <= 1))
+        throw std::out_of_range(ostringstream() << "test level (" << level << ") invalid: must be between 0 and 1");
+    quantiles(q, bvalues.front(), constant, interp_mode, T);
+
+    double b;
+    switch (solve_b_batch(&test_stat, &b, 1, level, q, constant, interp_mode, approx_points, T)) {
+        case status::ok:
+            return b;
+        case status::no_solution:
+            throw std::runtime_error(ostringstream() << "no b value gives test stat (" << test_stat << ") a p-value of " << level);
+        case status::invalid_approx_points:
+            detail::throw_approx_points(approx_points);
+        default:
+            throw std::runtime_error("Internal error: b value root finding failed");
+    }
+}
+
+// See description in fracdist/solve.hpp
+status solve_b_batch(const double *test_stats, double *bs, const size_t &n, const double &level, const unsigned int &q,
+        const bool &constant, const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T,
+        status *row_status) noexcept {
+    status params = check_parameters(q, bvalues.front(), constant, T);
+    if (params == status::ok && !(level >= 0 && level <= 1)) params = status::invalid_test_level;
+
+    // Scan the tabulated b values in increasing order, interpolating the quantiles at each just once
+    // for all of the statistics, until every statistic's p-value has crossed the level (or the b
+    // values run out).  bracket[i] is then the index k such that the p-value of test_stats[i] equals
+    // the level at bvalues[k] (if exact[i]) or crosses it between bvalues[k-1] and bvalues[k] (with
+    // the p-values minus the level at those b values in glo[i] and ghi[i]), or the index at which
+    // the p-value couldn't be calculated (with the reason in found[i]).  For statistics without a
+    // crossing, closest[i] is the index at which the p-value came closest to the level, where it
+    // was gclosest[i] away.
+    const size_t unset = (size_t) -1;
+    std::vector<size_t> bracket, closest;
+    std::vector<double> g, gprev, glo, ghi, gclosest;
+    std::vector<status> scan_status, found;
+    std::vector<char> exact;
+    if (params == status::ok) {
+        try {
+            bracket.assign(n, unset);
+            closest.assign(n, 0);
+            gclosest.assign(n, INFINITY);
+            g.resize(n);
+            gprev.resize(n);
+            glo.resize(n);
+            ghi.resize(n);
+            exact.assign(n, false);
+            scan_status.assign(n, status::ok);
+            found.assign(n, status::ok);
+            size_t remaining = n;
+            for (size_t k = 0; k < b_length && remaining > 0; k++) {
+                const std::array<double, p_length> quant = quantiles(q, bvalues[k], constant, interp_mode, T);
+                std::swap(g, gprev);
+                detail::pvalue_rows(&quant, status::ok, q, approx_points, test_stats, g.data(), n, scan_status.data());
+                for (size_t i = 0; i < n; i++) {
+                    if (bracket[i] != unset) continue;
+                    const double gi = g[i] - level;
+                    if (scan_status[i] != status::ok || gi == 0 || (k > 0 && (gi < 0) != (gprev[i] < 0))) {
+                        bracket[i] = k;
+                        found[i] = scan_status[i];
+                        exact[i] = gi == 0;
+                        glo[i] = k > 0 ? gprev[i] : 0;
+                        ghi[i] = gi;
+                        remaining--;
+                    }
+                    else if (std::fabs(gi) < std::fabs(gclosest[i])) {
+                        closest[i] = k;
+                        gclosest[i] = gi;
+                    }
+                    g[i] = gi;
+                }
+            }
+        }
+        catch (...) { params = status::internal_error; }
+    }
+
+    // Between the tabulated b values, exact_or_JGMMON14's p-values are JGMMON14's, which are also
+    // their limits at the tabulated b values; root finding uses those.
+    const interpolation between = interp_mode == interpolation::exact_or_JGMMON14 ? interpolation::JGMMON14 : interp_mode;
+    status first = status::ok;
+    for (size_t i = 0; i < n; i++) {
+        const double &t = test_stats[i];
+        double &b = bs[i];
+        status s = status::ok;
+        const size_t k = params == status::ok ? bracket[i] : unset;
+        auto f = [&](const double &x, double &deriv) {
+            const pvalue_derivatives pd = pvalue_with_derivatives(t, q, x, constant, between, approx_points, T);
+            deriv = pd.db;
+            return pd.pvalue - level;
+        };
+        if (!(t >= 0)) s = status::invalid_test_stat;
+        else if (params != status::ok) s = params;
+        else if (k == unset) {
+            try {
+                if (!std::isfinite(gclosest[i]) || !solve_near_extremum(f, closest[i], gclosest[i], b))
+                    s = status::no_solution;
+            }
+            catch (...) { s = status::internal_error; }
+        }
+        else if (found[i] != status::ok) s = found[i];
+        else if (exact[i]) b = bvalues[k];
+        else {
+            const double lo = bvalues[k-1], hi = bvalues[k];
+            try {
+                double flo = glo[i], fhi = ghi[i], deriv;
+                if (between != interp_mode) {
+                    // Only the ends of the interval get the exact p-values, so if the JGMMON14
+                    // p-values don't cross the level, the crossing is the jump to the exact p-value
+                    // at one of the ends.
+                    flo = f(lo, deriv);
+                    fhi = f(hi, deriv);
+                }
+                if (flo != 0 && fhi != 0 && (flo < 0) == (fhi < 0))
+                    b = (glo[i] < 0) != (flo < 0) ? lo : hi;
+                else {
+                    // Start from where the secant across the interval crosses the level
+                    const double x0 = lo + (hi - lo) * flo / (flo - fhi);
+                    b = newton_bracketed(f, lo, hi, flo, x0 > lo && x0 < hi ? x0 : 0.5 * (lo + hi));
+                }
+            }
+            catch (...) { s = status::internal_error; }
+        }
+        if (s != status::ok) {
+            b = NAN;
+            if (first == status::ok) first = s;
+        }
+        if (row_status) row_status[i] = s;
+    }
+    return first;
+}
+
+// See description in fracdist/solve.hpp
+double solve_stat(const double &level, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T) {
+    if (!(level > 0 && level < 1))
+        throw std::out_of_range(ostringstream() << "test level (" << level << ") invalid: must be strictly between 0 and 1");
+
+    const std::array<double, p_length> quant = quantiles(q, b, constant, interp_mode, T);
+    auto g = [&](const double &x, double &deriv) {
+        const pvalue_derivatives pd = pvalue_with_derivatives(x, q, b, constant, interp_mode, approx_points, T);
+        deriv = pd.dstat;
+        return pd.pvalue - level;
+    };
+
+    // The p-value decreases in the statistic, and is 1 at 0 and 0 beyond twice the largest quantile,
+    // so bracket the root by stepping outwards from the critical value through the quantiles.  (For
+    // levels near 1, the critical value and the smallest quantiles can be negative, which aren't
+    // valid statistics; the bracket stops at 0.)
+    const double x0 = std::max(0.0, critical_advanced(level, q, b, constant, interp_mode, approx_points, T));
+    double deriv;
+    const double g0 = g(x0, deriv);
+    if (g0 == 0) return x0;
+    double lo, hi, glo;
+    if (g0 > 0) {
+        lo = x0;
+        glo = g0;
+        hi = std::nextafter(2 * quant.back(), INFINITY);
+        for (auto it = std::upper_bound(quant.begin(), quant.end(), x0); it != quant.end(); ++it) {
+            if (g(*it, deriv) <= 0) { hi = *it; break; }
+            lo = *it;
+        }
+    }
+    else {
+        hi = x0;
+        lo = 0;
+        glo = 1 - level;
+        for (auto it = std::lower_bound(quant.begin(), quant.end(), x0); it != quant.begin(); ) {
+            --it;
+            if (!(*it > 0)) break;
+            const double gi = g(*it, deriv);
+            if (gi >= 0) { lo = *it; glo = gi; break; }
+            hi = *it;
+        }
+    }
+    if (glo == 0) return lo;
+    return newton_bracketed(g, lo, hi, glo, x0 > lo && x0 < hi ? x0 : 0.5 * (lo + hi));
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <fracdist/common.hpp>
+
+/** @file fracdist/solve.hpp
+ * @brief Header file for fracdist's root finding interface: the b value at which a test statistic's
+ * p-value crosses a given level, and the test statistic with a given p-value.
+ *
+ * Both solvers bracket the root using values that are cheap to obtain (the tabulated b values, or
+ * the interpolated quantiles), then refine it with Newton steps using the closed-form derivatives
+ * of pvalue_with_derivatives(), falling back to bisection whenever a Newton step would leave the
+ * bracket.  They typically need a handful of p-value evaluations where bisection needs dozens.
+ */
+
+namespace fracdist {
+
+/** Finds a b value at which the p-value (as calculated by pvalue_advanced()) of `test_stat` equals
+ * `level`.
+ *
+ * The p-value is first evaluated at each of the tabulated b values (fracdist::bvalues) to find the
+ * first interval between them over whose ends it crosses `level`; the crossing within that
+ * interval is then found to within about \f$10^{-12}\f$.  If there is no such interval, the p-value
+ * may still reach `level` (and cross it twice) between two tabulated b values, so the extremum of
+ * the p-value next to the tabulated b value at which it came closest to `level` is also checked.
+ *
+ * If the p-value crosses `level` more than once, the result is therefore usually, but not always,
+ * the smallest such b value: a pair of crossings within a single interval (where the p-value is on
+ * the same side of `level` at both ends) is missed when some later interval has a crossing, and
+ * is only found otherwise if it is next to the closest tabulated b value.  For
+ * interpolation::exact_or_JGMMON14, whose p-values jump at the tabulated b values, the result may
+ * be a tabulated b value at which the p-value jumps across `level`.
+ *
+ * \throws std::out_of_range for an invalid q value, a negative test statistic, or a level outside
+ * \f$[0, 1]\f$
+ * \throws std::runtime_error if the p-value does not reach `level` for any b value, if
+ * approx_points is too small, or if `T > 0` and fracdist was built without response surface data.
+ */
+double solve_b(const double &test_stat, const double &level, const unsigned int &q, const bool &constant,
+        const interpolation &interp_mode = interpolation::JGMMON14, const unsigned int &approx_points = 9, const unsigned int &T = 0);
+
+/** Non-throwing, batched version of solve_b(): finds the b value for each of the `n` test statistics
+ * `test_stats[0]` through `test_stats[n-1]`, storing them in `bs`.  The quantiles at the tabulated b
+ * values, used to bracket every statistic's root, are interpolated just once.
+ *
+ * A statistic whose p-value never reaches `level` gets status::no_solution; otherwise statuses and
+ * NaN results are as for pvalue_batch().  Returns status::ok if every b value was found, otherwise
+ * the status of the first failure.
+ */
+status solve_b_batch(const double *test_stats, double *bs, const size_t &n, const double &level, const unsigned int &q,
+        const bool &constant, const interpolation &interp_mode, const unsigned int &approx_points, const unsigned int &T,
+        status *row_status = nullptr) noexcept;
+
+/** Finds the test statistic whose p-value (as calculated by pvalue_advanced()) equals `level`.
+ * Unlike critical_advanced(), which approximates the quantile function with its own local
+ * regression, this inverts pvalue_advanced() itself, so that the statistic is (to within about
+ * \f$10^{-12}\f$, relative) the threshold at which pvalue_advanced() crosses `level`.  (The two
+ * generally differ slightly.)  critical_advanced() provides the starting point, and the
+ * interpolated quantiles the bracket.
+ *
+ * pvalue_advanced() has small jumps where the quantiles used by its local regression change, and
+ * between a statistic of 0 (whose p-value is 1) and the smallest positive statistics.  When
+ * `level` falls within such a jump, no statistic has exactly that p-value, and the statistic at
+ * the jump is returned: for example, a level very close to 1 gives (approximately) 0.
+ *
+ * \throws std::out_of_range for an invalid b, q value, or a level outside \f$(0, 1)\f$
+ * \throws std::runtime_error if approx_points is too small, or if `T > 0` and fracdist was built
+ * without response surface data.
+ */
+double solve_stat(const double &level, const unsigned int &q, const double &b, const bool &constant,
+        const interpolation &interp_mode = interpolation::JGMMON14, const unsigned int &approx_points = 9, const unsigned int &T = 0);
+
+}
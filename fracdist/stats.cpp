@@ -0,0 +1,159 @@
+#include <fracdist/stats.hpp>
+#ifdef FRACDIST_STATS
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FRACDIST_STATS_RDTSC
+#endif
+#endif
+
+namespace fracdist {
+
+#ifdef FRACDIST_STATS
+
+namespace detail {
+
+constexpr size_t stat_count = (size_t) stat::count_;
+
+// One thread's counters.  Only the owning thread writes to them, so updates are plain relaxed
+// loads and stores (no locked instructions); the atomics just make concurrent reads by stats()
+// well-defined.  For timed stages the slot holds the call count and `ticks` holds the time.
+struct thread_stats {
+    std::atomic<uint64_t> counts[stat_count];
+    std::atomic<uint64_t> ticks[stat_count];
+    thread_stats();
+    ~thread_stats();
+};
+
+// All live threads' counters, plus the accumulated counters of threads that have exited
+struct stats_registry {
+    std::mutex mutex;
+    std::set<thread_stats*> threads;
+    uint64_t retired_counts[stat_count] = {};
+    uint64_t retired_ticks[stat_count] = {};
+};
+
+// Constructed on first use (by the first thread_stats constructor), and so destroyed after every
+// thread_stats object.
+static stats_registry& registry() {
+    static stats_registry r;
+    return r;
+}
+
+thread_stats::thread_stats() {
+    for (size_t i = 0; i < stat_count; i++) {
+        counts[i].store(0, std::memory_order_relaxed);
+        ticks[i].store(0, std::memory_order_relaxed);
+    }
+    stats_registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.insert(this);
+}
+
+thread_stats::~thread_stats() {
+    stats_registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t i = 0; i < stat_count; i++) {
+        r.retired_counts[i] += counts[i].load(std::memory_order_relaxed);
+        r.retired_ticks[i] += ticks[i].load(std::memory_order_relaxed);
+    }
+    r.threads.erase(this);
+}
+
+static thread_local thread_stats local_stats;
+
+static inline void bump(std::atomic<uint64_t> &a, const uint64_t &n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void stats_add(const stat &s, const uint64_t &n) {
+    bump(local_stats.counts[(size_t) s], n);
+}
+
+void stats_time(const stat &s, const uint64_t &ticks) {
+    bump(local_stats.counts[(size_t) s], 1);
+    bump(local_stats.ticks[(size_t) s], ticks);
+}
+
+uint64_t stats_ticks() {
+#ifdef FRACDIST_STATS_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+}
+
+bool stats_enabled() { return true; }
+
+stats_snapshot stats() {
+    using namespace detail;
+    uint64_t counts[stat_count], ticks[stat_count];
+    {
+        stats_registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (size_t i = 0; i < stat_count; i++) {
+            counts[i] = r.retired_counts[i];
+            ticks[i] = r.retired_ticks[i];
+        }
+        for (auto *t : r.threads) {
+            for (size_t i = 0; i < stat_count; i++) {
+                counts[i] += t->counts[i].load(std::memory_order_relaxed);
+                ticks[i] += t->ticks[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+#define FRACDIST_STAGE(name) { counts[(size_t) stat::name], ticks[(size_t) stat::name] }
+    stats_snapshot s = {
+        counts[(size_t) stat::qcache_hits],
+        counts[(size_t) stat::qcache_misses],
+        counts[(size_t) stat::chisq_cache_hits],
+        counts[(size_t) stat::chisq_cache_misses],
+        FRACDIST_STAGE(quantiles_interpolation),
+        FRACDIST_STAGE(pvalue_regression),
+        FRACDIST_STAGE(critical_regression),
+        FRACDIST_STAGE(chisq),
+#ifdef FRACDIST_STATS_RDTSC
+        "cycles"
+#else
+        "ns"
+#endif
+    };
+#undef FRACDIST_STAGE
+    return s;
+}
+
+void reset_stats() {
+    using namespace detail;
+    stats_registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t i = 0; i < stat_count; i++)
+        r.retired_counts[i] = r.retired_ticks[i] = 0;
+    for (auto *t : r.threads) {
+        for (size_t i = 0; i < stat_count; i++) {
+            t->counts[i].store(0, std::memory_order_relaxed);
+            t->ticks[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+#else
+
+bool stats_enabled() { return false; }
+
+stats_snapshot stats() {
+    stats_snapshot s = {};
+    s.tick_unit = "ns";
+    return s;
+}
+
+void reset_stats() {}
+
+#endif
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/** @file fracdist/stats.hpp
+ * @brief Optional instrumentation of where fracdist spends its time.
+ *
+ * When fracdist is built with the `fracdist_STATS` CMake option (which defines `FRACDIST_STATS`),
+ * the library keeps per-thread counters and timers for the main stages of the p-value and
+ * critical value calculations: quantile cache hits and misses, the b interpolation in quantiles(),
+ * the local regressions in pvalue_advanced() and critical_advanced(), and chi-squared
+ * distribution evaluations.  stats() sums these over all threads.  (The regressions performed
+ * inline by the compile-time pvalue<>() and critical<>() templates are not timed, since that code
+ * is compiled into the caller).
+ *
+ * Without `fracdist_STATS` the instrumentation compiles to nothing, stats_enabled() returns false,
+ * and stats() always returns zeros.
+ */
+
+namespace fracdist {
+
+/** Call count and total time spent in one instrumented stage. */
+struct stage_stats {
+    /// The number of times the stage was entered
+    uint64_t calls;
+    /// The total time spent in the stage, in `stats_snapshot::tick_unit` units
+    uint64_t ticks;
+};
+
+/** A snapshot of the fracdist instrumentation counters, summed across all threads (including
+ * threads that have since exited).
+ */
+struct stats_snapshot {
+    /// The number of quantiles() calls answered from the cache
+    uint64_t qcache_hits;
+    /// The number of quantiles() calls that had to interpolate new quantiles
+    uint64_t qcache_misses;
+    /// The number of inverse chi-squared values found in the cache
+    uint64_t chisq_cache_hits;
+    /// The number of inverse chi-squared values that had to be calculated
+    uint64_t chisq_cache_misses;
+    /// Calculating and applying the b interpolation weights in quantiles()
+    stage_stats quantiles_interpolation;
+    /// The local quadratic regression in pvalue_advanced() (including the chi-squared evaluations
+    /// it makes, which are also included in `chisq`)
+    stage_stats pvalue_regression;
+    /// The local quadratic regression in critical_advanced() (including its chi-squared evaluations)
+    stage_stats critical_regression;
+    /// Evaluations of the chi-squared cdf or inverse cdf
+    stage_stats chisq;
+    /// The unit of the `ticks` values: "cycles" (where a cycle counter is available) or "ns"
+    const char *tick_unit;
+};
+
+/** Returns true if fracdist was built with instrumentation enabled. */
+bool stats_enabled();
+
+/** Returns the current values of the instrumentation counters.  This is safe to call while other
+ * threads are using fracdist (though the snapshot may not include their most recent updates).
+ */
+stats_snapshot stats();
+
+/** Resets all instrumentation counters to zero.  Updates made by other threads while this is
+ * running may be lost.
+ */
+void reset_stats();
+
+/// @cond INTERNAL
+namespace detail {
+
+enum class stat : size_t {
+    qcache_hits, qcache_misses, chisq_cache_hits, chisq_cache_misses,
+    quantiles_interpolation, pvalue_regression, critical_regression, chisq,
+    count_
+};
+
+#ifdef FRACDIST_STATS
+// Adds `n` to the calling thread's counter for `s`
+void stats_add(const stat &s, const uint64_t &n = 1);
+// Adds a call and `ticks` to the calling thread's timer for the stage `s`
+void stats_time(const stat &s, const uint64_t &ticks);
+// Returns the current timer value
+uint64_t stats_ticks();
+
+// Times the remainder of the enclosing scope
+class stats_timer {
+    public:
+        explicit stats_timer(const stat &s) : s_(s), start_(stats_ticks()) {}
+        ~stats_timer() { stats_time(s_, stats_ticks() - start_); }
+    private:
+        const stat s_;
+        const uint64_t start_;
+};
+#endif
+
+}
+/// @endcond
+
+}
+
+/// @cond INTERNAL
+#ifdef FRACDIST_STATS
+#define FRACDIST_STATS_COUNT(name) fracdist::detail::stats_add(fracdist::detail::stat::name)
+#define FRACDIST_STATS_TIME(name) fracdist::detail::stats_timer fracdist_stats_timer_##name(fracdist::detail::stat::name)
+#else
+#define FRACDIST_STATS_COUNT(name) do {} while (0)
+#define FRACDIST_STATS_TIME(name) do {} while (0)
+#endif
+/// @endcond
@@ -0,0 +1,107 @@
+#include <fracdist/sweep.hpp>
+#include <fracdist/tables.hpp>
+
+namespace fracdist {
+
+// Returns the JGMMON14 regression weight of tabulated b value i at b, which is positive (that is,
+// larger than 1e-12) for the b values within 0.2 of b.  Calculated exactly as quantiles() does, so
+// that the sweep's windows contain the same b values.
+static inline double regression_weight(const size_t &i, const double &b) {
+    return 1.0 - 5.0*fabs(bvalues[i] - b);
+}
+
+// Calculates result = sum_j w[j] rows[j] for j from first to last.  Like apply_weights(), but adding
+// up to four rows per pass over `result` instead of one, which is about twice as fast for the seven
+// or eight rows of a JGMMON14 window.  (The additions are grouped differently, so the result can
+// differ from apply_weights() in the last bit.)
+FRACDIST_KERNEL static void apply_window(const double *w, const std::array<double, p_length> *rows, const size_t &first,
+        const size_t &last, std::array<double, p_length> &result) {
+    double *out = result.data();
+    for (size_t j = first; j <= last; j += 4) {
+        // Rows past the end get a zero weight (and reuse the last row, to stay in bounds)
+        const size_t n = last - j + 1;
+        const double w0 = w[j], w1 = n > 1 ? w[j+1] : 0.0, w2 = n > 2 ? w[j+2] : 0.0, w3 = n > 3 ? w[j+3] : 0.0;
+        const double *r0 = rows[j].data(), *r1 = rows[n > 1 ? j+1 : j].data(), *r2 = rows[n > 2 ? j+2 : j].data(),
+              *r3 = rows[n > 3 ? j+3 : j].data();
+        if (j == first) {
+            for (size_t i = 0; i < p_length; i++)
+                out[i] = (w0 * r0[i] + w1 * r1[i]) + (w2 * r2[i] + w3 * r3[i]);
+        }
+        else {
+            for (size_t i = 0; i < p_length; i++)
+                out[i] += (w0 * r0[i] + w1 * r1[i]) + (w2 * r2[i] + w3 * r3[i]);
+        }
+    }
+}
+
+// See description in fracdist/sweep.hpp
+quantile_sweep::quantile_sweep(const unsigned int &q, const bool &constant, const interpolation &interp, const unsigned int &T)
+    : q_(q), constant_(constant), interp_(interp), T_(T), first_(1), last_(0), b_(bvalues.front())
+{
+    // Check the parameters (throwing the same exceptions as quantiles() does)
+    quantiles(q, bvalues.front(), constant, interp, T);
+    rows_ = table(q, constant);
+}
+
+// See description in fracdist/sweep.hpp
+const std::array<double, p_length>& quantile_sweep::operator()(const double &b) {
+    if (T_ > 0 || (interp_ != interpolation::JGMMON14 && interp_ != interpolation::exact_or_JGMMON14)) {
+        quantiles_ = quantiles(q_, b, constant_, interp_, T_);
+        return quantiles_;
+    }
+
+    const double bmin = bvalues.front(), bmax = bvalues.back();
+    if (!(b >= bmin && b <= bmax))
+        throw std::out_of_range(ostringstream() << "b value (" << b << ") invalid: b must be between " << bmin << " and " << bmax);
+
+    bweights bw;
+    if (interp_ == interpolation::exact_or_JGMMON14) {
+        // An exact match can't be below the previous window (unless b decreased)
+        const size_t from = last_ >= first_ && b >= b_ ? first_ : 0;
+        for (size_t i = from; i < b_length && bvalues[i] <= b; i++) {
+            if (bvalues[i] == b) {
+                bw.first = bw.last = i;
+                bw.w[i] = 1.0;
+                apply_weights(bw, rows_, quantiles_);
+                return quantiles_;
+            }
+        }
+    }
+
+    // Slide the window: its start moves up past the b values now too far below b, then its end up
+    // to the last b value close enough above it.  (If b decreased, or on the first step, the window
+    // is found again from the start of the grid.)
+    const bool restart = last_ < first_ || b < b_;
+    if (restart) first_ = 0;
+    while (first_ < b_length && !(regression_weight(first_, b) > 1e-12)) first_++;
+    if (restart || last_ < first_) last_ = first_;
+    while (last_ + 1 < b_length && regression_weight(last_ + 1, b) > 1e-12) last_++;
+    b_ = b;
+    if (first_ >= b_length || last_ - first_ < 2)
+        throw std::runtime_error(ostringstream() << "b value (" << b << ") unsupported: not enough data points for quadratic approximation");
+
+    // The regression of w_i F_i on w_i (1, z_i, z_i^2) with z_i = (bvalues[i] - b) / 0.05 has fitted
+    // value at z = 0 (that is, at b) of sum_i w_i^2 (u_0 + u_1 z_i + u_2 z_i^2) F_i, where u solves
+    // M u = (1, 0, 0)' with M = sum_i w_i^2 (1, z_i, z_i^2)'(1, z_i, z_i^2), so only the moments
+    // S_k = sum_i w_i^2 z_i^k are needed.
+    double S[5] = {0, 0, 0, 0, 0}, z[b_length], w2[b_length];
+    for (size_t i = first_; i <= last_; i++) {
+        const double w = regression_weight(i, b);
+        z[i] = (bvalues[i] - b) * 20.0;
+        w2[i] = w * w;
+        double t = w2[i];
+        for (double &s : S) { s += t; t *= z[i]; }
+    }
+    // Solve M u = e_1 with M_jk = S_{j+k} by Cramer's rule: u is the first column of M^{-1}, the
+    // cofactors of M's first row divided by its determinant.
+    const double c0 = S[2]*S[4] - S[3]*S[3], c1 = S[3]*S[2] - S[1]*S[4], c2 = S[1]*S[3] - S[2]*S[2];
+    const double det = S[0]*c0 + S[1]*c1 + S[2]*c2;
+    const double u0 = c0 / det, u1 = c1 / det, u2 = c2 / det;
+
+    for (size_t i = first_; i <= last_; i++)
+        bw.w[i] = w2[i] * (u0 + z[i] * (u1 + z[i] * u2));
+    apply_window(bw.w.data(), rows_, first_, last_, quantiles_);
+    return quantiles_;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <fracdist/common.hpp>
+#include <cstddef>
+
+/** @file fracdist/sweep.hpp
+ * @brief Fast interpolation of the quantiles at a sequence of increasing b values.
+ */
+
+namespace fracdist {
+
+/** Interpolates the quantiles of one table (a fixed q and constant) at a sequence of b values, as
+ * when profiling a statistic over a fine b grid, more cheaply than a quantiles() call for each.
+ *
+ * For interpolation::JGMMON14 and interpolation::exact_or_JGMMON14, the quantiles at b are a
+ * weighted quadratic regression on the tabulated b values within 0.2 of b.  Each quantiles() call
+ * finds those b values by scanning the whole b grid, then fits the regression with a QR
+ * decomposition.  The sweep instead keeps the window of b values from one call to the next, moving
+ * its ends only as b values enter and leave it, and solves the regression's 3 x 3 normal equations
+ * (in coordinates centred on b, so that they stay well conditioned), leaving the application of the
+ * regression weights to the window's quantile rows as almost the entire cost of a step.  The results
+ * agree with quantiles() to within rounding error (about \f$10^{-14}\f$ relative).
+ *
+ * b values are expected to be increasing, but need not be: a b value smaller than the previous one
+ * just makes the window be found again from the start of the grid.  For the other interpolation
+ * modes, and for finite-sample quantiles (`T > 0`), each step simply calls quantiles().
+ *
+ * A quantile_sweep must not be used by more than one thread at a time.
+ */
+class quantile_sweep {
+    public:
+        /** Prepares a sweep of the quantiles for the given q, constant, interpolation mode, and
+         * sample size (0 for asymptotic quantiles).
+         *
+         * \throws std::out_of_range for an invalid q value
+         * \throws std::runtime_error if `T > 0` and fracdist was built without response surface data
+         */
+        quantile_sweep(const unsigned int &q, const bool &constant, const interpolation &interp = interpolation::JGMMON14,
+                const unsigned int &T = 0);
+
+        /** Returns the interpolated quantiles at `b`, equal (up to rounding) to `quantiles(q, b,
+         * constant, interp, T)`.  The returned reference remains valid (and its values unchanged)
+         * until the next call.
+         *
+         * \throws std::out_of_range for an invalid b value
+         */
+        const std::array<double, p_length>& operator()(const double &b);
+
+    private:
+        unsigned int q_;
+        bool constant_;
+        interpolation interp_;
+        unsigned int T_;
+        const std::array<double, p_length> *rows_;
+        // The window of b values with positive regression weights at the last b value, bvalues[first_]
+        // through bvalues[last_] (last_ < first_ before the first step), and that b value
+        size_t first_, last_;
+        double b_;
+        std::array<double, p_length> quantiles_;
+};
+
+}
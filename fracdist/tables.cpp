@@ -0,0 +1,116 @@
+#include <fracdist/tables.hpp>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+
+namespace fracdist {
+
+// Tables for q > q_length.  These are only ever added, never removed or replaced, so pointers into
+// them remain valid (and can be used without the lock) once they are loaded.
+static std::map<std::pair<unsigned int, bool>, std::unique_ptr<quantile_table>> extra_tables;
+static std::string table_dir;
+static std::mutex extra_lock;
+
+void set_table_directory(const std::string &dir) {
+    std::lock_guard<std::mutex> lock(extra_lock);
+    table_dir = dir;
+}
+
+// Parses a frcappNN.txt-format file into `t`.  Returns false if the file can't be opened; throws a
+// std::runtime_error if it can be opened but doesn't contain the expected data.
+static bool load_table_file(const std::string &filename, quantile_table &t) {
+    std::ifstream in(filename);
+    if (!in) return false;
+
+    std::string line;
+    size_t bi = 0, pi = p_length, lineno = 0;
+    while (std::getline(in, line)) {
+        lineno++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) {
+            // A blank line ends the data (the rest of the file is the copyright notice)
+            if (bi > 0) break;
+            continue;
+        }
+        double v1, v2;
+        char junk;
+        if (std::sscanf(line.c_str(), "b: %lf %c", &v1, &junk) == 1) {
+            if (pi != p_length)
+                throw std::runtime_error(ostringstream() << filename << ":" << lineno << ": found " << pi << " p values, wanted " << p_length);
+            if (bi >= b_length || v1 != bvalues[bi])
+                throw std::runtime_error(ostringstream() << filename << ":" << lineno << ": found b=" << v1 << " which doesn't match the built-in b values");
+            bi++;
+            pi = 0;
+        }
+        else if (std::sscanf(line.c_str(), "%lf %lf %c", &v1, &v2, &junk) == 2 && bi > 0) {
+            if (pi >= p_length || v1 != pvalues[pi])
+                throw std::runtime_error(ostringstream() << filename << ":" << lineno << ": found p=" << v1 << " which doesn't match the built-in p values");
+            t[bi-1][pi++] = v2;
+        }
+        else {
+            throw std::runtime_error(ostringstream() << filename << ":" << lineno << ": unable to parse line `" << line << "'");
+        }
+    }
+
+    if (bi != b_length || pi != p_length)
+        throw std::runtime_error(ostringstream() << filename << ": incomplete data: found " << bi << " b values, wanted " << b_length);
+    return true;
+}
+
+// Looks up (and, if necessary and possible, loads) the table for q > q_length.  Returns nullptr if
+// it isn't available.  The caller must hold extra_lock.
+static const quantile_table* find_extra(const unsigned int &q, const bool &constant) {
+    auto key = std::make_pair(q, constant);
+    auto found = extra_tables.find(key);
+    if (found != extra_tables.end())
+        return found->second.get();
+
+    if (table_dir.empty())
+        return nullptr;
+
+    // Room for the prefix, every digit of the largest q, and the suffix (sizeof counts each NUL)
+    char file[sizeof("frcapp") + std::numeric_limits<unsigned int>::digits10 + 1 + sizeof(".txt")];
+    std::snprintf(file, sizeof(file), "%s%02u.txt", constant ? "frcapp" : "frmapp", q);
+    std::unique_ptr<quantile_table> t(new quantile_table);
+    if (!load_table_file(table_dir + "/" + file, *t))
+        return nullptr;
+
+    return (extra_tables[key] = std::move(t)).get();
+}
+
+void add_table(const unsigned int &q, const bool &constant, const quantile_table &quantiles) {
+    if (q <= q_length)
+        throw std::out_of_range(ostringstream() << "q value (" << q << ") invalid: tables can only be added for q > " << q_length);
+
+    std::lock_guard<std::mutex> lock(extra_lock);
+    auto &t = extra_tables[std::make_pair(q, constant)];
+    if (t)
+        throw std::logic_error(ostringstream() << "a table for q=" << q << (constant ? " (with constant)" : " (without constant)") << " has already been loaded");
+    t.reset(new quantile_table(quantiles));
+}
+
+bool have_table(const unsigned int &q, const bool &constant) {
+    if (q >= 1 && q <= q_length) return true;
+    if (q < 1) return false;
+    std::lock_guard<std::mutex> lock(extra_lock);
+    return find_extra(q, constant) != nullptr;
+}
+
+const std::array<double, p_length>* table(const unsigned int &q, const bool &constant) {
+    if (q >= 1 && q <= q_length)
+        return constant ? q_const[q-1].data() : q_noconst[q-1].data();
+
+    if (q > q_length) {
+        std::lock_guard<std::mutex> lock(extra_lock);
+        const quantile_table *t = find_extra(q, constant);
+        if (t) return t->data();
+    }
+
+    throw std::out_of_range(ostringstream() << "q value (" << q << ") invalid: q must be between 1 and " << q_length <<
+            " (or a q with a table supplied via fracdist::set_table_directory() or fracdist::add_table())");
+}
+
+}
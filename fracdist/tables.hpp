@@ -0,0 +1,60 @@
+#pragma once
+#include <fracdist/common.hpp>
+#include <string>
+
+/** @file fracdist/tables.hpp
+ * @brief Header file for accessing quantile tables, including tables for \f$q\f$ values larger than
+ * those compiled into fracdist.
+ *
+ * The quantile data for \f$q = 1, \ldots, q_{length}\f$ is compiled into the library (see
+ * fracdist/data.hpp).  Tables for larger \f$q\f$ values can be supplied at runtime, either by
+ * pointing fracdist at a directory containing data files in the same format as the bundled
+ * `frcappNN.txt` and `frmappNN.txt` files (see set_table_directory()), or by adding quantiles
+ * directly (for example, from a simulation run) with add_table().  Tables from a directory are
+ * loaded lazily, the first time a given \f$q\f$ is requested, so there is no memory or startup cost
+ * unless larger \f$q\f$ values are actually used.
+ */
+
+namespace fracdist {
+
+/** The type of a quantile table for a single \f$q\f$ value and constant setting: `table[y][z]` is
+ * the quantile for \f$b={}\f$`fracdist::bvalues[y]` and \f$p={}\f$`fracdist::pvalues[z]`.
+ */
+typedef std::array<std::array<double, p_length>, b_length> quantile_table;
+
+/** Sets the directory to search for quantile tables for \f$q > q_{length}\f$.  For a model with a
+ * constant, the table for \f$q\f$ is read from `frcappNN.txt` in this directory, where `NN` is
+ * \f$q\f$ zero-padded to two digits; for a model without a constant, from `frmappNN.txt`.  The files
+ * must have the same b and p values as the compiled-in data.
+ *
+ * Changing the directory does not affect tables that have already been loaded.
+ */
+void set_table_directory(const std::string &dir);
+
+/** Adds a quantile table for the given \f$q\f$ value (which must be greater than
+ * `fracdist::q_length`) and constant setting, such as one produced by a simulation run.
+ *
+ * \throws std::out_of_range if `q <= q_length`
+ * \throws std::logic_error if a table for `q` and `constant` has already been added or loaded
+ */
+void add_table(const unsigned int &q, const bool &constant, const quantile_table &quantiles);
+
+/** Returns true if a table for the given \f$q\f$ value and constant setting is available: that is,
+ * if \f$1 \leq q \leq q_{length}\f$, or if a table for `q` has been (or can be) loaded.  This will
+ * attempt to load the table from the table directory if not already loaded.
+ *
+ * \throws std::runtime_error if a table file exists but cannot be parsed.
+ */
+bool have_table(const unsigned int &q, const bool &constant);
+
+/** Returns a pointer to the first of the `b_length` quantile rows (one for each b value, each of
+ * which has the `p_length` quantiles) for the given \f$q\f$ and constant setting, loading the table
+ * from the table directory if necessary.  For \f$q \leq q_{length}\f$, this simply points into
+ * fracdist::q_const or fracdist::q_noconst.
+ *
+ * \throws std::out_of_range if `q` is 0, or greater than `q_length` with no table available.
+ * \throws std::runtime_error if a table file exists but cannot be parsed.
+ */
+const std::array<double, p_length>* table(const unsigned int &q, const bool &constant);
+
+}
@@ -11,4 +11,13 @@ extern const unsigned int version_patch;
 /** The full, three-part version value as a string.  The string `1.2.3` for version 1.2.3. */
 extern const char *version_string;
 
+/** Returns the instruction set level of the numerical kernels (quantile interpolation, chi-squared
+ * evaluation, and the batch p-value and critical value loops) that were selected for the running
+ * CPU when fracdist was loaded: `"x86-64-v4"` (AVX-512), `"x86-64-v3"` (AVX2 and FMA), or
+ * `"x86-64"` (the SSE2 baseline).  Returns `"generic"` if fracdist was built without runtime CPU
+ * dispatch (which requires GCC 11 or newer on x86-64 Linux, and can be disabled with the
+ * `fracdist_CPU_DISPATCH` CMake option).
+ */
+const char* cpu_dispatch();
+
 }
@@ -0,0 +1,424 @@
+/** @file fracdist_bench.cpp
+ * @brief Microbenchmarks for the main fracdist functions, with results written to stdout as JSON.
+ *
+ * Measures cold (cache-missing) and warm quantiles() calls for each interpolation mode,
+ * pvalue_advanced() and critical_advanced() for realistic test statistics and levels, the effect of
+ * `approx_points`, and mixed-parameter workloads with skewed b and q distributions.  The JSON output
+ * is intended to be stored and compared across releases to catch performance regressions.
+ *
+ * The build produces `fracdist_bench`, linked against the shared library, and (when the static
+ * library is enabled) `fracdist_bench_static`, linked against the link-time optimized static
+ * library; the `linkage` field of the output says which one produced it, so running both shows the
+ * per-call cost of the shared library.
+ *
+ * Usage: fracdist_bench [--min-time SECONDS] [--filter SUBSTRING]
+ */
+#include <fracdist/pvalue.hpp>
+#include <fracdist/critical.hpp>
+#include <fracdist/distribution.hpp>
+#include <fracdist/sampler.hpp>
+#include <fracdist/decision.hpp>
+#include <fracdist/lrtest.hpp>
+#include <fracdist/panel.hpp>
+#include <fracdist/sweep.hpp>
+#include <fracdist/solve.hpp>
+#include <fracdist/version.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef FRACDIST_BENCH_LINKAGE
+#define FRACDIST_BENCH_LINKAGE "shared"
+#endif
+
+using namespace fracdist;
+
+namespace {
+
+double min_time = 0.25;
+std::string filter;
+bool first_result = true;
+volatile double sink; // Results are accumulated here so that the compiler can't elide the work
+
+const char *interp_name(const interpolation &i) {
+    switch (i) {
+        case interpolation::JGMMON14: return "JGMMON14";
+        case interpolation::exact_or_JGMMON14: return "exact_or_JGMMON14";
+        case interpolation::linear: return "linear";
+        case interpolation::spline: return "spline";
+        case interpolation::chebyshev: return "chebyshev";
+    }
+    return "unknown";
+}
+
+const interpolation all_interps[] = { interpolation::JGMMON14, interpolation::exact_or_JGMMON14, interpolation::linear, interpolation::spline,
+    interpolation::chebyshev };
+
+// Runs `batch` (which performs `ops` operations) repeatedly until at least min_time seconds have
+// elapsed, then prints a JSON result object.  `params` is extra JSON (without surrounding braces)
+// describing the benchmark.
+void bench(const std::string &name, const std::string &params, const size_t &ops, const std::function<double()> &batch) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+    typedef std::chrono::steady_clock clock;
+    sink = batch(); // Warm-up run
+    size_t runs = 0;
+    double elapsed = 0;
+    auto start = clock::now();
+    do {
+        sink = sink + batch();
+        runs++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < min_time);
+
+    const double total_ops = (double) runs * ops;
+    printf("%s\n    {\"name\": \"%s\", %s%s\"ops\": %.0f, \"seconds\": %.6f, \"ns_per_op\": %.2f, \"ops_per_second\": %.1f}",
+            first_result ? "" : ",", name.c_str(), params.c_str(), params.empty() ? "" : ", ",
+            total_ops, elapsed, 1e9 * elapsed / total_ops, total_ops / elapsed);
+    first_result = false;
+    fflush(stdout);
+}
+
+// Parameters for one p-value or critical value request
+struct request {
+    unsigned int q;
+    double b;
+    bool constant;
+    double value; // A test statistic or a test level
+};
+
+// Generates `n` requests with b and q skewed the way production traffic tends to be: q mostly
+// small, b clustered around 1, with a fraction `repeat` of requests reusing the previous request's
+// q, b, and constant (as happens when many statistics are tested against the same model).  The
+// values are test statistics drawn from each request's null distribution if `stats` is true, and
+// test levels otherwise.
+std::vector<request> mixed_requests(const size_t &n, const double &repeat, const bool &stats, std::mt19937_64 &rng) {
+    std::uniform_real_distribution<double> unif(0, 1);
+    std::geometric_distribution<unsigned int> qdist(0.45);
+    std::normal_distribution<double> bdist(1.0, 0.25);
+    std::vector<request> reqs(n);
+    for (size_t i = 0; i < n; i++) {
+        request &r = reqs[i];
+        if (i > 0 && unif(rng) < repeat) {
+            r = reqs[i-1];
+        }
+        else {
+            r.q = std::min<unsigned int>(1 + qdist(rng), q_length);
+            do { r.b = std::round(bdist(rng) * 1000) / 1000; } while (r.b < bvalues.front() || r.b > bvalues.back());
+            r.constant = unif(rng) < 0.5;
+        }
+        double u = 0.0005 + 0.999 * unif(rng);
+        r.value = stats ? critical(u, r.q, r.b, r.constant) : u;
+    }
+    return reqs;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--min-time") && i+1 < argc) min_time = std::stod(argv[++i]);
+        else if (!strcmp(argv[i], "--filter") && i+1 < argc) filter = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--min-time SECONDS] [--filter SUBSTRING]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::mt19937_64 rng(12345);
+    std::uniform_real_distribution<double> unif(0, 1);
+
+    printf("{\n  \"fracdist_version\": \"%s\",\n  \"linkage\": \"%s\",\n  \"min_time\": %g,\n  \"results\": [",
+            version_string, FRACDIST_BENCH_LINKAGE, min_time);
+
+    // quantiles(): cold calls alternate between two b values so that every call misses the cache;
+    // warm calls repeat the same parameters.
+    for (auto &interp : all_interps) {
+        std::string p = std::string("\"interp\": \"") + interp_name(interp) + "\"";
+        bench("quantiles_cold", p, 1000, [&]() {
+            double s = 0;
+            for (int i = 0; i < 1000; i++) s += quantiles(3, i % 2 ? 0.77 : 1.23, true, interp)[100];
+            return s;
+        });
+        bench("quantiles_cold_exact_b", p, 1000, [&]() {
+            double s = 0;
+            for (int i = 0; i < 1000; i++) s += quantiles(3, i % 2 ? 0.75 : 1.25, true, interp)[100];
+            return s;
+        });
+        bench("quantiles_warm", p, 1000, [&]() {
+            double s = 0;
+            for (int i = 0; i < 1000; i++) s += quantiles(3, 0.77, true, interp)[100];
+            return s;
+        });
+    }
+
+    // pvalue_advanced() and critical_advanced() at fixed parameters (so quantiles() is always
+    // cached), for statistics drawn from the null distribution and for uniformly drawn levels.
+    const size_t n = 1000;
+    for (unsigned int q : {1u, 4u, 12u}) {
+        std::vector<double> stats(n), levels(n);
+        for (size_t i = 0; i < n; i++) {
+            levels[i] = unif(rng);
+            stats[i] = critical(0.0005 + 0.999 * unif(rng), q, 0.77, true);
+        }
+        for (auto &interp : all_interps) {
+            std::string p = "\"q\": " + std::to_string(q) + ", \"interp\": \"" + interp_name(interp) + "\"";
+            bench("pvalue_advanced", p, n, [&]() {
+                double s = 0;
+                for (auto &t : stats) s += pvalue_advanced(t, q, 0.77, true, interp, 9);
+                return s;
+            });
+            bench("critical_advanced", p, n, [&]() {
+                double s = 0;
+                for (auto &l : levels) s += critical_advanced(l, q, 0.77, true, interp, 9);
+                return s;
+            });
+        }
+        // The plain entry points, with the default interpolation and approx_points
+        std::string p = "\"q\": " + std::to_string(q);
+        bench("pvalue_simple", p, n, [&]() {
+            double s = 0;
+            for (auto &t : stats) s += pvalue(t, q, 0.77, true);
+            return s;
+        });
+        bench("critical_simple", p, n, [&]() {
+            double s = 0;
+            for (auto &l : levels) s += critical(l, q, 0.77, true);
+            return s;
+        });
+        bench("pvalue_with_derivatives", p, n, [&]() {
+            double s = 0;
+            for (auto &t : stats) s += pvalue_with_derivatives(t, q, 0.77, true).db;
+            return s;
+        });
+        // The compile-time specialized entry points
+        p += ", \"interp\": \"JGMMON14\"";
+        bench("pvalue_template", p, n, [&]() {
+            double s = 0;
+            for (auto &t : stats) s += pvalue<interpolation::JGMMON14, 9>(t, q, 0.77, true);
+            return s;
+        });
+        bench("critical_template", p, n, [&]() {
+            double s = 0;
+            for (auto &l : levels) s += critical<interpolation::JGMMON14, 9>(l, q, 0.77, true);
+            return s;
+        });
+    }
+
+    // Batch evaluation, and the cost of invalid input rows via exceptions versus status codes
+    {
+        std::vector<double> stats(n), out(n);
+        for (auto &t : stats) t = critical(0.0005 + 0.999 * unif(rng), 4, 0.77, true);
+        bench("pvalue_batch", "", n, [&]() {
+            pvalue_batch(stats.data(), out.data(), n, 4, 0.77, true, interpolation::JGMMON14, 9, 0);
+            return out[0];
+        });
+        bench("invalid_stat_throwing", "", n, [&]() {
+            double s = 0;
+            for (size_t i = 0; i < n; i++) {
+                try { s += pvalue(-1.0, 4, 0.77, true); } catch (std::exception&) { s += 1; }
+            }
+            return s;
+        });
+        bench("invalid_stat_status", "", n, [&]() {
+            double s = 0, p;
+            for (size_t i = 0; i < n; i++) {
+                if (try_pvalue(p, -1.0, 4, 0.77, true, interpolation::JGMMON14, 9, 0) != status::ok) s += 1;
+            }
+            return s;
+        });
+    }
+
+    // distribution p-values with the regression and with the precomputed monotone map
+    for (unsigned int q : {1u, 4u}) {
+        std::vector<double> stats(n), out(n);
+        for (auto &t : stats) t = critical(0.0005 + 0.999 * unif(rng), q, 0.77, true);
+        for (auto method : {pvalue_method::regression, pvalue_method::monotone_map}) {
+            distribution d(q, 0.77, true, interpolation::JGMMON14, 9, 0, method);
+            std::string p = "\"q\": " + std::to_string(q) + ", \"method\": \"" +
+                (method == pvalue_method::regression ? "regression" : "monotone_map") + "\"";
+            bench("distribution_pvalues", p, n, [&]() {
+                d.pvalues(stats.data(), out.data(), n);
+                return out[0];
+            });
+        }
+        bench("distribution_build_monotone_map", "\"q\": " + std::to_string(q), 1, [&]() {
+            return distribution(q, 0.77, true, interpolation::JGMMON14, 9, 0, pvalue_method::monotone_map).quantiles()[0];
+        });
+    }
+
+    // Rejection decisions at 10%, 5%, and 1% from precomputed critical values
+    {
+        std::vector<double> stats(n);
+        std::vector<uint8_t> codes(n);
+        for (auto &t : stats) t = critical(0.0005 + 0.999 * unif(rng), 4, 0.77, true);
+        const decision_rule rule(distribution(4, 0.77, true));
+        bench("decision_codes", "\"q\": 4", n, [&]() {
+            rule.codes(stats.data(), codes.data(), n);
+            return (double) codes[0];
+        });
+        bench("decision_rule_build", "\"q\": 4", 1, [&]() {
+            return decision_rule(distribution(4, 0.77, true)).criticals()[0];
+        });
+    }
+
+    // A panel of series with their own q, b (a continuous estimate each), and constant, against a
+    // pvalue() call per series
+    {
+        const size_t m = 5000;
+        std::vector<panel_series> series(m);
+        for (auto &s : series) {
+            s.q = 1 + (unsigned int) (unif(rng) * 4);
+            s.constant = unif(rng) < 0.5;
+            s.b = 0.6 + unif(rng);
+            s.test_stat = critical(0.0005 + 0.999 * unif(rng), s.q, s.b, s.constant);
+        }
+        panel_result result;
+        bench("pvalue_panel", "", m, [&]() {
+            pvalue_panel(series.data(), m, result);
+            return result.fisher_pvalue;
+        });
+        bench("pvalue_per_series", "", m, [&]() {
+            double sum = 0;
+            for (auto &s : series) sum += pvalue(s.test_stat, s.q, s.b, s.constant);
+            return sum;
+        });
+    }
+
+    // Root finding: the b value at which statistics cross the 5% level (one at a time, and as a
+    // batch sharing the bracketing scan), and the statistic with a given p-value
+    {
+        const size_t m = 100;
+        std::vector<double> stats(m), out(m), levels(m);
+        for (auto &t : stats) t = critical(0.05, 3, 0.6 + 1.3 * unif(rng), true);
+        for (auto &l : levels) l = 0.001 + 0.998 * unif(rng);
+        bench("solve_b", "\"q\": 3", m, [&]() {
+            double s = 0;
+            for (auto &t : stats) s += solve_b(t, 0.05, 3, true);
+            return s;
+        });
+        bench("solve_b_batch", "\"q\": 3", m, [&]() {
+            solve_b_batch(stats.data(), out.data(), m, 0.05, 3, true, interpolation::JGMMON14, 9, 0);
+            return out[0];
+        });
+        bench("solve_stat", "\"q\": 3", m, [&]() {
+            double s = 0;
+            for (auto &l : levels) s += solve_stat(l, 3, 0.77, true);
+            return s;
+        });
+    }
+
+    // The LR rank test's (d, b) grid search, for two random walks over the default grid
+    {
+        const size_t T = 250, p = 2;
+        std::vector<double> data(T*p);
+        for (size_t t = 0; t < T; t++)
+            for (size_t i = 0; i < p; i++)
+                data[t*p + i] = (t > 0 ? data[(t-1)*p + i] : 0.0) + unif(rng) - 0.5;
+        bench("lr_test", "\"p\": 2, \"T\": 250", 1, [&]() {
+            return lr_test(data, p, 0, true).statistic;
+        });
+    }
+
+    // Random variates: a sampler filling a buffer, against a critical() call per uniform draw, and
+    // the cost of building the sampler's table
+    {
+        const distribution d(3, 0.77, true);
+        sampler s(d, 1);
+        const size_t m = 100000;
+        std::vector<double> out(m);
+        bench("sampler_fill", "\"q\": 3", m, [&]() {
+            s.fill(out.data(), m);
+            return out[0];
+        });
+        bench("critical_per_draw", "\"q\": 3", n, [&]() {
+            double sum = 0;
+            for (size_t i = 0; i < n; i++) sum += critical(unif(rng), 3, 0.77, true);
+            return sum;
+        });
+        bench("sampler_build", "\"q\": 3", 1, [&]() {
+            return sampler(d, 1).inverse_cdf(0.5);
+        });
+    }
+
+    // Quantiles over a fine increasing b grid, with a sweep and with a quantiles() call per b value
+    {
+        const size_t m = 1490;
+        std::vector<double> bs(m);
+        for (size_t k = 0; k < m; k++) bs[k] = 0.51 + k * 0.001;
+        for (auto interp : {interpolation::JGMMON14, interpolation::exact_or_JGMMON14}) {
+            std::string p = std::string("\"interp\": \"") + (interp == interpolation::JGMMON14 ? "JGMMON14" : "exact_or_JGMMON14") + "\"";
+            bench("quantile_sweep", p, m, [&]() {
+                quantile_sweep sweep(3, true, interp);
+                double s = 0;
+                for (auto &b : bs) s += sweep(b)[100];
+                return s;
+            });
+            bench("quantiles_per_b", p, m, [&]() {
+                double s = 0;
+                for (auto &b : bs) s += quantiles(3, b, true, interp)[100];
+                return s;
+            });
+        }
+    }
+
+    // A p-value surface (as for a heat map) over a b grid and sorted statistics, against a
+    // pvalue_batch() call per b value
+    {
+        const size_t nb = 50, ns = 200;
+        std::vector<double> b_grid(nb), stats(ns), out(nb * ns);
+        for (size_t i = 0; i < nb; i++) b_grid[i] = 0.51 + 1.49 * i / (nb - 1);
+        for (size_t j = 0; j < ns; j++) stats[j] = 0.1 + 20.0 * j / ns;
+        bench("pvalue_surface", "\"q\": 3", nb * ns, [&]() {
+            pvalue_surface(b_grid.data(), nb, stats.data(), ns, out.data(), 3, true);
+            return out[0];
+        });
+        bench("pvalue_batch_rows", "\"q\": 3", nb * ns, [&]() {
+            for (size_t i = 0; i < nb; i++)
+                pvalue_batch(stats.data(), out.data() + i*ns, ns, 3, b_grid[i], true, interpolation::JGMMON14, 9, 0);
+            return out[0];
+        });
+    }
+
+    // The effect of approx_points
+    {
+        std::vector<double> stats(n);
+        for (auto &t : stats) t = critical(0.0005 + 0.999 * unif(rng), 4, 1.3, false);
+        for (unsigned int ap : {5u, 7u, 9u, 13u, 21u, 41u}) {
+            std::string p = "\"approx_points\": " + std::to_string(ap);
+            bench("pvalue_approx_points", p, n, [&]() {
+                double s = 0;
+                for (auto &t : stats) s += pvalue_advanced(t, 4, 1.3, false, interpolation::JGMMON14, ap);
+                return s;
+            });
+            bench("critical_approx_points", p, n, [&]() {
+                double s = 0;
+                for (auto &t : stats) s += critical_advanced(t / (1 + t), 4, 1.3, false, interpolation::JGMMON14, ap);
+                return s;
+            });
+        }
+    }
+
+    // Production-like mixed workloads: skewed q and b, with varying amounts of parameter reuse
+    for (double repeat : {0.0, 0.5, 0.9}) {
+        auto preqs = mixed_requests(n, repeat, true, rng);
+        auto creqs = mixed_requests(n, repeat, false, rng);
+        std::string p = "\"repeat\": " + std::to_string(repeat);
+        bench("pvalue_mixed", p, n, [&]() {
+            double s = 0;
+            for (auto &r : preqs) s += pvalue(r.value, r.q, r.b, r.constant);
+            return s;
+        });
+        bench("critical_mixed", p, n, [&]() {
+            double s = 0;
+            for (auto &r : creqs) s += critical(r.value, r.q, r.b, r.constant);
+            return s;
+        });
+    }
+
+    printf("\n  ]\n}\n");
+}
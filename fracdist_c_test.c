@@ -0,0 +1,183 @@
+/** @file fracdist_c_test.c
+ * @brief Checks the C interface (fracdist/fracdist.h) from a C99 program.
+ *
+ * fracdist_regress checks the values of the C++ functions that the C interface wraps; this checks
+ * the wrapping itself: that the header compiles as C, that the per-row statuses of
+ * fracdist_pvalues(), fracdist_criticals(), and fracdist_decision_rule_codes() line up with their
+ * values across the 256-row blocks the wrappers work in, that the distribution and sampler handles
+ * behave, and that null pointers and invalid interpolation values give FRACDIST_INVALID_ARGUMENT
+ * (and null handles) rather than crashing.  The program exits with status 1 if any check fails.
+ *
+ * Usage:
+ *
+ *     fracdist_c_test
+ */
+
+#include <fracdist/fracdist.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static size_t failures = 0;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            if (++failures <= 10) { printf("FAIL: "); printf(__VA_ARGS__); printf("\n"); } \
+        } \
+    } while (0)
+
+/* Same-valued, or both NaN */
+static int same(double a, double b) {
+    return a == b || (isnan(a) && isnan(b));
+}
+
+/* More rows than a single block of the wrappers, with invalid rows at the edges of the blocks */
+#define ROWS 600
+static const size_t invalid_rows[] = {0, 255, 256, 300, 511, 512, ROWS-1};
+
+static int is_invalid_row(size_t i) {
+    size_t k;
+    for (k = 0; k < sizeof(invalid_rows) / sizeof(invalid_rows[0]); k++)
+        if (invalid_rows[k] == i) return 1;
+    return 0;
+}
+
+static void check_pvalues(void) {
+    static double stats[ROWS], pvals[ROWS];
+    static int row_status[ROWS];
+    double one;
+    size_t i;
+    int s;
+
+    for (i = 0; i < ROWS; i++)
+        stats[i] = is_invalid_row(i) ? (i % 2 ? NAN : -1.0) : fmod(i * 0.37, 30.0);
+    s = fracdist_pvalues(stats, pvals, ROWS, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, row_status);
+    CHECK(s == FRACDIST_INVALID_TEST_STAT, "fracdist_pvalues returned %d, expected %d", s, FRACDIST_INVALID_TEST_STAT);
+    for (i = 0; i < ROWS; i++) {
+        const int expected = is_invalid_row(i) ? FRACDIST_INVALID_TEST_STAT : FRACDIST_OK;
+        CHECK(row_status[i] == expected, "fracdist_pvalues row %zu: status %d, expected %d", i, row_status[i], expected);
+        fracdist_pvalues(&stats[i], &one, 1, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL);
+        CHECK(same(pvals[i], one), "fracdist_pvalues row %zu: %.17g, but %.17g on its own", i, pvals[i], one);
+    }
+
+    /* The same value as `fdpval 1 0.8 1 3.5` */
+    stats[0] = 3.5;
+    s = fracdist_pvalues(stats, pvals, 1, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL);
+    CHECK(s == FRACDIST_OK && fabs(pvals[0] - 0.3637637) < 1e-6, "fracdist_pvalues(3.5): %.17g (%d)", pvals[0], s);
+}
+
+static void check_criticals(void) {
+    static double levels[ROWS], crits[ROWS];
+    static int row_status[ROWS];
+    double one;
+    size_t i;
+    int s;
+
+    for (i = 0; i < ROWS; i++)
+        levels[i] = is_invalid_row(i) ? (i % 2 ? NAN : 1.5) : (i + 1.0) / (ROWS + 1.0);
+    s = fracdist_criticals(levels, crits, ROWS, 2, 1.2, 0, FRACDIST_SPLINE, 9, 0, row_status);
+    CHECK(s == FRACDIST_INVALID_TEST_LEVEL, "fracdist_criticals returned %d, expected %d", s, FRACDIST_INVALID_TEST_LEVEL);
+    for (i = 0; i < ROWS; i++) {
+        const int expected = is_invalid_row(i) ? FRACDIST_INVALID_TEST_LEVEL : FRACDIST_OK;
+        CHECK(row_status[i] == expected, "fracdist_criticals row %zu: status %d, expected %d", i, row_status[i], expected);
+        fracdist_criticals(&levels[i], &one, 1, 2, 1.2, 0, FRACDIST_SPLINE, 9, 0, NULL);
+        CHECK(same(crits[i], one), "fracdist_criticals row %zu: %.17g, but %.17g on its own", i, crits[i], one);
+    }
+}
+
+static void check_handles(void) {
+    static const double levels[] = {0.1, 0.05, 0.01};
+    static double stats[ROWS], pvals[ROWS], expected[ROWS], crits[3], draws[1000], again[1000];
+    static unsigned char codes[ROWS];
+    static int row_status[ROWS];
+    fracdist_distribution *d;
+    fracdist_sampler *s1, *s2;
+    fracdist_decision_rule *rule;
+    size_t i, k;
+    int s;
+
+    d = fracdist_distribution_new(1, 5.0, 1, FRACDIST_JGMMON14, 9, 0, &s);
+    CHECK(!d && s == FRACDIST_INVALID_B, "fracdist_distribution_new with b = 5 gave %p (%d)", (void *) d, s);
+    fracdist_distribution_free(d);
+
+    d = fracdist_distribution_new(3, 0.9, 1, FRACDIST_JGMMON14, 9, 0, &s);
+    CHECK(d && s == FRACDIST_OK, "fracdist_distribution_new failed (%d)", s);
+    if (!d) return;
+
+    for (i = 0; i < ROWS; i++)
+        stats[i] = is_invalid_row(i) ? -1.0 : fmod(i * 0.53, 60.0);
+    s = fracdist_distribution_pvalues(d, stats, pvals, ROWS, NULL);
+    fracdist_pvalues(stats, expected, ROWS, 3, 0.9, 1, FRACDIST_JGMMON14, 9, 0, NULL);
+    CHECK(s == FRACDIST_INVALID_TEST_STAT, "fracdist_distribution_pvalues returned %d", s);
+    for (i = 0; i < ROWS; i++)
+        CHECK(same(pvals[i], expected[i]), "fracdist_distribution_pvalues row %zu: %.17g, expected %.17g", i, pvals[i], expected[i]);
+
+    /* Two samplers with the same seed must give the same draws, all of which are valid statistics */
+    s1 = fracdist_sampler_new(d, 42, &s);
+    s2 = fracdist_sampler_new(d, 42, NULL);
+    CHECK(s1 && s2 && s == FRACDIST_OK, "fracdist_sampler_new failed (%d)", s);
+    if (s1 && s2) {
+        s = fracdist_sampler_fill(s1, draws, 1000);
+        CHECK(s == FRACDIST_OK, "fracdist_sampler_fill returned %d", s);
+        fracdist_sampler_fill(s2, again, 1000);
+        for (i = 0; i < 1000; i++) {
+            CHECK(draws[i] >= 0 && isfinite(draws[i]), "fracdist_sampler_fill draw %zu: %.17g", i, draws[i]);
+            CHECK(draws[i] == again[i], "fracdist_sampler_fill draw %zu: %.17g, but %.17g from the same seed", i, draws[i], again[i]);
+        }
+        CHECK(fracdist_sampler_fill(s1, NULL, 0) == FRACDIST_OK, "fracdist_sampler_fill with n = 0 failed");
+    }
+    fracdist_sampler_free(s1);
+    fracdist_sampler_free(s2);
+
+    /* Each code must be the number of levels whose critical values the statistic exceeds */
+    rule = fracdist_decision_rule_new(d, levels, 3, &s);
+    CHECK(rule && s == FRACDIST_OK, "fracdist_decision_rule_new failed (%d)", s);
+    fracdist_distribution_criticals(d, levels, crits, 3, NULL);
+    if (rule) {
+        s = fracdist_decision_rule_codes(rule, stats, codes, ROWS, row_status);
+        CHECK(s == FRACDIST_INVALID_TEST_STAT, "fracdist_decision_rule_codes returned %d", s);
+        for (i = 0; i < ROWS; i++) {
+            unsigned char code = 0;
+            if (is_invalid_row(i)) code = 255;
+            else for (k = 0; k < 3; k++) if (stats[i] > crits[k]) code = k + 1;
+            CHECK(codes[i] == code, "fracdist_decision_rule_codes row %zu (%.17g): code %u, expected %u", i, stats[i], codes[i], code);
+            CHECK(row_status[i] == (code == 255 ? FRACDIST_INVALID_TEST_STAT : FRACDIST_OK),
+                    "fracdist_decision_rule_codes row %zu: status %d", i, row_status[i]);
+        }
+    }
+    fracdist_decision_rule_free(rule);
+
+    /* Null pointers and invalid interpolation values */
+    CHECK(fracdist_distribution_pvalues(NULL, stats, pvals, 1, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_distribution_pvalues(NULL)");
+    CHECK(fracdist_distribution_pvalues(d, NULL, pvals, 1, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_distribution_pvalues without stats");
+    CHECK(fracdist_distribution_criticals(d, levels, NULL, 3, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_distribution_criticals without output");
+    CHECK(!fracdist_sampler_new(NULL, 42, &s) && s == FRACDIST_INVALID_ARGUMENT, "fracdist_sampler_new(NULL)");
+    CHECK(fracdist_sampler_fill(NULL, draws, 1) == FRACDIST_INVALID_ARGUMENT, "fracdist_sampler_fill(NULL)");
+    CHECK(!fracdist_decision_rule_new(NULL, levels, 3, &s) && s == FRACDIST_INVALID_ARGUMENT, "fracdist_decision_rule_new(NULL)");
+    CHECK(!fracdist_decision_rule_new(d, NULL, 3, &s) && s == FRACDIST_INVALID_ARGUMENT, "fracdist_decision_rule_new without levels");
+    CHECK(fracdist_decision_rule_codes(NULL, stats, codes, 1, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_decision_rule_codes(NULL)");
+    fracdist_distribution_free(d);
+}
+
+static void check_invalid_arguments(void) {
+    double x = 1.0, out;
+    int s;
+
+    CHECK(fracdist_pvalues(NULL, &out, 1, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_pvalues without stats");
+    CHECK(fracdist_pvalues(&x, NULL, 1, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_pvalues without output");
+    CHECK(fracdist_pvalues(NULL, NULL, 0, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL) == FRACDIST_OK, "fracdist_pvalues with n = 0");
+    CHECK(fracdist_pvalues(&x, &out, 1, 1, 0.8, 1, 99, 9, 0, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_pvalues with interpolation 99");
+    CHECK(fracdist_criticals(NULL, &out, 1, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_criticals without levels");
+    CHECK(fracdist_criticals(&x, NULL, 1, 1, 0.8, 1, FRACDIST_JGMMON14, 9, 0, NULL) == FRACDIST_INVALID_ARGUMENT, "fracdist_criticals without output");
+    CHECK(!fracdist_distribution_new(1, 0.8, 1, 99, 9, 0, &s) && s == FRACDIST_INVALID_ARGUMENT, "fracdist_distribution_new with interpolation 99");
+    CHECK(fracdist_status_message(FRACDIST_INVALID_ARGUMENT) != NULL, "fracdist_status_message(FRACDIST_INVALID_ARGUMENT)");
+}
+
+int main(void) {
+    check_pvalues();
+    check_criticals();
+    check_handles();
+    check_invalid_arguments();
+    printf("C interface (fracdist %s): %zu failure%s\n", fracdist_version(), failures, failures == 1 ? "" : "s");
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,1001 @@
+/** @file fracdist_regress.cpp
+ * @brief Checks pvalue_advanced() and critical_advanced() against a frozen corpus of known results,
+ * and measures throughput while doing so.
+ *
+ * The corpus (regress/golden.txt by default) covers every q value, with and without a constant,
+ * every interpolation mode, and b values both on and off the tabulated b grid.  Each line is one of:
+ *
+ *     p Q C INTERP B STAT PVALUE
+ *     c Q C INTERP B LEVEL CRITICAL
+ *
+ * where C is 0 or 1 and INTERP is one of JGMMON14, exact_or_JGMMON14, linear, spline, or
+ * chebyshev; lines starting with # are comments.  Every value is compared to the current
+ * library's result with tolerance `tol * max(1, |expected|)`; the program exits with status 1 if
+ * any value is outside the tolerance.  The p-values from distribution's
+ * pvalue_method::monotone_map, which approximates the regression rather than reproducing it, are
+ * also compared to the corpus, and their largest difference must be within `--map-tolerance`.
+ * Likewise the quantiles of interpolation::chebyshev are compared to those of
+ * interpolation::JGMMON14 over a fine grid of b values, and must be within
+ * fracdist::chebyshev_tolerance.  A NaN b value must be rejected with std::out_of_range (or
+ * status::invalid_b) in every interpolation mode, including by quantile_sweep.  pvalue_surface()
+ * and pvalue_rank_sequence_advanced() must reproduce pvalue_batch() and pvalue_advanced()
+ * exactly, decision_rule's codes must agree with critical_advanced(), and pvalue_panel() must
+ * reproduce the individual p-values up to rounding.  A copy of the q = 12 table added with
+ * add_table() as q = 13 must give the same quantiles and p-values (up to the fit), and a
+ * malformed table file must be rejected.  When fracdist is built with fracdist_STATS, the
+ * instrumentation must count the cache lookups, regressions, and chi-squared evaluations of a
+ * run of p-values exactly.  quantile_sweep must agree with quantiles() up to rounding.  The
+ * closed-form derivatives must agree with central differences, and solve_stat() and solve_b()
+ * must invert pvalue_advanced().  lr_test() must match a direct calculation of a fractional unit
+ * root test, and agree with lr_rank_tests() whatever the number of threads, and lr_bootstrap()
+ * must not depend on the number of threads either.  The inverse cdf table of fracdist::sampler
+ * must pass through the quantiles, and the empirical cdf of its draws must match the tabulated p
+ * values.  The corpus is then evaluated once more while counting heap allocations (which should
+ * be zero: the calculations only use fixed-size storage), and finally re-evaluated `--passes`
+ * times to measure throughput.
+ *
+ * Usage:
+ *
+ *     fracdist_regress [--golden FILE] [--tolerance TOL] [--map-tolerance TOL] [--passes N]
+ *     fracdist_regress --generate FILE
+ *
+ * `--generate` writes a new corpus from the current library; this should only be done when a
+ * change in results is intended (and the change should be reviewed by comparing against the old
+ * corpus first).  The shipped corpus's values for the interpolation modes of fracdist 1.0.4 were
+ * calculated by that release, so the checks also guard against drift since then.
+ */
+#include <fracdist/pvalue.hpp>
+#include <fracdist/critical.hpp>
+#include <fracdist/distribution.hpp>
+#include <fracdist/sampler.hpp>
+#include <fracdist/solve.hpp>
+#include <fracdist/decision.hpp>
+#include <fracdist/lrtest.hpp>
+#include <fracdist/panel.hpp>
+#include <fracdist/stats.hpp>
+#include <fracdist/sweep.hpp>
+#include <fracdist/tables.hpp>
+#include <fracdist/version.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace fracdist;
+
+#ifndef FRACDIST_GOLDEN
+#define FRACDIST_GOLDEN "regress/golden.txt"
+#endif
+
+// Counts calls to the global operator new (which also intercepts allocations made inside the
+// fracdist library) while `count_allocations` is true.
+static bool count_allocations = false;
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    if (count_allocations) allocations++;
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+
+namespace {
+
+struct golden_case {
+    char kind; // 'p' for a p-value, 'c' for a critical value
+    unsigned int q;
+    bool constant;
+    interpolation interp;
+    double b;
+    double x; // The test statistic or test level
+    double expected;
+};
+
+const interpolation all_interps[] = { interpolation::JGMMON14, interpolation::exact_or_JGMMON14, interpolation::linear, interpolation::spline,
+    interpolation::chebyshev };
+
+const char *interp_name(const interpolation &i) {
+    switch (i) {
+        case interpolation::JGMMON14: return "JGMMON14";
+        case interpolation::exact_or_JGMMON14: return "exact_or_JGMMON14";
+        case interpolation::linear: return "linear";
+        case interpolation::spline: return "spline";
+        case interpolation::chebyshev: return "chebyshev";
+    }
+    return "unknown";
+}
+
+bool parse_interp(const std::string &name, interpolation &interp) {
+    for (auto &i : all_interps) {
+        if (name == interp_name(i)) {
+            interp = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns T observations (row-major, as lr_test() takes them) of p independent random walks with
+// uniform increments, from a fixed seed.
+std::vector<double> random_walks(const size_t &T, const size_t &p, const unsigned int &seed) {
+    std::mt19937 rng(seed);
+    std::vector<double> x(T*p);
+    for (size_t t = 0; t < T; t++)
+        for (size_t i = 0; i < p; i++)
+            x[t*p + i] = (t > 0 ? x[(t-1)*p + i] : 0.0) + rng() / 4294967296.0 - 0.5;
+    return x;
+}
+
+double evaluate(const golden_case &c) {
+    return c.kind == 'p'
+        ? pvalue_advanced(c.x, c.q, c.b, c.constant, c.interp, 9)
+        : critical_advanced(c.x, c.q, c.b, c.constant, c.interp, 9);
+}
+
+// Builds the corpus cases (without expected values)
+std::vector<golden_case> corpus_cases() {
+    // b values on the grid (including both ends) and off it
+    const double bs[] = { 0.51, 0.75, 1.0, 1.45, 2.0, 0.537, 0.8123, 1.234, 1.61803, 1.9876 };
+    // Critical value test levels, and the levels at which p-value test statistics are drawn (the
+    // latter intentionally off the tabulated p values)
+    const double levels[] = { 0.0001, 0.001, 0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.9999 };
+    const double stat_levels[] = { 0.0003, 0.0123, 0.0456, 0.111, 0.333, 0.6789, 0.9111, 0.9632, 0.99876 };
+    // Fixed test statistics, including values beyond the ends of the tables
+    const double stats[] = { 0.0, 1e-4, 0.5, 3.0, 25.0, 400.0 };
+
+    std::vector<golden_case> cases;
+    for (unsigned int q = 1; q <= q_length; q++) {
+        for (bool constant : {false, true}) {
+            for (auto &interp : all_interps) {
+                for (auto &b : bs) {
+                    golden_case c = { 'c', q, constant, interp, b, 0, 0 };
+                    for (auto &l : levels) {
+                        c.x = l;
+                        cases.push_back(c);
+                    }
+                    c.kind = 'p';
+                    for (auto &l : stat_levels) {
+                        c.x = critical_advanced(l, q, b, constant, interpolation::JGMMON14, 9);
+                        cases.push_back(c);
+                    }
+                    for (auto &t : stats) {
+                        c.x = t;
+                        cases.push_back(c);
+                    }
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+int generate(const char *filename) {
+    std::vector<golden_case> cases = corpus_cases();
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        fprintf(stderr, "Unable to open %s for writing: %s\n", filename, strerror(errno));
+        return 2;
+    }
+    fprintf(out, "# fracdist regression corpus, generated by fracdist_regress --generate (fracdist %s)\n", version_string);
+    fprintf(out, "# p Q C INTERP B STAT PVALUE\n# c Q C INTERP B LEVEL CRITICAL\n");
+    for (auto &c : cases) {
+        fprintf(out, "%c %u %d %s %.17g %.17g %.17g\n", c.kind, c.q, c.constant ? 1 : 0, interp_name(c.interp), c.b, c.x, evaluate(c));
+    }
+    fclose(out);
+    fprintf(stderr, "Wrote %zu cases to %s\n", cases.size(), filename);
+    return 0;
+}
+
+bool load(const char *filename, std::vector<golden_case> &cases) {
+    std::ifstream in(filename);
+    if (!in) {
+        fprintf(stderr, "Unable to open golden corpus %s\n", filename);
+        return false;
+    }
+    std::string line;
+    size_t lineno = 0;
+    while (std::getline(in, line)) {
+        lineno++;
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        golden_case c;
+        std::string interp;
+        int constant;
+        ss >> c.kind >> c.q >> constant >> interp >> c.b >> c.x >> c.expected;
+        if (!ss || (c.kind != 'p' && c.kind != 'c') || !parse_interp(interp, c.interp)) {
+            fprintf(stderr, "%s:%zu: invalid line: %s\n", filename, lineno, line.c_str());
+            return false;
+        }
+        c.constant = constant != 0;
+        cases.push_back(c);
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    const char *golden = FRACDIST_GOLDEN;
+    double tol = 1e-9, map_tol = 2e-3;
+    unsigned int passes = 5;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--generate") && i+1 < argc) return generate(argv[i+1]);
+        else if (!strcmp(argv[i], "--golden") && i+1 < argc) golden = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i+1 < argc) tol = std::stod(argv[++i]);
+        else if (!strcmp(argv[i], "--map-tolerance") && i+1 < argc) map_tol = std::stod(argv[++i]);
+        else if (!strcmp(argv[i], "--passes") && i+1 < argc) passes = std::stoul(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--golden FILE] [--tolerance TOL] [--map-tolerance TOL] [--passes N]\n"
+                            "       %s --generate FILE\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<golden_case> cases;
+    if (!load(golden, cases)) return 2;
+
+    // Accuracy check
+    size_t failures = 0, count[2] = {0, 0};
+    double maxdiff[2] = {0, 0};
+    for (auto &c : cases) {
+        const int k = c.kind == 'p' ? 0 : 1;
+        count[k]++;
+        double got;
+        try {
+            got = evaluate(c);
+        }
+        catch (std::exception &e) {
+            if (++failures <= 20)
+                printf("FAIL: %c q=%u c=%d %s b=%.17g x=%.17g: threw exception: %s\n",
+                        c.kind, c.q, c.constant, interp_name(c.interp), c.b, c.x, e.what());
+            continue;
+        }
+        double diff = std::isinf(c.expected) && got == c.expected ? 0 : std::fabs(got - c.expected);
+        if (!(diff <= tol * std::max(1.0, std::fabs(c.expected)))) { // NB: also catches NaN
+            if (++failures <= 20)
+                printf("FAIL: %c q=%u c=%d %s b=%.17g x=%.17g: expected %.17g, got %.17g\n",
+                        c.kind, c.q, c.constant, interp_name(c.interp), c.b, c.x, c.expected, got);
+        }
+        if (diff > maxdiff[k] || std::isnan(diff)) maxdiff[k] = diff;
+    }
+    if (failures > 20) printf("... (%zu more failures not shown)\n", failures - 20);
+
+    // The non-throwing variants must give exactly the same values
+    size_t nothrow_mismatches = 0;
+    for (auto &c : cases) {
+        double expect, got;
+        try { expect = evaluate(c); } catch (...) { continue; }
+        status s = c.kind == 'p'
+            ? try_pvalue(got, c.x, c.q, c.b, c.constant, c.interp, 9, 0)
+            : try_critical(got, c.x, c.q, c.b, c.constant, c.interp, 9, 0);
+        if (s != status::ok || !(got == expect || (std::isnan(got) && std::isnan(expect)))) {
+            if (++nothrow_mismatches <= 5)
+                printf("FAIL: %c q=%u c=%d %s b=%.17g x=%.17g: non-throwing version gave %.17g (%s), expected %.17g\n",
+                        c.kind, c.q, c.constant, interp_name(c.interp), c.b, c.x, got, status_message(s), expect);
+        }
+    }
+    failures += nothrow_mismatches;
+
+    // Finite-sample values: T = 0 must give exactly the asymptotic values.  Without response
+    // surface data, every T > 0 calculation must fail (throwing, or with status::no_response_surface);
+    // with it, the quantiles must approach the asymptotic ones as T grows.
+    {
+        size_t rs_failures = 0;
+        for (unsigned int q : {1u, 6u, 12u}) {
+            for (bool constant : {false, true}) {
+                for (double b : {0.51, 0.8123, 1.45, 2.0}) {
+                    const auto asymptotic = quantiles(q, b, constant, interpolation::JGMMON14);
+                    if (quantiles(q, b, constant, interpolation::JGMMON14, 0) != asymptotic && ++rs_failures <= 5)
+                        printf("FAIL: q=%u c=%d b=%.17g: quantiles with T = 0 differ from the asymptotic quantiles\n", q, constant, b);
+                    double p, c;
+                    const status ps = try_pvalue(p, 1.5, q, b, constant, interpolation::JGMMON14, 9, 100),
+                          cs = try_critical(c, 0.05, q, b, constant, interpolation::JGMMON14, 9, 100);
+#if FRACDIST_RESPONSE_SURFACE
+                    const auto large_T = quantiles(q, b, constant, interpolation::JGMMON14, 1000000000);
+                    double maxrel = 0;
+                    for (size_t i = 0; i < p_length; i++)
+                        maxrel = std::max(maxrel, std::fabs(large_T[i] - asymptotic[i]) / std::max(1.0, std::fabs(asymptotic[i])));
+                    if (!(maxrel < 1e-6) && ++rs_failures <= 5)
+                        printf("FAIL: q=%u c=%d b=%.17g: quantiles with T = 1e9 differ from the asymptotic quantiles by %g\n",
+                                q, constant, b, maxrel);
+                    if ((ps != status::ok || p != pvalue(1.5, q, b, constant, 100) || cs != status::ok || c != critical(0.05, q, b, constant, 100))
+                            && ++rs_failures <= 5)
+                        printf("FAIL: q=%u c=%d b=%.17g: T = 100 p-value or critical value failed (%s, %s)\n",
+                                q, constant, b, status_message(ps), status_message(cs));
+#else
+                    bool threw = false;
+                    try { quantiles(q, b, constant, interpolation::JGMMON14, 100); }
+                    catch (std::runtime_error&) { threw = true; }
+                    if ((!threw || ps != status::no_response_surface || !std::isnan(p) || cs != status::no_response_surface || !std::isnan(c))
+                            && ++rs_failures <= 5)
+                        printf("FAIL: q=%u c=%d b=%.17g: T = 100 didn't fail without response surface data\n", q, constant, b);
+#endif
+                }
+            }
+        }
+        printf("Finite-sample values (%s response surface data): %zu failure%s\n", FRACDIST_RESPONSE_SURFACE ? "with" : "without",
+                rs_failures, rs_failures == 1 ? "" : "s");
+        failures += rs_failures;
+    }
+
+    // A NaN b value is invalid in every interpolation mode: the throwing functions must throw
+    // std::out_of_range (rather than returning NaN, or failing later on), and the non-throwing ones
+    // must give status::invalid_b.
+    {
+        size_t nan_failures = 0;
+        for (auto &interp : all_interps) {
+            auto out_of_range = [&](const char *what, const std::function<void()> &f) {
+                std::string error = "nothing";
+                try { f(); }
+                catch (std::out_of_range&) { return; }
+                catch (std::exception &e) { error = e.what(); }
+                if (++nan_failures <= 5)
+                    printf("FAIL: %s %s with a NaN b value threw %s, not std::out_of_range\n", what, interp_name(interp), error.c_str());
+            };
+            out_of_range("quantiles", [&]() { quantiles(1, NAN, false, interp); });
+            out_of_range("quantile_derivatives", [&]() { quantile_derivatives(1, NAN, false, interp); });
+            out_of_range("interpolation_weights", [&]() { interpolation_weights(NAN, interp); });
+            out_of_range("quantile_sweep", [&]() { quantile_sweep sweep(1, false, interp); sweep(1.0); sweep(NAN); });
+            out_of_range("pvalue_advanced", [&]() { pvalue_advanced(3.0, 1, NAN, false, interp, 9); });
+            out_of_range("critical_advanced", [&]() { critical_advanced(0.05, 1, NAN, false, interp, 9); });
+            double p, c;
+            const status ps = try_pvalue(p, 3.0, 1, NAN, false, interp, 9, 0), cs = try_critical(c, 0.05, 1, NAN, false, interp, 9, 0);
+            if ((ps != status::invalid_b || cs != status::invalid_b) && ++nan_failures <= 5)
+                printf("FAIL: %s with a NaN b value: try_pvalue %s, try_critical %s\n", interp_name(interp), status_message(ps), status_message(cs));
+        }
+        printf("NaN b values: %zu failure%s\n", nan_failures, nan_failures == 1 ? "" : "s");
+        failures += nan_failures;
+    }
+
+    // pvalue_surface() must give exactly the same values and statuses as pvalue_batch() on each row,
+    // including for unsorted, repeated, trivial, and invalid statistics and invalid b values
+    {
+        const std::vector<double> b_grid = {0.51, 0.6, 0.77, 1.0, 1.3, 1.75, 2.0, 0.4, 2.5};
+        std::vector<double> stats = {0.0, -1.0, NAN, INFINITY, 1e-3, 1e6, 0.5, 0.5};
+        for (size_t i = 0; i < 200; i++) stats.push_back(std::fmod(i * 7.37, 40.0) + 0.01 * i);
+        const size_t nb = b_grid.size(), ns = stats.size();
+        std::vector<double> surface(nb * ns), row(ns);
+        std::vector<status> surface_status(nb * ns), row_status(ns);
+        size_t surface_mismatches = 0;
+        for (unsigned int q : {1u, 5u, 12u}) {
+            for (bool constant : {false, true}) {
+                for (auto interp : {interpolation::JGMMON14, interpolation::exact_or_JGMMON14, interpolation::spline}) {
+                    for (unsigned int ap : {9u, 13u, 2u}) {
+                        status s = pvalue_surface(b_grid.data(), nb, stats.data(), ns, surface.data(), q, constant, interp, ap, 0, 3,
+                                surface_status.data());
+                        status expect_s = status::ok;
+                        for (size_t i = 0; i < nb; i++) {
+                            status rs = pvalue_batch(stats.data(), row.data(), ns, q, b_grid[i], constant, interp, ap, 0, row_status.data());
+                            if (expect_s == status::ok) expect_s = rs;
+                            for (size_t j = 0; j < ns; j++) {
+                                const double got = surface[i*ns + j];
+                                if (!(got == row[j] || (std::isnan(got) && std::isnan(row[j]))) || surface_status[i*ns + j] != row_status[j]) {
+                                    if (++surface_mismatches <= 5)
+                                        printf("FAIL: surface q=%u c=%d %s approx_points=%u b=%.17g x=%.17g: %.17g (%s), expected %.17g (%s)\n",
+                                                q, constant, interp_name(interp), ap, b_grid[i], stats[j], got,
+                                                status_message(surface_status[i*ns + j]), row[j], status_message(row_status[j]));
+                                }
+                            }
+                        }
+                        if (s != expect_s && ++surface_mismatches <= 5)
+                            printf("FAIL: surface q=%u c=%d %s approx_points=%u returned %s, expected %s\n",
+                                    q, constant, interp_name(interp), ap, status_message(s), status_message(expect_s));
+                    }
+                }
+            }
+        }
+        printf("P-value surfaces: %zu mismatch%s against pvalue_batch()\n", surface_mismatches, surface_mismatches == 1 ? "" : "es");
+        failures += surface_mismatches;
+    }
+
+    // pvalue_rank_sequence_advanced() must give exactly the same values as pvalue_advanced() for
+    // every q value and interpolation mode, and reject a NaN statistic like a negative one
+    {
+        std::vector<double> stats;
+        for (size_t k = 0; k < q_length; k++) stats.push_back(k == 0 ? 0.0 : k == 1 ? INFINITY : std::fmod(k * 7.37, 40.0) + 0.5);
+        size_t rank_mismatches = 0;
+        for (bool constant : {false, true}) {
+            for (auto &interp : all_interps) {
+                for (double b : {0.51, 0.77, 1.0, 1.3, 2.0}) {
+                    const std::vector<double> got = pvalue_rank_sequence_advanced(stats, b, constant, interp, 9);
+                    for (size_t k = 0; k < q_length; k++) {
+                        const double expected = pvalue_advanced(stats[k], k+1, b, constant, interp, 9);
+                        if (got[k] != expected && ++rank_mismatches <= 5)
+                            printf("FAIL: rank sequence q=%zu c=%d %s b=%.17g x=%.17g: %.17g, expected %.17g\n",
+                                    k+1, constant, interp_name(interp), b, stats[k], got[k], expected);
+                    }
+                }
+            }
+        }
+        std::vector<double> nan_stats = stats;
+        nan_stats[3] = NAN;
+        std::string error = "nothing";
+        try { pvalue_rank_sequence_advanced(nan_stats, 1.0, true, interpolation::JGMMON14, 9); }
+        catch (std::out_of_range&) { error.clear(); }
+        catch (std::exception &e) { error = e.what(); }
+        if (!error.empty() && ++rank_mismatches <= 5)
+            printf("FAIL: rank sequence with a NaN statistic threw %s, not std::out_of_range\n", error.c_str());
+        printf("Rank sequences: %zu mismatch%s against pvalue_advanced()\n", rank_mismatches, rank_mismatches == 1 ? "" : "es");
+        failures += rank_mismatches;
+    }
+
+    // A copy of the q = 12 table added as q = 13 must give the same quantiles and, since the
+    // chi-squared regression only differs in its degrees of freedom, p-values equal up to the fit.
+    // A table is only available for the constant setting it was added for, and a malformed table
+    // file must give std::runtime_error (or status::table_error).
+    {
+        const double tables_tol = 1e-6;
+        size_t table_failures = 0;
+        quantile_table copy;
+        const std::array<double, p_length> *rows = table(q_length, true);
+        std::copy(rows, rows + b_length, copy.begin());
+        add_table(q_length + 1, true, copy);
+        if (!have_table(q_length + 1, true) || have_table(q_length + 1, false)) {
+            table_failures++;
+            printf("FAIL: have_table(%zu) with a table added only with a constant: %d (constant), %d (no constant)\n", q_length + 1,
+                    have_table(q_length + 1, true), have_table(q_length + 1, false));
+        }
+        double maxdiff_tables = 0;
+        for (auto &interp : all_interps) {
+            for (double b : {0.51, 0.77, 1.0, 1.3, 2.0}) {
+                const std::array<double, p_length> expected = quantiles(q_length, b, true, interp);
+                if (quantiles(q_length + 1, b, true, interp) != expected && ++table_failures <= 5)
+                    printf("FAIL: added table %s b=%.17g: quantiles differ from q=%zu\n", interp_name(interp), b, q_length);
+                for (size_t i = 0; i < p_length; i += 10) {
+                    const double x = expected[i];
+                    const double diff = std::fabs(pvalue_advanced(x, q_length + 1, b, true, interp, 9) - pvalue_advanced(x, q_length, b, true, interp, 9));
+                    if (diff > maxdiff_tables) maxdiff_tables = diff;
+                    if (diff > tables_tol && ++table_failures <= 5)
+                        printf("FAIL: added table %s b=%.17g x=%.17g: p-value differs from q=%zu by %g\n", interp_name(interp), b, x, q_length, diff);
+                }
+            }
+        }
+
+        const char *malformed = "frmapp14.txt";
+        {
+            std::ofstream out(malformed);
+            out << "b: 0.51\n0.0001 not-a-number\n";
+        }
+        set_table_directory(".");
+        if (have_table(15, false)) {
+            table_failures++;
+            printf("FAIL: have_table(15) without a table file returned true\n");
+        }
+        std::string error = "nothing";
+        try { pvalue(3.0, 14, 1.0, false); }
+        catch (std::runtime_error&) { error.clear(); }
+        catch (std::exception &e) { error = e.what(); }
+        if (!error.empty()) {
+            table_failures++;
+            printf("FAIL: pvalue with a malformed table file threw %s, not std::runtime_error\n", error.c_str());
+        }
+        double p;
+        const status ps = try_pvalue(p, 3.0, 14, 1.0, false, interpolation::JGMMON14, 9, 0);
+        if (ps != status::table_error) {
+            table_failures++;
+            printf("FAIL: try_pvalue with a malformed table file gave %s, not %s\n", status_message(ps), status_message(status::table_error));
+        }
+        set_table_directory("");
+        std::remove(malformed);
+        printf("Tables: added table p-values within %.3g of q=%zu (tolerance %g), %zu failure%s\n", maxdiff_tables, q_length, tables_tol,
+                table_failures, table_failures == 1 ? "" : "s");
+        failures += table_failures;
+    }
+
+    // When built with fracdist_STATS, a run of p-values at the same parameters must count one
+    // quantile cache miss followed by hits, one regression per p-value, 9 inverse chi-squared lookups
+    // per regression (with the calculated ones timed as chi-squared evaluations), and one upper tail
+    // cdf evaluation per p-value.
+    if (stats_enabled()) {
+        const size_t calls = 25;
+        size_t stats_failures = 0;
+        // Statistics near interior quantiles, so that every regression has all 9 points (these
+        // linear quantiles also leave a different set of quantiles in the cache)
+        const std::array<double, p_length> near = quantiles(2, 1.2345, true, interpolation::linear);
+        reset_stats();
+        for (size_t i = 0; i < calls; i++) pvalue_advanced(near[20 + 7*i], 2, 1.2345, true, interpolation::JGMMON14, 9);
+        const stats_snapshot st = stats();
+        auto expect = [&](const char *what, const uint64_t &got, const uint64_t &expected) {
+            if (got != expected) {
+                stats_failures++;
+                printf("FAIL: stats %s: %llu, expected %llu\n", what, (unsigned long long) got, (unsigned long long) expected);
+            }
+        };
+        expect("qcache_misses", st.qcache_misses, 1);
+        expect("qcache_hits", st.qcache_hits, calls - 1);
+        expect("quantiles_interpolation.calls", st.quantiles_interpolation.calls, 1);
+        expect("pvalue_regression.calls", st.pvalue_regression.calls, calls);
+        expect("chisq cache lookups", st.chisq_cache_hits + st.chisq_cache_misses, 9 * calls);
+        expect("chisq.calls", st.chisq.calls, st.chisq_cache_misses + calls);
+        printf("Stats: %llu chi-squared evaluations for %zu p-values, %zu failure%s\n", (unsigned long long) st.chisq.calls, calls,
+                stats_failures, stats_failures == 1 ? "" : "s");
+        failures += stats_failures;
+    }
+
+    printf("Checked %zu p-values and %zu critical values against %s\n", count[0], count[1], golden);
+    printf("Maximum absolute difference: %.3g (p-values), %.3g (critical values)\n", maxdiff[0], maxdiff[1]);
+    printf("%zu failure%s (tolerance %g)\n", failures, failures == 1 ? "" : "s", tol);
+
+    // pvalue_method::monotone_map approximates the regression p-values rather than reproducing them,
+    // so just measure (and bound) how far it is from the corpus values.
+    {
+        // Reassigned (rather than reallocated) for each new set of parameters
+        distribution d(1, bvalues.front(), false);
+        bool have_d = false;
+        double map_max = 0, map_sumsq = 0, worst_x = 0;
+        const golden_case *worst = nullptr;
+        size_t map_count = 0;
+        for (auto &c : cases) {
+            if (c.kind != 'p') continue;
+            if (!have_d || d.q() != c.q || d.b() != c.b || d.constant() != c.constant || d.interp() != c.interp) {
+                d = distribution(c.q, c.b, c.constant, c.interp, 9, 0, pvalue_method::monotone_map);
+                have_d = true;
+            }
+            const double diff = std::fabs(d.pvalue(c.x) - c.expected);
+            if (!(diff <= map_max)) { map_max = diff; worst = &c; worst_x = c.x; }
+            map_sumsq += diff * diff;
+            map_count++;
+        }
+        const bool map_fail = !(map_max <= map_tol);
+        printf("Monotone map p-values: maximum absolute difference %.3g, RMS %.3g (tolerance %g)%s\n",
+                map_max, map_count ? std::sqrt(map_sumsq / map_count) : 0.0, map_tol, map_fail ? " FAIL" : "");
+        if (worst && map_fail)
+            printf("    largest difference at q=%u c=%d %s b=%.17g x=%.17g\n",
+                    worst->q, worst->constant, interp_name(worst->interp), worst->b, worst_x);
+        if (map_fail) failures++;
+    }
+
+    // pvalue_panel() over every JGMMON14 corpus p-value (in reverse, so that the series are out of
+    // order), plus a few series with non-finite b values, must reproduce try_pvalue() up to the
+    // rounding error of its quantile_sweep (and the statuses exactly); the Simes p-value must be the
+    // smallest BH adjusted p-value.
+    {
+        const double panel_tol = 1e-11;
+        std::vector<panel_series> series;
+        for (auto it = cases.rbegin(); it != cases.rend(); ++it) {
+            if (it->kind == 'p' && it->interp == interpolation::JGMMON14)
+                series.push_back(panel_series{it->q, it->b, it->constant, it->x});
+            if (it == cases.rbegin() + 100)
+                for (double b : {(double) NAN, (double) INFINITY, 0.75, (double) NAN}) series.push_back(panel_series{2, b, true, 3.0});
+        }
+        panel_result result;
+        pvalue_panel(series.data(), series.size(), result, interpolation::JGMMON14, 9, 0, 3);
+        size_t panel_mismatches = 0;
+        double min_adjusted = INFINITY;
+        for (size_t i = 0; i < series.size(); i++) {
+            const panel_series &s = series[i];
+            double expect;
+            const status st = try_pvalue(expect, s.test_stat, s.q, s.b, s.constant, interpolation::JGMMON14, 9, 0);
+            const double got = result.pvalues[i];
+            // (Compared on a log scale, since the extrapolation beyond the largest quantile magnifies
+            // the relative rounding error of tiny p-values.)
+            const bool close = got == expect || std::fabs(std::log(got / expect)) <= panel_tol * std::max(1.0, std::fabs(std::log(expect)));
+            if (st != result.row_status[i] || !(close || (std::isnan(got) && std::isnan(expect)))) {
+                if (++panel_mismatches <= 5)
+                    printf("FAIL: panel q=%u c=%d b=%.17g x=%.17g: %.17g (%s), expected %.17g (%s)\n", s.q, s.constant, s.b,
+                            s.test_stat, got, status_message(result.row_status[i]), expect, status_message(st));
+            }
+            if (result.row_status[i] == status::ok) min_adjusted = std::min(min_adjusted, result.bh_adjusted[i]);
+        }
+        if (result.simes_pvalue != min_adjusted && ++panel_mismatches <= 5)
+            printf("FAIL: panel Simes p-value %.17g differs from the smallest BH adjusted p-value %.17g\n", result.simes_pvalue, min_adjusted);
+        printf("Panel: %zu series, %zu mismatch%s against try_pvalue() (tolerance %g); Fisher p-value %.3g, Simes p-value %.3g\n",
+                series.size(), panel_mismatches, panel_mismatches == 1 ? "" : "es", panel_tol, result.fisher_pvalue, result.simes_pvalue);
+        failures += panel_mismatches;
+    }
+
+    // decision_rule's codes must count the conventional levels whose critical_advanced() value each
+    // corpus statistic exceeds
+    {
+        const std::vector<double> levels = {0.01, 0.1, 0.05};
+        decision_rule rule(distribution(1, bvalues.front(), false), levels);
+        bool have_rule = false;
+        std::vector<double> crits;
+        size_t decision_mismatches = 0;
+        for (auto &c : cases) {
+            if (c.kind != 'p') continue;
+            const distribution &d = rule.dist();
+            if (!have_rule || d.q() != c.q || d.b() != c.b || d.constant() != c.constant || d.interp() != c.interp) {
+                rule = decision_rule(distribution(c.q, c.b, c.constant, c.interp), levels);
+                have_rule = true;
+                crits.clear();
+                for (auto &l : levels) crits.push_back(critical_advanced(l, c.q, c.b, c.constant, c.interp, 9));
+            }
+            unsigned int expect = 0;
+            for (auto &crit : crits) expect += c.x > crit;
+            const unsigned int got = rule.code(c.x);
+            if (got != expect && ++decision_mismatches <= 5)
+                printf("FAIL: decision q=%u c=%d %s b=%.17g x=%.17g: code %u, expected %u\n",
+                        c.q, c.constant, interp_name(c.interp), c.b, c.x, got, expect);
+        }
+        printf("Decision codes: %zu mismatch%s against critical_advanced()\n", decision_mismatches, decision_mismatches == 1 ? "" : "es");
+        failures += decision_mismatches;
+    }
+
+    // The closed-form derivatives of quantile_derivatives() and pvalue_with_derivatives() must agree
+    // with central differences at every corpus b value and p-value statistic.  Central differences
+    // can't be taken at the ends of the b range; at the tabulated b values and the points 0.2 from
+    // them the linear and exact_or_JGMMON14 quantiles have kinks or jumps, and the chebyshev
+    // expansions meet, so those are only checked for JGMMON14 and spline (where the closed form is
+    // the average of the one-sided derivatives).  A p-value difference that crosses a change in the
+    // quantiles used by the local regression (detected by the one-sided differences disagreeing)
+    // is skipped.
+    {
+        const double h = 1e-7, deriv_tol = 1e-4;
+        size_t deriv_failures = 0, deriv_checked = 0, deriv_skipped = 0;
+        double deriv_max = 0;
+        auto check = [&](const double &numeric, const double &closed, const double &scale, const golden_case &c, const char *what) {
+            const double err = std::fabs(numeric - closed) / std::max(scale, std::fabs(closed));
+            deriv_max = std::max(deriv_max, err);
+            if (!(err <= deriv_tol) && ++deriv_failures <= 5)
+                printf("FAIL: derivative %s q=%u c=%d %s b=%.17g x=%.17g: %.17g, central difference %.17g\n",
+                        what, c.q, c.constant, interp_name(c.interp), c.b, c.x, closed, numeric);
+        };
+        const golden_case *last = nullptr;
+        for (auto &c : cases) {
+            if (c.kind != 'p' || c.b == bvalues.front() || c.b == bvalues.back()) continue;
+            bool kink = false;
+            for (auto &bv : bvalues)
+                if (std::fabs(c.b - bv) < 1e-9 || std::fabs(std::fabs(c.b - bv) - 0.2) < 1e-9) kink = true;
+            if (kink && c.interp != interpolation::JGMMON14 && c.interp != interpolation::spline) continue;
+
+            if (!last || last->q != c.q || last->constant != c.constant || last->interp != c.interp || last->b != c.b) {
+                last = &c;
+                const auto closed = quantile_derivatives(c.q, c.b, c.constant, c.interp);
+                const auto lo = quantiles(c.q, c.b - h, c.constant, c.interp), hi = quantiles(c.q, c.b + h, c.constant, c.interp);
+                for (size_t i = 0; i < p_length; i++) {
+                    check((hi[i] - lo[i]) / (2*h), closed[i], 1.0, c, "quantile");
+                    deriv_checked++;
+                }
+            }
+
+            const double hs = 1e-6 * std::max(1.0, c.x);
+            if (!(c.x > hs)) continue;
+            const pvalue_derivatives closed = pvalue_with_derivatives(c.x, c.q, c.b, c.constant, c.interp, 9);
+            const double p0 = pvalue_advanced(c.x, c.q, c.b, c.constant, c.interp, 9),
+                  up = pvalue_advanced(c.x + hs, c.q, c.b, c.constant, c.interp, 9),
+                  down = pvalue_advanced(c.x - hs, c.q, c.b, c.constant, c.interp, 9);
+            const double forward = (up - p0) / hs, backward = (p0 - down) / hs;
+            if (std::fabs(forward - backward) > 1e-3 * std::max(1e-3, std::fabs(forward + backward) / 2)) {
+                deriv_skipped++;
+                continue;
+            }
+            check((up - down) / (2*hs), closed.dstat, 1e-3, c, "dstat");
+            check((pvalue_advanced(c.x, c.q, c.b + h, c.constant, c.interp, 9) - pvalue_advanced(c.x, c.q, c.b - h, c.constant, c.interp, 9)) / (2*h),
+                    closed.db, 1e-3, c, "db");
+            deriv_checked += 2;
+        }
+        printf("Derivatives: %zu checked against central differences (%zu p-values skipped at a regression change), "
+                "maximum relative difference %.3g, %zu failure%s (tolerance %g)\n",
+                deriv_checked, deriv_skipped, deriv_max, deriv_failures, deriv_failures == 1 ? "" : "s", deriv_tol);
+        failures += deriv_failures;
+    }
+
+    // solve_stat() and solve_b() must invert pvalue_advanced(): the statistic found for a level must
+    // have that p-value, and solve_b() for that statistic and level must find a b value at which it
+    // does.  Where the p-value jumps across the level (at a change in the quantiles used by the local
+    // regression, between a statistic of 0 and the smallest positive ones for levels very close to
+    // 1, or at the tabulated b values for exact_or_JGMMON14), the solution must be at the jump
+    // instead.  solve_b() is only checked from b values inside the b range: from one at either end,
+    // whether the p-value reaches the level comes down to the rounding of the statistic.
+    {
+        const double solve_tol = 1e-9;
+        size_t solve_failures = 0, solve_checked = 0, solve_jumps = 0;
+        auto p_at = [](const double &x, const unsigned int &q, const double &b, const bool &constant, const interpolation &interp) {
+            return pvalue_advanced(std::max(0.0, x), q, b, constant, interp, 9);
+        };
+        for (unsigned int q : {1u, 4u, 12u}) {
+            for (bool constant : {false, true}) {
+                for (auto interp : {interpolation::JGMMON14, interpolation::exact_or_JGMMON14, interpolation::linear,
+                        interpolation::spline, interpolation::chebyshev}) {
+                    for (double b : {0.51, 0.83, 1.0, 1.37, 2.0}) {
+                        for (double level : {1e-6, 1e-4, 0.01, 0.05, 0.38243, 0.5, 0.9, 0.99, 0.9999, 0.99999}) {
+                            solve_checked++;
+                            const char *fail = nullptr;
+                            double x = NAN, got = NAN;
+                            try {
+                                x = solve_stat(level, q, b, constant, interp, 9);
+                                got = p_at(x, q, b, constant, interp);
+                                if (!(std::fabs(got - level) <= solve_tol)) {
+                                    const double dx = solve_tol * std::max(1.0, x);
+                                    if (p_at(x - dx, q, b, constant, interp) >= level && p_at(x + dx, q, b, constant, interp) <= level)
+                                        solve_jumps++;
+                                    else
+                                        fail = "solve_stat";
+                                }
+                                else if (b != bvalues.front() && b != bvalues.back()) {
+                                    const double bs = solve_b(x, level, q, constant, interp, 9);
+                                    got = p_at(x, q, bs, constant, interp);
+                                    if (!(std::fabs(got - level) <= solve_tol)) {
+                                        const double below = p_at(x, q, std::max(bvalues.front(), bs - solve_tol), constant, interp),
+                                              above = p_at(x, q, std::min(bvalues.back(), bs + solve_tol), constant, interp);
+                                        if (std::min({below, got, above}) <= level && std::max({below, got, above}) >= level)
+                                            solve_jumps++;
+                                        else
+                                            fail = "solve_b";
+                                    }
+                                    solve_checked++;
+                                }
+                            }
+                            catch (std::exception &e) {
+                                fail = e.what();
+                            }
+                            if (fail && ++solve_failures <= 5)
+                                printf("FAIL: %s q=%u c=%d %s b=%.17g level=%.17g: statistic %.17g, p-value %.17g\n",
+                                        fail, q, constant, interp_name(interp), b, level, x, got);
+                        }
+                    }
+                }
+            }
+        }
+        printf("Solvers: %zu round trips checked (%zu at a p-value jump), %zu failure%s (tolerance %g)\n",
+                solve_checked, solve_jumps, solve_failures, solve_failures == 1 ? "" : "s", solve_tol);
+        failures += solve_failures;
+    }
+
+    // lr_test() for one series without a constant against a direct calculation: at each (d, b) the
+    // reduced rank regression of Z0 = Delta^d X on Z1 = Delta^{d-b} X - Delta^d X is a scalar
+    // regression with squared correlation lambda = S01^2 / (S00 S11), and the rank 0 and rank 1
+    // profile log-likelihoods are -T/2 log S00 and -T/2 (log S00 + log(1 - lambda)).  Then, for
+    // three series with a constant, every lr_test() rank must match lr_rank_tests(), and the
+    // results must be identical with one thread and with several.
+    {
+        const double lr_tol = 1e-9;
+        size_t lr_failures = 0;
+        lr_options opt;
+        opt.d_min = opt.b_min = 0.6;
+        opt.d_max = opt.b_max = 1.2;
+        opt.step = 0.05;
+
+        const size_t T = 200;
+        const std::vector<double> x = random_walks(T, 1, 1);
+        auto filter = [&](const double &e) {
+            std::vector<double> pi(T), y(T, 0.0);
+            pi[0] = 1.0;
+            for (size_t j = 1; j < T; j++) pi[j] = pi[j-1] * (j - 1.0 - e) / j;
+            for (size_t t = 0; t < T; t++)
+                for (size_t j = 0; j <= t; j++) y[t] += pi[j] * x[t-j];
+            return y;
+        };
+        double best0 = -INFINITY, best1 = -INFINITY, best_d = 0, best_b = 0;
+        for (size_t i = 0; opt.d_min + i*opt.step <= opt.d_max + 1e-9 * opt.step; i++) {
+            const double d = opt.d_min + i*opt.step;
+            const std::vector<double> z0 = filter(d);
+            for (size_t j = 0; opt.b_min + j*opt.step <= d + 1e-9 * opt.step; j++) {
+                const double b = opt.b_min + j*opt.step;
+                const std::vector<double> fe = filter(d - b);
+                double s00 = 0, s01 = 0, s11 = 0;
+                for (size_t t = 0; t < T; t++) {
+                    const double z1 = fe[t] - z0[t];
+                    s00 += z0[t] * z0[t] / T;
+                    s01 += z0[t] * z1 / T;
+                    s11 += z1 * z1 / T;
+                }
+                const double ll0 = -0.5 * T * std::log(s00), ll1 = ll0 - 0.5 * T * std::log(1 - s01 * s01 / (s00 * s11));
+                best0 = std::max(best0, ll0);
+                if (ll1 > best1) { best1 = ll1; best_d = d; best_b = b; }
+            }
+        }
+        const double expect_stat = 2 * (best1 - best0);
+        const lr_result unit = lr_test(x, 1, 0, false, opt);
+        if (!(std::fabs(unit.statistic - expect_stat) <= lr_tol * std::max(1.0, expect_stat)) || unit.d != best_d || unit.b != best_b ||
+                !(std::fabs(unit.pvalue - pvalue_advanced(expect_stat, 1, best_b, false, interpolation::JGMMON14, 9)) <= lr_tol)) {
+            lr_failures++;
+            printf("FAIL: lr_test unit root: statistic %.17g, d %g, b %g, p-value %.17g; expected %.17g, %g, %g\n",
+                    unit.statistic, unit.d, unit.b, unit.pvalue, expect_stat, best_d, best_b);
+        }
+
+        const std::vector<double> x3 = random_walks(150, 3, 2);
+        opt.d_min = opt.b_min = 0.6;
+        opt.d_max = opt.b_max = 1.4;
+        opt.step = 0.1;
+        opt.threads = 1;
+        const std::vector<lr_result> serial = lr_rank_tests(x3, 3, true, opt);
+        opt.threads = 4;
+        const std::vector<lr_result> threaded = lr_rank_tests(x3, 3, true, opt);
+        auto same = [](const lr_result &a, const lr_result &b) {
+            return a.statistic == b.statistic && a.rank == b.rank && a.q == b.q && a.d == b.d && a.b == b.b && a.d_null == b.d_null &&
+                a.b_null == b.b_null && a.pvalue == b.pvalue;
+        };
+        for (unsigned int r = 0; r < 3; r++) {
+            if (!same(serial[r], threaded[r]) && ++lr_failures <= 5)
+                printf("FAIL: lr_rank_tests rank %u: statistic %.17g with 1 thread, %.17g with 4\n", r, serial[r].statistic, threaded[r].statistic);
+            const lr_result single = lr_test(x3, 3, r, true, opt);
+            if (!same(single, threaded[r]) && ++lr_failures <= 5)
+                printf("FAIL: lr_test rank %u: statistic %.17g, lr_rank_tests %.17g\n", r, single.statistic, threaded[r].statistic);
+        }
+        printf("LR tests: unit root statistic %.6g (d %g, b %g), %zu failure%s (tolerance %g)\n", unit.statistic, unit.d, unit.b,
+                lr_failures, lr_failures == 1 ? "" : "s", lr_tol);
+        failures += lr_failures;
+    }
+
+    // lr_bootstrap() must give the same result for a given seed whatever the number of threads, use
+    // every replication of a regular fit, and give a p-value in [1/(B+1), 1]; a fit whose bootstrap
+    // samples are all zero (so every replication is skipped) must throw.
+    {
+        size_t boot_failures = 0;
+        const std::vector<double> x = random_walks(120, 2, 3);
+        const lr_fit fit = lr_estimate(x, 2, 1, true, 1.0, 0.9);
+        bootstrap_options bopt;
+        bopt.replications = 99;
+        bopt.threads = 1;
+        const bootstrap_result serial = lr_bootstrap(fit, bopt);
+        bopt.threads = 4;
+        const bootstrap_result threaded = lr_bootstrap(fit, bopt);
+        if (serial.statistic != threaded.statistic || serial.pvalue != threaded.pvalue || serial.replications != threaded.replications ||
+                serial.asymptotic_pvalue != threaded.asymptotic_pvalue) {
+            boot_failures++;
+            printf("FAIL: lr_bootstrap p-value %.17g (%u replications) with 1 thread, %.17g (%u) with 4\n",
+                    serial.pvalue, serial.replications, threaded.pvalue, threaded.replications);
+        }
+        if (threaded.replications != bopt.replications) {
+            boot_failures++;
+            printf("FAIL: lr_bootstrap used %u of %u replications\n", threaded.replications, bopt.replications);
+        }
+        if (!(threaded.pvalue >= 1.0 / (threaded.replications + 1) && threaded.pvalue <= 1)) {
+            boot_failures++;
+            printf("FAIL: lr_bootstrap p-value %.17g outside [1/(B+1), 1]\n", threaded.pvalue);
+        }
+
+        lr_fit zero = fit;
+        std::fill(zero.alpha.begin(), zero.alpha.end(), 0.0);
+        std::fill(zero.residuals.begin(), zero.residuals.end(), 0.0);
+        bool threw = false;
+        try { lr_bootstrap(zero, bopt); }
+        catch (std::runtime_error&) { threw = true; }
+        if (!threw) {
+            boot_failures++;
+            printf("FAIL: lr_bootstrap with every replication singular didn't throw\n");
+        }
+        printf("Bootstrap: statistic %.6g, p-value %.6g (%u replications, asymptotic %.6g), %zu failure%s\n", threaded.statistic,
+                threaded.pvalue, threaded.replications, threaded.asymptotic_pvalue, boot_failures, boot_failures == 1 ? "" : "s");
+        failures += boot_failures;
+    }
+
+    // interpolation::chebyshev approximates JGMMON14 to a documented tolerance; check it on a finer
+    // b grid than the one the fit was checked on.  Its interpolation_weights() must also reproduce
+    // its quantiles, up to rounding.
+    {
+        const double weights_tol = 1e-12;
+        double cheb_max = 0, weights_max = 0, worst_b = 0;
+        std::array<double, p_length> weighted;
+        unsigned int worst_q = 0;
+        bool worst_constant = false;
+        for (unsigned int q = 1; q <= q_length; q++) {
+            for (bool constant : {false, true}) {
+                for (unsigned int k = 0; k <= 1490; k++) {
+                    const double b = k == 1490 ? bvalues.back() : bvalues.front() + k * 0.001;
+                    const auto approx = quantiles<interpolation::chebyshev>(q, b, constant);
+                    const auto exact = quantiles<interpolation::JGMMON14>(q, b, constant);
+                    apply_weights(interpolation_weights(b, interpolation::chebyshev), table(q, constant), weighted);
+                    for (size_t i = 0; i < p_length; i++) {
+                        const double diff = std::fabs(approx[i] - exact[i]) / std::max(1.0, std::fabs(exact[i]));
+                        if (!(diff <= cheb_max)) { cheb_max = diff; worst_q = q; worst_constant = constant; worst_b = b; }
+                        weights_max = std::max(weights_max, std::fabs(weighted[i] - approx[i]) / std::max(1.0, std::fabs(approx[i])));
+                    }
+                }
+            }
+        }
+        const bool cheb_fail = !(cheb_max <= chebyshev_tolerance);
+        printf("Chebyshev quantiles: maximum relative difference from JGMMON14 %.3g (tolerance %g)%s\n",
+                cheb_max, chebyshev_tolerance, cheb_fail ? " FAIL" : "");
+        if (cheb_fail)
+            printf("    largest difference at q=%u c=%d b=%.17g\n", worst_q, worst_constant, worst_b);
+        if (cheb_fail) failures++;
+        const bool weights_fail = !(weights_max <= weights_tol);
+        printf("Chebyshev interpolation weights: maximum relative difference from the quantiles %.3g (tolerance %g)%s\n",
+                weights_max, weights_tol, weights_fail ? " FAIL" : "");
+        if (weights_fail) failures++;
+    }
+
+    // quantile_sweep solves the JGMMON14 regressions differently from quantiles(), so must agree
+    // with it only up to rounding; sweep a fine b grid (with a jump back part way through, and one
+    // over more than the regression window).
+    {
+        const double sweep_tol = 1e-11;
+        double sweep_max = 0, worst_b = 0;
+        unsigned int worst_q = 0;
+        for (unsigned int q = 1; q <= q_length; q++) {
+            for (bool constant : {false, true}) {
+                for (auto interp : {interpolation::JGMMON14, interpolation::exact_or_JGMMON14}) {
+                    quantile_sweep sweep(q, constant, interp);
+                    std::vector<double> bs;
+                    for (unsigned int k = 0; k <= 1490; k++) bs.push_back(k == 1490 ? bvalues.back() : bvalues.front() + k * 0.001);
+                    bs.insert(bs.begin() + 700, {0.9, 0.6, 1.7});
+                    for (const double &b : bs) {
+                        const auto &got = sweep(b);
+                        const auto expect = quantiles(q, b, constant, interp);
+                        for (size_t i = 0; i < p_length; i++) {
+                            const double diff = std::fabs(got[i] - expect[i]) / std::max(1.0, std::fabs(expect[i]));
+                            if (!(diff <= sweep_max)) { sweep_max = diff; worst_q = q; worst_b = b; }
+                        }
+                    }
+                }
+            }
+        }
+        const bool sweep_fail = !(sweep_max <= sweep_tol);
+        printf("Quantile sweep: maximum relative difference from quantiles() %.3g (tolerance %g)%s\n",
+                sweep_max, sweep_tol, sweep_fail ? " FAIL" : "");
+        if (sweep_fail) printf("    largest difference at q=%u b=%.17g\n", worst_q, worst_b);
+        if (sweep_fail) failures++;
+    }
+
+    // sampler's inverse cdf passes through the quantiles at the tabulated p values, so the fraction
+    // of its draws at or below each quantile should be the tabulated p value, up to sampling error.
+    // (The seed is fixed, so the check is deterministic; the bound on the largest z statistic over
+    // all of the p values and distributions is loose enough for correct draws to pass.)
+    {
+        const size_t m = 200000;
+        const double z_tol = 5;
+        std::vector<double> draws(m);
+        double knot_max = 0, z_max = 0;
+        for (unsigned int q : {1u, 4u, 12u}) {
+            for (bool constant : {false, true}) {
+                for (double b : {0.51, 0.83, 2.0}) {
+                    const distribution d(q, b, constant);
+                    sampler s(d, 12345);
+                    s.fill(draws.data(), m);
+                    std::sort(draws.begin(), draws.end());
+                    for (size_t i = 0; i < p_length; i++) {
+                        const double quant = d.quantiles()[i];
+                        const double expect = quant < 0 ? 0.0 : quant;
+                        knot_max = std::max(knot_max, std::fabs(s.inverse_cdf(pvalues[i]) - expect) / std::max(1.0, expect));
+                        if (quant <= 0) continue;
+                        const double frac = (std::upper_bound(draws.begin(), draws.end(), quant) - draws.begin()) / (double) m;
+                        z_max = std::max(z_max, std::fabs(frac - pvalues[i]) / std::sqrt(pvalues[i] * (1 - pvalues[i]) / m));
+                    }
+                }
+            }
+        }
+        const bool sampler_fail = !(knot_max <= tol) || !(z_max <= z_tol);
+        printf("Sampler: maximum difference from the quantiles %.3g (tolerance %g); largest draw cdf z statistic %.3g (tolerance %g)%s\n",
+                knot_max, tol, z_max, z_tol, sampler_fail ? " FAIL" : "");
+        if (sampler_fail) failures++;
+    }
+
+    // Allocation check (the accuracy check above has already filled the library's caches)
+    allocations = 0;
+    count_allocations = true;
+    double sum = 0;
+    for (auto &c : cases) {
+        try { sum += evaluate(c); } catch (...) {}
+    }
+    count_allocations = false;
+    printf("Heap allocations during a corpus pass: %zu%s\n", allocations, allocations > 0 ? " (FAIL: should be 0)" : "");
+    if (allocations > 0) failures++;
+
+    // Throughput
+    typedef std::chrono::steady_clock clock;
+    double seconds[2] = {0, 0};
+    volatile double sink = sum;
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        for (int k = 0; k < 2; k++) {
+            const char kind = k == 0 ? 'p' : 'c';
+            double sum = 0;
+            auto start = clock::now();
+            for (auto &c : cases) {
+                if (c.kind == kind) {
+                    try { sum += evaluate(c); } catch (...) {}
+                }
+            }
+            seconds[k] += std::chrono::duration<double>(clock::now() - start).count();
+            sink = sink + sum;
+        }
+    }
+    if (passes > 0) {
+        printf("Throughput (%u passes): %.0f p-values/s, %.0f critical values/s\n", passes,
+                passes * count[0] / seconds[0], passes * count[1] / seconds[1]);
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,371 @@
+/** @file python/fracdist_module.cpp
+ * @brief Python extension module exposing fracdist p-values and critical values.
+ *
+ * Built when the `fracdist_PYTHON` CMake option is enabled.  The module provides:
+ *
+ *     fracdist.pvalue(stats, q, b, constant, interp="JGMMON14", approx_points=9, T=0, out=None, errors="raise")
+ *     fracdist.critical(levels, q, b, constant, interp="JGMMON14", approx_points=9, T=0, out=None, errors="raise")
+ *
+ * Each of the first four arguments may be a scalar, a sequence, or any object supporting the buffer
+ * protocol (such as a NumPy array, which is read in place without copying).  Non-scalar arguments
+ * must all have the same number of elements; scalar arguments are broadcast against them.  If every
+ * argument is a scalar a float is returned; otherwise the results are written to `out` (which must
+ * be a writable, contiguous float64 buffer of the right length, such as a NumPy array) or, if `out`
+ * is not given, to a new `array.array('d')` (which `numpy.asarray()` can wrap without copying).
+ *
+ * With `errors="raise"` an invalid value raises ValueError; with `errors="nan"` the corresponding
+ * result is NaN instead.  The GIL is released during the calculation.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <fracdist/pvalue.hpp>
+#include <fracdist/critical.hpp>
+#include <fracdist/version.hpp>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace fracdist;
+
+namespace {
+
+// One broadcastable argument: a scalar, or a one-dimensional (or C-contiguous) array of numbers.
+class array_arg {
+    public:
+        ~array_arg() { if (have_view_) PyBuffer_Release(&view_); }
+
+        // Sets up the argument from a Python object; returns false (with a Python exception set) on
+        // failure.
+        bool parse(PyObject *obj, const char *name) {
+            if (PyObject_CheckBuffer(obj)) {
+                if (PyObject_GetBuffer(obj, &view_, PyBUF_RECORDS_RO) != 0) return false;
+                have_view_ = true;
+                const char *f = view_.format ? view_.format : "B";
+                if (*f == '@' || *f == '=' || (*f == '<' && little_endian())) f++;
+                format_ = f[0];
+                if (f[0] == '\0' || f[1] != '\0' || !known_format(format_) || view_.itemsize != format_size(format_)) {
+                    PyErr_Format(PyExc_TypeError, "%s: unsupported buffer format '%s'", name, view_.format ? view_.format : "B");
+                    return false;
+                }
+                data_ = (const char*) view_.buf;
+                if (view_.ndim == 0) {
+                    scalar_ = true;
+                    length_ = 1;
+                }
+                else if (view_.ndim == 1) {
+                    scalar_ = false;
+                    length_ = view_.shape[0];
+                    stride_ = view_.strides ? view_.strides[0] : view_.itemsize;
+                }
+                else if (PyBuffer_IsContiguous(&view_, 'C')) {
+                    scalar_ = false;
+                    length_ = view_.len / view_.itemsize;
+                    stride_ = view_.itemsize;
+                }
+                else {
+                    PyErr_Format(PyExc_TypeError, "%s: multidimensional arrays must be C-contiguous", name);
+                    return false;
+                }
+                return true;
+            }
+            if (PySequence_Check(obj) && !PyUnicode_Check(obj) && !PyBytes_Check(obj)) {
+                PyObject *seq = PySequence_Fast(obj, name);
+                if (!seq) return false;
+                const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+                owned_.resize(n);
+                for (Py_ssize_t i = 0; i < n; i++) {
+                    owned_[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i));
+                    if (owned_[i] == -1.0 && PyErr_Occurred()) {
+                        Py_DECREF(seq);
+                        return false;
+                    }
+                }
+                Py_DECREF(seq);
+                scalar_ = false;
+                length_ = n;
+                format_ = 'd';
+                data_ = (const char*) owned_.data();
+                stride_ = sizeof(double);
+                return true;
+            }
+            value_ = PyFloat_AsDouble(obj);
+            if (value_ == -1.0 && PyErr_Occurred()) {
+                PyErr_Format(PyExc_TypeError, "%s: expected a number, sequence, or buffer (such as a numpy array)", name);
+                return false;
+            }
+            scalar_ = true;
+            length_ = 1;
+            format_ = 'd';
+            data_ = (const char*) &value_;
+            return true;
+        }
+
+        bool scalar() const { return scalar_; }
+        Py_ssize_t length() const { return length_; }
+
+        // Returns element i (or the scalar value) as a double
+        double operator[](const Py_ssize_t &i) const {
+            const char *p = data_ + (scalar_ ? 0 : i * stride_);
+            switch (format_) {
+                case 'd': return read<double>(p);
+                case 'f': return read<float>(p);
+                case '?': return read<bool>(p);
+                case 'b': return read<signed char>(p);
+                case 'B': return read<unsigned char>(p);
+                case 'h': return read<short>(p);
+                case 'H': return read<unsigned short>(p);
+                case 'i': return read<int>(p);
+                case 'I': return read<unsigned int>(p);
+                case 'l': return read<long>(p);
+                case 'L': return read<unsigned long>(p);
+                case 'q': return read<long long>(p);
+                case 'Q': return read<unsigned long long>(p);
+            }
+            return NAN;
+        }
+
+        // If the elements starting at i are contiguous doubles, returns a pointer to them
+        const double* contiguous_doubles(const Py_ssize_t &i) const {
+            if (format_ == 'd' && !scalar_ && stride_ == (Py_ssize_t) sizeof(double))
+                return (const double*) data_ + i;
+            return nullptr;
+        }
+
+    private:
+        template <typename T> static double read(const char *p) {
+            T v;
+            std::memcpy(&v, p, sizeof(T));
+            return (double) v;
+        }
+        static bool little_endian() {
+            const uint16_t one = 1;
+            return *(const unsigned char*) &one == 1;
+        }
+        static bool known_format(const char &f) { return format_size(f) > 0; }
+        static Py_ssize_t format_size(const char &f) {
+            switch (f) {
+                case 'd': return sizeof(double);
+                case 'f': return sizeof(float);
+                case '?': return sizeof(bool);
+                case 'b': case 'B': return 1;
+                case 'h': case 'H': return sizeof(short);
+                case 'i': case 'I': return sizeof(int);
+                case 'l': case 'L': return sizeof(long);
+                case 'q': case 'Q': return sizeof(long long);
+            }
+            return 0;
+        }
+
+        Py_buffer view_;
+        bool have_view_ = false;
+        bool scalar_ = true;
+        char format_ = 'd';
+        const char *data_ = nullptr;
+        Py_ssize_t length_ = 1, stride_ = 0;
+        double value_ = 0;
+        std::vector<double> owned_;
+};
+
+bool parse_interp(const char *name, interpolation &interp) {
+    if (!strcmp(name, "JGMMON14")) interp = interpolation::JGMMON14;
+    else if (!strcmp(name, "exact_or_JGMMON14")) interp = interpolation::exact_or_JGMMON14;
+    else if (!strcmp(name, "linear")) interp = interpolation::linear;
+    else if (!strcmp(name, "spline")) interp = interpolation::spline;
+    else if (!strcmp(name, "chebyshev")) interp = interpolation::chebyshev;
+    else {
+        PyErr_Format(PyExc_ValueError, "invalid interp '%s': expected 'JGMMON14', 'exact_or_JGMMON14', 'linear', 'spline', or 'chebyshev'", name);
+        return false;
+    }
+    return true;
+}
+
+typedef status (*batch_function)(const double*, double*, const size_t&, const unsigned int&, const double&, const bool&,
+        const interpolation&, const unsigned int&, const unsigned int&, status*);
+
+// Converts a q value, returning false if it isn't a valid unsigned int
+bool to_q(const double &d, unsigned int &q) {
+    if (!(d >= 0 && d <= std::numeric_limits<unsigned int>::max() && d == std::floor(d))) return false;
+    q = (unsigned int) d;
+    return true;
+}
+
+// Evaluates `batch` over the broadcast arguments, writing into `out`.  Consecutive elements with the
+// same q, b, and constant are passed to `batch` together (so that their quantiles are only
+// interpolated once).  Returns the status of the first failure, storing its index in `fail_at`.
+// Called without the GIL.
+status evaluate(batch_function batch, const array_arg &x, const array_arg &qa, const array_arg &ba, const array_arg &ca,
+        const Py_ssize_t &n, const interpolation &interp, const unsigned int &approx_points, const unsigned int &T,
+        double *out, Py_ssize_t &fail_at) {
+    status first = status::ok;
+    std::vector<double> tmp;
+    const bool params_scalar = qa.scalar() && ba.scalar() && ca.scalar();
+    for (Py_ssize_t i = 0; i < n; ) {
+        const double qd = qa[i], b = ba[i];
+        const bool c = ca[i] != 0;
+        Py_ssize_t end = i + 1;
+        if (params_scalar) end = n;
+        else while (end < n && qa[end] == qd && ba[end] == b && (ca[end] != 0) == c) end++;
+        const size_t count = end - i;
+
+        unsigned int q;
+        status s;
+        if (!to_q(qd, q)) {
+            s = status::invalid_q;
+            for (size_t j = 0; j < count; j++) out[i+j] = NAN;
+        }
+        else {
+            const double *xs = x.contiguous_doubles(i);
+            if (!xs) {
+                tmp.resize(count);
+                for (size_t j = 0; j < count; j++) tmp[j] = x[i+j];
+                xs = tmp.data();
+            }
+            s = batch(xs, out + i, count, q, b, c, interp, approx_points, T, nullptr);
+        }
+        if (s != status::ok && first == status::ok) {
+            first = s;
+            fail_at = i;
+            while (fail_at < end - 1 && !std::isnan(out[fail_at])) fail_at++;
+        }
+        i = end;
+    }
+    return first;
+}
+
+PyObject* calculate(PyObject *args, PyObject *kwargs, batch_function batch, const char *xname) {
+    static const char *kwlist_p[] = {"stats", "q", "b", "constant", "interp", "approx_points", "T", "out", "errors", nullptr};
+    static const char *kwlist_c[] = {"levels", "q", "b", "constant", "interp", "approx_points", "T", "out", "errors", nullptr};
+    PyObject *xo, *qo, *bo, *co, *outo = Py_None;
+    const char *interp_name = "JGMMON14", *errors = "raise";
+    unsigned int approx_points = 9, T = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|sIIOs", (char**) (batch == pvalue_batch ? kwlist_p : kwlist_c),
+                &xo, &qo, &bo, &co, &interp_name, &approx_points, &T, &outo, &errors))
+        return nullptr;
+
+    interpolation interp;
+    if (!parse_interp(interp_name, interp)) return nullptr;
+    const bool raise = !strcmp(errors, "raise");
+    if (!raise && strcmp(errors, "nan")) {
+        PyErr_Format(PyExc_ValueError, "invalid errors value '%s': expected 'raise' or 'nan'", errors);
+        return nullptr;
+    }
+
+    array_arg x, qa, ba, ca;
+    if (!x.parse(xo, xname) || !qa.parse(qo, "q") || !ba.parse(bo, "b") || !ca.parse(co, "constant"))
+        return nullptr;
+
+    // Broadcast: every non-scalar argument must have the same length
+    Py_ssize_t n = -1;
+    const array_arg *all[] = {&x, &qa, &ba, &ca};
+    const char *names[] = {xname, "q", "b", "constant"};
+    for (size_t k = 0; k < 4; k++) {
+        if (all[k]->scalar()) continue;
+        if (n == -1) n = all[k]->length();
+        else if (all[k]->length() != n) {
+            PyErr_Format(PyExc_ValueError, "%s has length %zd, but other arguments have length %zd", names[k], all[k]->length(), n);
+            return nullptr;
+        }
+    }
+    const bool scalar_result = n == -1 && outo == Py_None;
+    if (n == -1) n = 1;
+
+    // Set up the output
+    PyObject *result = nullptr;
+    Py_buffer outview;
+    double scalar_out;
+    double *out = &scalar_out;
+    bool have_outview = false;
+    if (!scalar_result) {
+        if (outo == Py_None) {
+            PyObject *array_mod = PyImport_ImportModule("array");
+            if (!array_mod) return nullptr;
+            PyObject *array_type = PyObject_GetAttrString(array_mod, "array");
+            Py_DECREF(array_mod);
+            if (!array_type) return nullptr;
+            PyObject *zero = Py_BuildValue("(s[d])", "d", 0.0);
+            PyObject *one = zero ? PyObject_CallObject(array_type, zero) : nullptr;
+            Py_XDECREF(zero);
+            Py_DECREF(array_type);
+            if (!one) return nullptr;
+            result = PySequence_Repeat(one, n);
+            Py_DECREF(one);
+            if (!result) return nullptr;
+        }
+        else {
+            Py_INCREF(outo);
+            result = outo;
+        }
+        if (PyObject_GetBuffer(result, &outview, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0) {
+            Py_DECREF(result);
+            return nullptr;
+        }
+        have_outview = true;
+        const char *f = outview.format;
+        if (*f == '@' || *f == '=') f++;
+        if (strcmp(f, "d") || outview.len != n * (Py_ssize_t) sizeof(double)) {
+            PyBuffer_Release(&outview);
+            Py_DECREF(result);
+            PyErr_Format(PyExc_ValueError, "out must be a contiguous float64 buffer with %zd elements", n);
+            return nullptr;
+        }
+        out = (double*) outview.buf;
+    }
+
+    status s;
+    Py_ssize_t fail_at = 0;
+    Py_BEGIN_ALLOW_THREADS
+    s = evaluate(batch, x, qa, ba, ca, n, interp, approx_points, T, out, fail_at);
+    Py_END_ALLOW_THREADS
+
+    if (have_outview) PyBuffer_Release(&outview);
+
+    if (s != status::ok && raise) {
+        Py_XDECREF(result);
+        if (scalar_result)
+            PyErr_Format(PyExc_ValueError, "%s", status_message(s));
+        else
+            PyErr_Format(PyExc_ValueError, "element %zd: %s", fail_at, status_message(s));
+        return nullptr;
+    }
+
+    if (scalar_result) return PyFloat_FromDouble(scalar_out);
+    return result;
+}
+
+PyObject* py_pvalue(PyObject*, PyObject *args, PyObject *kwargs) {
+    return calculate(args, kwargs, pvalue_batch, "stats");
+}
+
+PyObject* py_critical(PyObject*, PyObject *args, PyObject *kwargs) {
+    return calculate(args, kwargs, critical_batch, "levels");
+}
+
+PyMethodDef methods[] = {
+    {"pvalue", (PyCFunction) (void(*)(void)) py_pvalue, METH_VARARGS | METH_KEYWORDS,
+        "pvalue(stats, q, b, constant, interp='JGMMON14', approx_points=9, T=0, out=None, errors='raise')\n\n"
+        "Calculates p-values of test statistics.  stats, q, b, and constant may be scalars,\n"
+        "sequences, or buffers (such as numpy arrays) and are broadcast against each other."},
+    {"critical", (PyCFunction) (void(*)(void)) py_critical, METH_VARARGS | METH_KEYWORDS,
+        "critical(levels, q, b, constant, interp='JGMMON14', approx_points=9, T=0, out=None, errors='raise')\n\n"
+        "Calculates critical values for test levels.  levels, q, b, and constant may be scalars,\n"
+        "sequences, or buffers (such as numpy arrays) and are broadcast against each other."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "fracdist",
+    "P-values and critical values for fractional unit root and cointegration tests.",
+    -1, methods, nullptr, nullptr, nullptr, nullptr
+};
+
+}
+
+PyMODINIT_FUNC PyInit_fracdist(void) {
+    PyObject *m = PyModule_Create(&module);
+    if (m && PyModule_AddStringConstant(m, "__version__", version_string) != 0) {
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
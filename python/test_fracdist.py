@@ -0,0 +1,98 @@
+"""Tests for the fracdist Python module.
+
+Run with the directory containing the built module on PYTHONPATH (ctest does this when the module is
+built with -Dfracdist_PYTHON=ON):
+
+    PYTHONPATH=build python3 python/test_fracdist.py
+"""
+import array
+import math
+import sys
+import threading
+import unittest
+
+import fracdist
+
+
+class TestFracdist(unittest.TestCase):
+    def test_scalars(self):
+        # The same values as `fdpval 1 0.8 1 3.5` and `fdcrit 2 1.2 0 0.05`
+        self.assertAlmostEqual(fracdist.pvalue(3.5, 1, 0.8, True), 0.3637637, places=6)
+        self.assertAlmostEqual(fracdist.critical(0.05, 2, 1.2, False), 13.36349, places=4)
+
+    def test_broadcast(self):
+        stats = [0.5, 3.5, 12.0]
+        got = fracdist.pvalue(stats, 1, [0.6, 0.8, 1.7], True)
+        self.assertIsInstance(got, array.array)
+        self.assertEqual(len(got), 3)
+        for x, b, p in zip(stats, [0.6, 0.8, 1.7], got):
+            self.assertEqual(p, fracdist.pvalue(x, 1, b, True))
+
+    def test_buffers(self):
+        # array.array and (strided) memoryview buffers are read in place, and must give the same
+        # values as scalars, whatever their format
+        stats = array.array("d", [0.5, 3.5, 12.0, 40.0])
+        qs = array.array("i", [1, 2, 3, 4])
+        got = fracdist.pvalue(stats, qs, 0.8, True)
+        for x, q, p in zip(stats, qs, got):
+            self.assertEqual(p, fracdist.pvalue(x, q, 0.8, True))
+        every_other = memoryview(array.array("d", [3.5, -1.0, 12.0, -1.0, 40.0, -1.0]))[::2]
+        got = fracdist.pvalue(every_other, 2, [0.6, 0.9, 1.4], False)
+        for x, b, p in zip([3.5, 12.0, 40.0], [0.6, 0.9, 1.4], got):
+            self.assertEqual(p, fracdist.pvalue(x, 2, b, False))
+
+    def test_threads(self):
+        # The calculation releases the GIL and the quantile caches are per-thread, so concurrent
+        # calls at different parameters must each get their own results
+        stats = [0.25 * i for i in range(400)]
+        params = [(1, 0.8, True), (3, 1.7, False)]
+        expected = [list(fracdist.pvalue(stats, q, b, c)) for q, b, c in params]
+        results = [[], []]
+
+        def run(k):
+            q, b, c = params[k]
+            for _ in range(50):
+                results[k].append(list(fracdist.pvalue(stats, q, b, c)))
+
+        threads = [threading.Thread(target=run, args=(k,)) for k in range(2)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        for k in range(2):
+            self.assertEqual(len(results[k]), 50)
+            for got in results[k]:
+                self.assertEqual(got, expected[k])
+
+    def test_round_trip(self):
+        for level in (0.01, 0.05, 0.1):
+            crit = fracdist.critical(level, 3, 0.9, True)
+            self.assertAlmostEqual(fracdist.pvalue(crit, 3, 0.9, True), level, delta=1e-3)
+
+    def test_out(self):
+        out = array.array("d", [0.0] * 2)
+        self.assertIs(fracdist.critical([0.05, 0.01], 1, 1.0, True, out=out), out)
+        self.assertEqual(out[1], fracdist.critical(0.01, 1, 1.0, True))
+        with self.assertRaises(ValueError):
+            fracdist.critical([0.05, 0.01], 1, 1.0, True, out=array.array("d", [0.0]))
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            fracdist.pvalue(3.5, 1, 5.0, True)
+        with self.assertRaises(ValueError):
+            fracdist.pvalue([1.0, 2.0], 1, 0.8, True, errors="bad")
+        got = fracdist.pvalue([1.0, -1.0], 1, 0.8, True, errors="nan")
+        self.assertFalse(math.isnan(got[0]))
+        self.assertTrue(math.isnan(got[1]))
+
+    def test_no_reference_leak(self):
+        # Each sequence result is built from array.array, which must not keep a reference
+        fracdist.pvalue([1.0, 2.0], 1, 0.8, True)
+        before = sys.getrefcount(array.array)
+        for _ in range(100):
+            fracdist.pvalue([1.0, 2.0], 1, 0.8, True)
+        self.assertEqual(sys.getrefcount(array.array), before)
+
+
+if __name__ == "__main__":
+    unittest.main()